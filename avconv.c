@@ -83,11 +83,8 @@ const int program_birth_year = 2000;
 
 static FILE *vstats_file;
 
-static int64_t video_size = 0;
-static int64_t audio_size = 0;
 static int64_t extra_size = 0;
 static int nb_frames_dup = 0;
-static int nb_frames_drop = 0;
 
 
 
@@ -302,6 +299,22 @@ static void update_sample_fmt(AVCodecContext *dec, AVCodec *dec_codec,
     }
 }
 
+static void lock_output_file(OutputFile *of)
+{
+#if HAVE_PTHREADS
+    if (pipeline_threads)
+        pthread_mutex_lock(&of->mux_lock);
+#endif
+}
+
+static void unlock_output_file(OutputFile *of)
+{
+#if HAVE_PTHREADS
+    if (pipeline_threads)
+        pthread_mutex_unlock(&of->mux_lock);
+#endif
+}
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
 {
     AVBitStreamFilterContext *bsfc = ost->bitstream_filters;
@@ -349,7 +362,9 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
     }
 
     pkt->stream_index = ost->index;
+    lock_output_file(output_files[ost->file_index]);
     ret = av_interleaved_write_frame(s, pkt);
+    unlock_output_file(output_files[ost->file_index]);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         exit(1);
@@ -402,7 +417,7 @@ static void do_audio_out(AVFormatContext *s, OutputStream *ost,
 
         write_frame(s, &pkt, ost);
 
-        audio_size += pkt.size;
+        ost->data_size += pkt.size;
     }
 }
 
@@ -532,7 +547,7 @@ static void do_video_out(AVFormatContext *s,
         ost->frame_number &&
         in_picture->pts != AV_NOPTS_VALUE &&
         in_picture->pts < ost->sync_opts) {
-        nb_frames_drop++;
+        ost->frames_dropped++;
         av_log(NULL, AV_LOG_VERBOSE, "*** drop!\n");
         return;
     }
@@ -594,8 +609,8 @@ static void do_video_out(AVFormatContext *s,
                 pkt.dts = av_rescale_q(pkt.dts, enc->time_base, ost->st->time_base);
 
             write_frame(s, &pkt, ost);
-            *frame_size = pkt.size;
-            video_size += pkt.size;
+            *frame_size     = pkt.size;
+            ost->data_size += pkt.size;
 
             /* if two pass, output log */
             if (ost->logfile && enc->stats_out) {
@@ -622,37 +637,221 @@ static void do_video_stats(OutputStream *ost, int frame_size)
     AVCodecContext *enc;
     int frame_number;
     double ti1, bitrate, avg_bitrate;
-
-    /* this is executed just the first time do_video_stats is called */
-    if (!vstats_file) {
-        vstats_file = fopen(vstats_filename, "w");
-        if (!vstats_file) {
-            perror("fopen");
-            exit(1);
-        }
-    }
+    char buf[256] = "";
 
     enc = ost->st->codec;
     if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
         frame_number = ost->frame_number;
-        fprintf(vstats_file, "frame= %5d q= %2.1f ", frame_number, enc->coded_frame->quality / (float)FF_QP2LAMBDA);
+        av_strlcatf(buf, sizeof(buf), "frame= %5d q= %2.1f ", frame_number, enc->coded_frame->quality / (float)FF_QP2LAMBDA);
         if (enc->flags&CODEC_FLAG_PSNR)
-            fprintf(vstats_file, "PSNR= %6.2f ", psnr(enc->coded_frame->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
+            av_strlcatf(buf, sizeof(buf), "PSNR= %6.2f ", psnr(enc->coded_frame->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
 
-        fprintf(vstats_file,"f_size= %6d ", frame_size);
+        av_strlcatf(buf, sizeof(buf), "f_size= %6d ", frame_size);
         /* compute pts value */
         ti1 = ost->sync_opts * av_q2d(enc->time_base);
         if (ti1 < 0.01)
             ti1 = 0.01;
 
         bitrate     = (frame_size * 8) / av_q2d(enc->time_base) / 1000.0;
-        avg_bitrate = (double)(video_size * 8) / ti1 / 1000.0;
-        fprintf(vstats_file, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
-               (double)video_size / 1024, ti1, bitrate, avg_bitrate);
-        fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(enc->coded_frame->pict_type));
+        avg_bitrate = (double)(ost->data_size * 8) / ti1 / 1000.0;
+        av_strlcatf(buf, sizeof(buf), "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
+                    (double)ost->data_size / 1024, ti1, bitrate, avg_bitrate);
+        av_strlcatf(buf, sizeof(buf), "type= %c\n", av_get_picture_type_char(enc->coded_frame->pict_type));
+
+        /* written at once, so that lines from different encoding threads
+         * do not get mixed */
+        fputs(buf, vstats_file);
     }
 }
 
+#if HAVE_PTHREADS
+static int tq_init(ThreadQueue *q, int elem_size, int max_elems)
+{
+    if (!(q->fifo = av_fifo_alloc((max_elems ? max_elems : 8) * elem_size)))
+        return AVERROR(ENOMEM);
+    q->elem_size = elem_size;
+    q->max_elems = max_elems;
+    q->eof       = 0;
+    q->finished  = 0;
+    q->error     = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init (&q->cond, NULL);
+    return 0;
+}
+
+/* free the queue and everything left in it with free_elem */
+static void tq_free(ThreadQueue *q, void (*free_elem)(void *elem))
+{
+    uint8_t *elem;
+
+    if (!q->fifo)
+        return;
+
+    elem = av_malloc(q->elem_size);
+    while (elem && av_fifo_size(q->fifo)) {
+        av_fifo_generic_read(q->fifo, elem, q->elem_size, NULL);
+        free_elem(elem);
+    }
+    av_free(elem);
+    av_fifo_free(q->fifo);
+    q->fifo = NULL;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy (&q->cond);
+}
+
+/*
+ * Append an element to the queue, waiting while it is full.
+ * Return AVERROR_EOF without taking the element if the consumer has finished,
+ * or the error it failed with.
+ */
+static int tq_send(ThreadQueue *q, void *elem)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->lock);
+    while (!q->finished && q->max_elems &&
+           av_fifo_size(q->fifo) >= q->max_elems * q->elem_size)
+        pthread_cond_wait(&q->cond, &q->lock);
+
+    if (q->finished)
+        ret = q->error ? q->error : AVERROR_EOF;
+    else if (av_fifo_space(q->fifo) ||
+             (ret = av_fifo_realloc2(q->fifo, 2 * av_fifo_size(q->fifo))) >= 0) {
+        av_fifo_generic_write(q->fifo, elem, q->elem_size, NULL);
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+static void tq_send_eof(ThreadQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->eof = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * Take the first element from the queue.
+ * Return AVERROR(EAGAIN) if the queue is empty and block is 0, AVERROR_EOF
+ * if the queue is empty and nothing more will be sent or the consumer has
+ * finished.
+ */
+static int tq_receive(ThreadQueue *q, void *elem, int block)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->lock);
+    while (block && !q->finished && !q->eof && !av_fifo_size(q->fifo))
+        pthread_cond_wait(&q->cond, &q->lock);
+
+    if (q->finished)
+        ret = AVERROR_EOF;
+    else if (av_fifo_size(q->fifo)) {
+        av_fifo_generic_read(q->fifo, elem, q->elem_size, NULL);
+        pthread_cond_broadcast(&q->cond);
+    } else
+        ret = q->eof ? AVERROR_EOF : AVERROR(EAGAIN);
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+/* mark that the consumer will not read anything more from the queue */
+static void tq_finish(ThreadQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->finished = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* mark that the consumer failed with error err and stopped reading */
+static void tq_abort(ThreadQueue *q, int err)
+{
+    pthread_mutex_lock(&q->lock);
+    q->finished = 1;
+    q->error    = err;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static int tq_error(ThreadQueue *q)
+{
+    int ret;
+
+    pthread_mutex_lock(&q->lock);
+    ret = q->error;
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+static int tq_finished(ThreadQueue *q)
+{
+    int ret;
+
+    pthread_mutex_lock(&q->lock);
+    ret = q->finished;
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+/* element of the frame queues used by the pipeline threads */
+typedef struct QueuedFrame {
+    AVFrame *frame;
+    int      error;         /* decoding error, frame is NULL in this case */
+    int      reconfigure;   /* the filtergraph must be reconfigured before
+                               this frame is sent to it */
+} QueuedFrame;
+
+static void free_queued_frame(void *elem)
+{
+    av_frame_free(&((QueuedFrame *)elem)->frame);
+}
+
+static void free_queued_packet(void *elem)
+{
+    av_free_packet(elem);
+}
+#endif
+
+/* Return 1 if the filtergraph is run by an encoding thread. */
+static int filtergraph_is_threaded(FilterGraph *fg)
+{
+#if HAVE_PTHREADS
+    return !fg->graph_desc && fg->outputs[0]->ost->enc_thread_active;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Mark that no more packets should be written for ost.
+ * Only to be called from the main thread.
+ */
+static void finish_output_stream(OutputStream *ost)
+{
+#if HAVE_PTHREADS
+    if (ost->enc_thread_active) {
+        tq_finish(&ost->enc_frames);
+        return;
+    }
+#endif
+    ost->finished = 1;
+}
+
+static void finish_output_file(OutputFile *of)
+{
+    int i;
+
+    for (i = 0; i < of->ctx->nb_streams; i++)
+        finish_output_stream(output_streams[of->ost_index + i]);
+}
+
 /*
  * Read one frame for lavfi output for ost and encode it.
  */
@@ -724,7 +923,7 @@ static int poll_filter(OutputStream *ost)
  */
 static int poll_filters(void)
 {
-    int i, j, ret = 0;
+    int i, ret = 0;
 
     while (ret >= 0 && !received_sigterm) {
         OutputStream *ost = NULL;
@@ -734,7 +933,9 @@ static int poll_filters(void)
         for (i = 0; i < nb_output_streams; i++) {
             int64_t pts = output_streams[i]->sync_opts;
 
-            if (!output_streams[i]->filter || output_streams[i]->finished)
+            if (!output_streams[i]->filter ||
+                filtergraph_is_threaded(output_streams[i]->filter->graph) ||
+                output_streams[i]->finished)
                 continue;
 
             pts = av_rescale_q(pts, output_streams[i]->st->codec->time_base,
@@ -755,10 +956,8 @@ static int poll_filters(void)
 
             ost->finished = 1;
 
-            if (of->shortest) {
-                for (j = 0; j < of->ctx->nb_streams; j++)
-                    output_streams[of->ost_index + j]->finished = 1;
-            }
+            if (of->shortest)
+                finish_output_file(of);
 
             ret = 0;
         } else if (ret == AVERROR(EAGAIN))
@@ -773,9 +972,9 @@ static void print_report(int is_last_report, int64_t timer_start)
     char buf[1024];
     OutputStream *ost;
     AVFormatContext *oc;
-    int64_t total_size;
+    int64_t total_size, video_size = 0, audio_size = 0;
     AVCodecContext *enc;
-    int frame_number, vid, i;
+    int frame_number, vid, i, nb_frames_drop = 0;
     double bitrate, ti1, pts;
     static int64_t last_time = -1;
     static int qp_histogram[52];
@@ -799,9 +998,11 @@ static void print_report(int is_last_report, int64_t timer_start)
 
     oc = output_files[0]->ctx;
 
+    lock_output_file(output_files[0]);
     total_size = avio_size(oc->pb);
     if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
         total_size = avio_tell(oc->pb);
+    unlock_output_file(output_files[0]);
     if (total_size < 0) {
         char errbuf[128];
         av_strerror(total_size, errbuf, sizeof(errbuf));
@@ -863,9 +1064,17 @@ static void print_report(int is_last_report, int64_t timer_start)
             vid = 1;
         }
         /* compute min output value */
+        lock_output_file(output_files[ost->file_index]);
         pts = (double)ost->st->pts.val * av_q2d(ost->st->time_base);
+        unlock_output_file(output_files[ost->file_index]);
         if ((pts < ti1) && (pts > 0))
             ti1 = pts;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
+            video_size += ost->data_size;
+        else if (enc->codec_type == AVMEDIA_TYPE_AUDIO)
+            audio_size += ost->data_size;
+        nb_frames_drop += ost->frames_dropped;
     }
     if (ti1 < 0.01)
         ti1 = 0.01;
@@ -896,76 +1105,84 @@ static void print_report(int is_last_report, int64_t timer_start)
     }
 }
 
-static void flush_encoders(void)
+static void flush_encoder(OutputStream *ost)
 {
-    int i, ret;
+    AVCodecContext *enc = ost->st->codec;
+    AVFormatContext *os = output_files[ost->file_index]->ctx;
+    int ret, stop_encoding = 0;
 
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream   *ost = output_streams[i];
-        AVCodecContext *enc = ost->st->codec;
-        AVFormatContext *os = output_files[ost->file_index]->ctx;
-        int stop_encoding = 0;
+    if (!ost->encoding_needed)
+        return;
 
-        if (!ost->encoding_needed)
-            continue;
+    if (ost->st->codec->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1)
+        return;
+    if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO && (os->oformat->flags & AVFMT_RAWPICTURE) && enc->codec->id == AV_CODEC_ID_RAWVIDEO)
+        return;
 
-        if (ost->st->codec->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1)
-            continue;
-        if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO && (os->oformat->flags & AVFMT_RAWPICTURE) && enc->codec->id == AV_CODEC_ID_RAWVIDEO)
-            continue;
+    for (;;) {
+        int (*encode)(AVCodecContext*, AVPacket*, const AVFrame*, int*) = NULL;
+        const char *desc;
 
-        for (;;) {
-            int (*encode)(AVCodecContext*, AVPacket*, const AVFrame*, int*) = NULL;
-            const char *desc;
-            int64_t *size;
+        switch (ost->st->codec->codec_type) {
+        case AVMEDIA_TYPE_AUDIO:
+            encode = avcodec_encode_audio2;
+            desc   = "Audio";
+            break;
+        case AVMEDIA_TYPE_VIDEO:
+            encode = avcodec_encode_video2;
+            desc   = "Video";
+            break;
+        default:
+            stop_encoding = 1;
+        }
 
-            switch (ost->st->codec->codec_type) {
-            case AVMEDIA_TYPE_AUDIO:
-                encode = avcodec_encode_audio2;
-                desc   = "Audio";
-                size   = &audio_size;
-                break;
-            case AVMEDIA_TYPE_VIDEO:
-                encode = avcodec_encode_video2;
-                desc   = "Video";
-                size   = &video_size;
-                break;
-            default:
+        if (encode) {
+            AVPacket pkt;
+            int got_packet;
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+
+            ret = encode(enc, &pkt, NULL, &got_packet);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "%s encoding failed\n", desc);
+                exit(1);
+            }
+            if (ost->logfile && enc->stats_out) {
+                fprintf(ost->logfile, "%s", enc->stats_out);
+            }
+            if (!got_packet) {
                 stop_encoding = 1;
+                break;
             }
+            ost->data_size += pkt.size;
+            if (pkt.pts != AV_NOPTS_VALUE)
+                pkt.pts = av_rescale_q(pkt.pts, enc->time_base, ost->st->time_base);
+            if (pkt.dts != AV_NOPTS_VALUE)
+                pkt.dts = av_rescale_q(pkt.dts, enc->time_base, ost->st->time_base);
+            if (pkt.duration > 0)
+                pkt.duration = av_rescale_q(pkt.duration, enc->time_base, ost->st->time_base);
+            write_frame(os, &pkt, ost);
+        }
 
-            if (encode) {
-                AVPacket pkt;
-                int got_packet;
-                av_init_packet(&pkt);
-                pkt.data = NULL;
-                pkt.size = 0;
+        if (stop_encoding)
+            break;
+    }
+}
 
-                ret = encode(enc, &pkt, NULL, &got_packet);
-                if (ret < 0) {
-                    av_log(NULL, AV_LOG_FATAL, "%s encoding failed\n", desc);
-                    exit(1);
-                }
-                *size += ret;
-                if (ost->logfile && enc->stats_out) {
-                    fprintf(ost->logfile, "%s", enc->stats_out);
-                }
-                if (!got_packet) {
-                    stop_encoding = 1;
-                    break;
-                }
-                if (pkt.pts != AV_NOPTS_VALUE)
-                    pkt.pts = av_rescale_q(pkt.pts, enc->time_base, ost->st->time_base);
-                if (pkt.dts != AV_NOPTS_VALUE)
-                    pkt.dts = av_rescale_q(pkt.dts, enc->time_base, ost->st->time_base);
-                if (pkt.duration > 0)
-                    pkt.duration = av_rescale_q(pkt.duration, enc->time_base, ost->st->time_base);
-                write_frame(os, &pkt, ost);
-            }
+static void flush_encoders(void)
+{
+    int i;
 
-            if (stop_encoding)
-                break;
-        }
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+#if HAVE_PTHREADS
+        /* the encoding threads flush their encoders themselves */
+        if (ost->enc_thread_active)
+            continue;
+#endif
+        flush_encoder(ost);
     }
 }
 
@@ -1005,12 +1222,9 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     }
 
     /* force the input stream PTS */
-    if (ost->st->codec->codec_type == AVMEDIA_TYPE_AUDIO)
-        audio_size += pkt->size;
-    else if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
-        video_size += pkt->size;
+    if (ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO)
         ost->sync_opts++;
-    }
+    ost->data_size += pkt->size;
 
     if (pkt->pts != AV_NOPTS_VALUE)
         opkt.pts = av_rescale_q(pkt->pts, ist->st->time_base, ost->st->time_base) - ost_tb_start_time;
@@ -1074,36 +1288,80 @@ int guess_input_channel_layout(InputStream *ist)
     return 1;
 }
 
-static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
+/*
+ * Send a frame (or EOF if frame is NULL) to an input of a filtergraph.
+ * The reference in frame is moved.
+ */
+static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame,
+                              int reconfigure)
 {
-    AVFrame *decoded_frame, *f;
-    AVCodecContext *avctx = ist->st->codec;
-    int i, ret, err = 0, resample_changed;
-
-    if (!ist->decoded_frame && !(ist->decoded_frame = avcodec_alloc_frame()))
-        return AVERROR(ENOMEM);
-    if (!ist->filter_frame && !(ist->filter_frame = av_frame_alloc()))
-        return AVERROR(ENOMEM);
-    decoded_frame = ist->decoded_frame;
+#if HAVE_PTHREADS
+    if (filtergraph_is_threaded(ifilter->graph)) {
+        OutputStream *ost = ifilter->graph->outputs[0]->ost;
+        QueuedFrame qf = { .reconfigure = reconfigure };
 
-    ret = avcodec_decode_audio4(avctx, decoded_frame, got_output, pkt);
-    if (!*got_output || ret < 0) {
-        if (!pkt->size) {
-            for (i = 0; i < ist->nb_filters; i++)
-                av_buffersrc_add_frame(ist->filters[i]->filter, NULL);
+        if (!frame) {
+            tq_send_eof(&ost->enc_frames);
+            return 0;
         }
-        return ret;
+
+        if (!(qf.frame = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        av_frame_move_ref(qf.frame, frame);
+
+        /* the encoding thread may have finished already, then the frame is
+         * just dropped; if it failed, the main loop stops on its error */
+        if (tq_send(&ost->enc_frames, &qf) < 0)
+            av_frame_free(&qf.frame);
+        return 0;
     }
+#endif
+    return av_buffersrc_add_frame(ifilter->filter, frame);
+}
 
-    /* if the decoder provides a pts, use it instead of the last packet pts.
-       the decoder could be delaying output by a packet or more. */
-    if (decoded_frame->pts != AV_NOPTS_VALUE)
-        ist->next_dts = decoded_frame->pts;
-    else if (pkt->pts != AV_NOPTS_VALUE) {
-        decoded_frame->pts = pkt->pts;
-        pkt->pts           = AV_NOPTS_VALUE;
+static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame,
+                                 int reconfigure)
+{
+    AVFrame *f;
+    int i, err = 0;
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        if (i < ist->nb_filters - 1) {
+            f = ist->filter_frame;
+            err = av_frame_ref(f, decoded_frame);
+            if (err < 0)
+                break;
+        } else
+            f = decoded_frame;
+
+        err = ifilter_send_frame(ist->filters[i], f, reconfigure);
+        if (err < 0)
+            break;
     }
 
+    av_frame_unref(ist->filter_frame);
+    av_frame_unref(decoded_frame);
+    return err;
+}
+
+static void send_eof_to_filters(InputStream *ist)
+{
+    int i;
+
+    for (i = 0; i < ist->nb_filters; i++)
+        ifilter_send_frame(ist->filters[i], NULL, 0);
+}
+
+/* filter a decoded audio frame, this part of decoding is always run in the
+ * main thread */
+static int process_audio_frame(InputStream *ist, AVFrame *decoded_frame)
+{
+    AVCodecContext *avctx = ist->st->codec;
+    int i, resample_changed;
+
+    if (!ist->filter_frame && !(ist->filter_frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+
     rate_emu_sleep(ist);
 
     resample_changed = ist->resample_sample_fmt     != decoded_frame->format         ||
@@ -1139,8 +1397,12 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
         ist->resample_channel_layout = decoded_frame->channel_layout;
         ist->resample_channels       = avctx->channels;
 
+        for (i = 0; i < ist->nb_filters; i++)
+            if (!filtergraph_is_threaded(ist->filters[i]->graph))
+                ifilter_parameters_from_frame(ist->filters[i], decoded_frame);
         for (i = 0; i < nb_filtergraphs; i++)
             if (ist_in_filtergraph(filtergraphs[i], ist) &&
+                !filtergraph_is_threaded(filtergraphs[i]) &&
                 configure_filtergraph(filtergraphs[i]) < 0) {
                 av_log(NULL, AV_LOG_FATAL, "Error reinitializing filters!\n");
                 exit(1);
@@ -1150,51 +1412,51 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
     if (decoded_frame->pts != AV_NOPTS_VALUE)
         decoded_frame->pts = av_rescale_q(decoded_frame->pts,
                                           ist->st->time_base,
-                                          (AVRational){1, ist->st->codec->sample_rate});
-    for (i = 0; i < ist->nb_filters; i++) {
-        if (i < ist->nb_filters - 1) {
-            f = ist->filter_frame;
-            err = av_frame_ref(f, decoded_frame);
-            if (err < 0)
-                break;
-        } else
-            f = decoded_frame;
-
-        err = av_buffersrc_add_frame(ist->filters[i]->filter, f);
-        if (err < 0)
-            break;
-    }
+                                          (AVRational){1, decoded_frame->sample_rate});
 
-    av_frame_unref(ist->filter_frame);
-    av_frame_unref(decoded_frame);
-    return err < 0 ? err : ret;
+    return send_frame_to_filters(ist, decoded_frame, resample_changed);
 }
 
-static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
+static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
 {
-    AVFrame *decoded_frame, *f;
-    void *buffer_to_free = NULL;
-    int i, ret = 0, err = 0, resample_changed;
+    AVFrame *decoded_frame;
+    AVCodecContext *avctx = ist->st->codec;
+    int ret, err;
 
-    if (!ist->decoded_frame && !(ist->decoded_frame = av_frame_alloc()))
-        return AVERROR(ENOMEM);
-    if (!ist->filter_frame && !(ist->filter_frame = av_frame_alloc()))
+    if (!ist->decoded_frame && !(ist->decoded_frame = avcodec_alloc_frame()))
         return AVERROR(ENOMEM);
     decoded_frame = ist->decoded_frame;
 
-    ret = avcodec_decode_video2(ist->st->codec,
-                                decoded_frame, got_output, pkt);
+    ret = avcodec_decode_audio4(avctx, decoded_frame, got_output, pkt);
     if (!*got_output || ret < 0) {
-        if (!pkt->size) {
-            for (i = 0; i < ist->nb_filters; i++)
-                av_buffersrc_add_frame(ist->filters[i]->filter, NULL);
-        }
+        if (!pkt->size)
+            send_eof_to_filters(ist);
         return ret;
     }
 
-    decoded_frame->pts = guess_correct_pts(&ist->pts_ctx, decoded_frame->pkt_pts,
-                                           decoded_frame->pkt_dts);
-    pkt->size = 0;
+    /* if the decoder provides a pts, use it instead of the last packet pts.
+       the decoder could be delaying output by a packet or more. */
+    if (decoded_frame->pts != AV_NOPTS_VALUE)
+        ist->next_dts = decoded_frame->pts;
+    else if (pkt->pts != AV_NOPTS_VALUE) {
+        decoded_frame->pts = pkt->pts;
+        pkt->pts           = AV_NOPTS_VALUE;
+    }
+
+    err = process_audio_frame(ist, decoded_frame);
+    return err < 0 ? err : ret;
+}
+
+/* filter a decoded video frame, this part of decoding is always run in the
+ * main thread */
+static int process_video_frame(InputStream *ist, AVFrame *decoded_frame)
+{
+    void *buffer_to_free = NULL;
+    int i, ret, err, resample_changed;
+
+    if (!ist->filter_frame && !(ist->filter_frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+
 #if FF_API_DEINTERLACE
     pre_process_video_frame(ist, (AVPicture *)decoded_frame, &buffer_to_free);
 #endif
@@ -1222,31 +1484,45 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
         ist->resample_height  = decoded_frame->height;
         ist->resample_pix_fmt = decoded_frame->format;
 
+        for (i = 0; i < ist->nb_filters; i++)
+            if (!filtergraph_is_threaded(ist->filters[i]->graph))
+                ifilter_parameters_from_frame(ist->filters[i], decoded_frame);
         for (i = 0; i < nb_filtergraphs; i++)
             if (ist_in_filtergraph(filtergraphs[i], ist) &&
+                !filtergraph_is_threaded(filtergraphs[i]) &&
                 configure_filtergraph(filtergraphs[i]) < 0) {
                 av_log(NULL, AV_LOG_FATAL, "Error reinitializing filters!\n");
                 exit(1);
             }
     }
 
-    for (i = 0; i < ist->nb_filters; i++) {
-        if (i < ist->nb_filters - 1) {
-            f = ist->filter_frame;
-            err = av_frame_ref(f, decoded_frame);
-            if (err < 0)
-                break;
-        } else
-            f = decoded_frame;
+    err = send_frame_to_filters(ist, decoded_frame, resample_changed);
+    av_free(buffer_to_free);
+    return err;
+}
 
-        err = av_buffersrc_add_frame(ist->filters[i]->filter, f);
-        if (err < 0)
-            break;
+static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
+{
+    AVFrame *decoded_frame;
+    int ret = 0, err;
+
+    if (!ist->decoded_frame && !(ist->decoded_frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+    decoded_frame = ist->decoded_frame;
+
+    ret = avcodec_decode_video2(ist->st->codec,
+                                decoded_frame, got_output, pkt);
+    if (!*got_output || ret < 0) {
+        if (!pkt->size)
+            send_eof_to_filters(ist);
+        return ret;
     }
 
-    av_frame_unref(ist->filter_frame);
-    av_frame_unref(decoded_frame);
-    av_free(buffer_to_free);
+    decoded_frame->pts = guess_correct_pts(&ist->pts_ctx, decoded_frame->pkt_pts,
+                                           decoded_frame->pkt_dts);
+    pkt->size = 0;
+
+    err = process_video_frame(ist, decoded_frame);
     return err < 0 ? err : ret;
 }
 
@@ -1275,6 +1551,161 @@ static int transcode_subtitles(InputStream *ist, AVPacket *pkt, int *got_output)
     return ret;
 }
 
+static void update_video_next_dts(InputStream *ist, const AVPacket *pkt)
+{
+    if (pkt->duration)
+        ist->next_dts += av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
+    else if (ist->st->avg_frame_rate.num)
+        ist->next_dts += av_rescale_q(1, av_inv_q(ist->st->avg_frame_rate),
+                                      AV_TIME_BASE_Q);
+    else if (ist->st->codec->time_base.num != 0) {
+        int ticks      = ist->st->parser ? ist->st->parser->repeat_pict + 1 :
+                                           ist->st->codec->ticks_per_frame;
+        ist->next_dts += av_rescale_q(ticks, ist->st->codec->time_base, AV_TIME_BASE_Q);
+    }
+}
+
+#if HAVE_PTHREADS
+static int clone_packet(AVPacket *dst, const AVPacket *src)
+{
+    int i, ret;
+
+    if ((ret = av_new_packet(dst, src->size)) < 0)
+        return ret;
+    memcpy(dst->data, src->data, src->size);
+
+    dst->pts          = src->pts;
+    dst->dts          = src->dts;
+    dst->duration     = src->duration;
+    dst->flags        = src->flags;
+    dst->stream_index = src->stream_index;
+    dst->pos          = src->pos;
+
+    for (i = 0; i < src->side_data_elems; i++) {
+        uint8_t *sd = av_packet_new_side_data(dst, src->side_data[i].type,
+                                              src->side_data[i].size);
+        if (!sd) {
+            av_free_packet(dst);
+            return AVERROR(ENOMEM);
+        }
+        memcpy(sd, src->side_data[i].data, src->side_data[i].size);
+    }
+    return 0;
+}
+
+static void *decoder_thread(void *arg)
+{
+    InputStream    *ist = arg;
+    AVCodecContext *dec = ist->st->codec;
+    AVPacket pkt, avpkt;
+    int eof = 0, got_output;
+
+    while (!eof) {
+        if (tq_receive(&ist->dec_packets, &pkt, 1) < 0) {
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+            eof      = 1;
+        }
+        avpkt = pkt;
+
+        // while we have more to decode or while the decoder did output something on EOF
+        do {
+            QueuedFrame qf = { NULL };
+            int ret;
+
+            if (!(qf.frame = av_frame_alloc())) {
+                ret = AVERROR(ENOMEM);
+            } else if (dec->codec_type == AVMEDIA_TYPE_VIDEO) {
+                ret = avcodec_decode_video2(dec, qf.frame, &got_output, &avpkt);
+                if (ret >= 0 && got_output) {
+                    qf.frame->pts = guess_correct_pts(&ist->pts_ctx, qf.frame->pkt_pts,
+                                                      qf.frame->pkt_dts);
+                    ret = avpkt.size;
+                }
+            } else {
+                ret = avcodec_decode_audio4(dec, qf.frame, &got_output, &avpkt);
+                if (ret >= 0 && got_output && qf.frame->pts == AV_NOPTS_VALUE) {
+                    qf.frame->pts = avpkt.pts;
+                    avpkt.pts     = AV_NOPTS_VALUE;
+                }
+            }
+
+            if (ret < 0 || !got_output)
+                av_frame_free(&qf.frame);
+            if (ret < 0)
+                qf.error = ret;
+            if ((qf.frame || qf.error) && tq_send(&ist->dec_frames, &qf) < 0)
+                av_frame_free(&qf.frame);
+            if (ret < 0)
+                break;
+
+            avpkt.data += ret;
+            avpkt.size -= ret;
+        } while (avpkt.size > 0 || (eof && got_output));
+
+        av_free_packet(&pkt);
+    }
+
+    tq_send_eof(&ist->dec_frames);
+    return NULL;
+}
+
+/*
+ * Filter the frames output by the decoding thread of ist so far.
+ * If flush is set, wait until the decoder has been flushed.
+ */
+static int process_decoded_frames(InputStream *ist, int flush)
+{
+    QueuedFrame qf;
+    int ret, err = 0;
+
+    while ((ret = tq_receive(&ist->dec_frames, &qf, flush)) >= 0) {
+        if (!qf.frame) {
+            err = qf.error;
+            continue;
+        }
+
+        if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO)
+            ret = process_video_frame(ist, qf.frame);
+        else
+            ret = process_audio_frame(ist, qf.frame);
+        av_frame_free(&qf.frame);
+        if (ret < 0)
+            err = ret;
+    }
+
+    if (ret == AVERROR_EOF && !tq_finished(&ist->dec_frames)) {
+        tq_finish(&ist->dec_frames);
+        send_eof_to_filters(ist);
+    }
+
+    return err;
+}
+
+/* pass a packet (or EOF if pkt is NULL) to the decoding thread of ist */
+static int decode_packet_mt(InputStream *ist, const AVPacket *pkt)
+{
+    AVPacket dec_pkt;
+    int ret;
+
+    if (pkt) {
+        if ((ret = clone_packet(&dec_pkt, pkt)) < 0)
+            return ret;
+
+        ist->last_dts = ist->next_dts;
+        if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO)
+            update_video_next_dts(ist, pkt);
+
+        if (tq_send(&ist->dec_packets, &dec_pkt) < 0)
+            av_free_packet(&dec_pkt);
+    } else
+        tq_send_eof(&ist->dec_packets);
+
+    return process_decoded_frames(ist, !pkt);
+}
+#endif
+
 /* pkt = NULL means EOF (needed to flush decoder buffers) */
 static int output_packet(InputStream *ist, const AVPacket *pkt)
 {
@@ -1287,6 +1718,10 @@ static int output_packet(InputStream *ist, const AVPacket *pkt)
 
     if (pkt == NULL) {
         /* EOF handling */
+#if HAVE_PTHREADS
+        if (ist->dec_thread_active)
+            return decode_packet_mt(ist, NULL);
+#endif
         av_init_packet(&avpkt);
         avpkt.data = NULL;
         avpkt.size = 0;
@@ -1298,6 +1733,16 @@ static int output_packet(InputStream *ist, const AVPacket *pkt)
     if (pkt->dts != AV_NOPTS_VALUE)
         ist->next_dts = ist->last_dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
 
+#if HAVE_PTHREADS
+    if (ist->dec_thread_active) {
+        int ret = decode_packet_mt(ist, pkt);
+        if (ret < 0)
+            return ret;
+        /* the packet has been passed to the decoding thread */
+        avpkt.size = 0;
+    }
+#endif
+
     // while we have more to decode or while the decoder did output something on EOF
     while (ist->decoding_needed && (avpkt.size > 0 || (!pkt && got_output))) {
         int ret = 0;
@@ -1317,16 +1762,7 @@ static int output_packet(InputStream *ist, const AVPacket *pkt)
             break;
         case AVMEDIA_TYPE_VIDEO:
             ret = decode_video    (ist, &avpkt, &got_output);
-            if (avpkt.duration)
-                ist->next_dts += av_rescale_q(avpkt.duration, ist->st->time_base, AV_TIME_BASE_Q);
-            else if (ist->st->avg_frame_rate.num)
-                ist->next_dts += av_rescale_q(1, av_inv_q(ist->st->avg_frame_rate),
-                                              AV_TIME_BASE_Q);
-            else if (ist->st->codec->time_base.num != 0) {
-                int ticks      = ist->st->parser ? ist->st->parser->repeat_pict + 1 :
-                                                   ist->st->codec->ticks_per_frame;
-                ist->next_dts += av_rescale_q(ticks, ist->st->codec->time_base, AV_TIME_BASE_Q);
-            }
+            update_video_next_dts(ist, &avpkt);
             break;
         case AVMEDIA_TYPE_SUBTITLE:
             ret = transcode_subtitles(ist, &avpkt, &got_output);
@@ -1892,6 +2328,11 @@ static int transcode_init(void)
         print_sdp();
     }
 
+    if (vstats_filename && !(vstats_file = fopen(vstats_filename, "w"))) {
+        perror("fopen");
+        exit(1);
+    }
+
     return 0;
 }
 
@@ -1904,14 +2345,35 @@ static int need_output(void)
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int threaded         = 0;
 
-        if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+#if HAVE_PTHREADS
+        if (ost->enc_thread_active) {
+            if (tq_finished(&ost->enc_frames)) {
+                if (ost->finish_file)
+                    finish_output_file(of);
+                continue;
+            }
+            /* once it got EOF, the encoding thread finishes on its own */
+            if (ost->enc_frames.eof)
+                continue;
+            threaded = 1;
+        }
+#endif
+        if (!threaded && ost->finished)
             continue;
-        if (ost->frame_number >= ost->max_frames) {
-            int j;
-            for (j = 0; j < of->ctx->nb_streams; j++)
-                output_streams[of->ost_index + j]->finished = 1;
+
+        if (os->pb) {
+            int64_t size;
+
+            lock_output_file(of);
+            size = avio_tell(os->pb);
+            unlock_output_file(of);
+            if (size >= of->limit_filesize)
+                continue;
+        }
+        if (!threaded && ost->frame_number >= ost->max_frames) {
+            finish_output_file(of);
             continue;
         }
 
@@ -2052,6 +2514,186 @@ static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 
     return ret;
 }
+
+#define PACKET_QUEUE_SIZE 8
+#define FRAME_QUEUE_SIZE  8
+
+/*
+ * Filter and encode all the frames lavfi can output for ost now.
+ * Return 0 when more input is needed or the stream is finished.
+ */
+static int poll_filter_mt(OutputStream *ost)
+{
+    int ret;
+
+    while (!ost->finished) {
+        ret = poll_filter(ost);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF)
+            ost->finished = 1;
+        else if (ret < 0)
+            return ret;
+        else if (ost->frame_number >= ost->max_frames)
+            ost->finished = ost->finish_file = 1;
+    }
+    return 0;
+}
+
+/* run the simple filtergraph and the encoder of ost */
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    FilterGraph   *fg = ost->filter->graph;
+    QueuedFrame qf;
+    int ret = 0;
+
+    while (!ost->finished && tq_receive(&ost->enc_frames, &qf, 1) >= 0) {
+        if (qf.reconfigure) {
+            if (poll_filter_mt(ost) < 0)
+                av_log(NULL, AV_LOG_ERROR, "Error while filtering.\n");
+            /* the decoder context belongs to the decoding thread, the
+             * parameters come from the frame */
+            ifilter_parameters_from_frame(fg->inputs[0], qf.frame);
+            if ((ret = configure_filtergraph(fg)) < 0) {
+                av_log(NULL, AV_LOG_FATAL, "Error reinitializing filters!\n");
+                av_frame_free(&qf.frame);
+                break;
+            }
+        }
+
+        ret = av_buffersrc_add_frame(fg->inputs[0]->filter, qf.frame);
+        av_frame_free(&qf.frame);
+        if (ret >= 0)
+            ret = poll_filter_mt(ost);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error while filtering.\n");
+            if (exit_on_error)
+                break;
+            ret = 0;
+        }
+    }
+
+    /* exiting from here would free everything under the other threads,
+     * leave it to the main thread */
+    if (ret < 0) {
+        tq_abort(&ost->enc_frames, ret);
+        return NULL;
+    }
+
+    /* drain the filtergraph, unless the main thread asked us to stop */
+    if (!ost->finished && !tq_finished(&ost->enc_frames)) {
+        av_buffersrc_add_frame(fg->inputs[0]->filter, NULL);
+        if (poll_filter_mt(ost) < 0)
+            av_log(NULL, AV_LOG_ERROR, "Error while filtering.\n");
+    }
+    flush_encoder(ost);
+
+    tq_finish(&ost->enc_frames);
+    return NULL;
+}
+
+/* Return the error an encoding thread failed with, if any. */
+static int pipeline_threads_error(void)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (ost->enc_thread_active && (ret = tq_error(&ost->enc_frames)) < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Encoding thread for output stream "
+                   "#%d:%d failed.\n", ost->file_index, ost->index);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static void free_pipeline_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        if (!ist->dec_thread_active || !ist->dec_packets.fifo)
+            continue;
+
+        tq_send_eof(&ist->dec_packets);
+        pthread_join(ist->dec_thread, NULL);
+        tq_free(&ist->dec_packets, free_queued_packet);
+        tq_free(&ist->dec_frames,  free_queued_frame);
+    }
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->enc_thread_active || !ost->enc_frames.fifo)
+            continue;
+
+        tq_send_eof(&ost->enc_frames);
+        pthread_join(ost->enc_thread, NULL);
+        tq_free(&ost->enc_frames, free_queued_frame);
+    }
+}
+
+static int init_pipeline_threads(void)
+{
+    int i, ret;
+
+    if (!pipeline_threads)
+        return 0;
+
+    for (i = 0; i < nb_output_files; i++)
+        pthread_mutex_init(&output_files[i]->mux_lock, NULL);
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        /* complex filtergraphs may be fed from several input streams and
+         * feed several output streams, so they stay in the main thread;
+         * -shortest relies on the main thread encoding the streams of a
+         * file in timestamp order */
+        if (!ost->encoding_needed || !ost->filter || ost->filter->graph->graph_desc ||
+            output_files[ost->file_index]->shortest)
+            continue;
+
+        if ((ret = tq_init(&ost->enc_frames, sizeof(QueuedFrame), FRAME_QUEUE_SIZE)) < 0)
+            return ret;
+        if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+            tq_free(&ost->enc_frames, free_queued_frame);
+            return AVERROR(ret);
+        }
+        ost->enc_thread_active = 1;
+    }
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        enum AVMediaType type = ist->st->codec->codec_type;
+
+        if (!ist->decoding_needed ||
+            (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO))
+            continue;
+
+        /* dec_frames is not bounded, as the decoder thread waiting for
+         * room in it while the main thread waits for room in dec_packets
+         * would deadlock. The main thread drains it after each packet it
+         * sends, so it holds at most the frames decoded from
+         * PACKET_QUEUE_SIZE + 1 packets. */
+        if ((ret = tq_init(&ist->dec_packets, sizeof(AVPacket), PACKET_QUEUE_SIZE)) < 0 ||
+            (ret = tq_init(&ist->dec_frames, sizeof(QueuedFrame), 0)) < 0)
+            return ret;
+        if ((ret = pthread_create(&ist->dec_thread, NULL, decoder_thread, ist))) {
+            tq_free(&ist->dec_packets, free_queued_packet);
+            tq_free(&ist->dec_frames,  free_queued_frame);
+            return AVERROR(ret);
+        }
+        ist->dec_thread_active = 1;
+    }
+
+    return 0;
+}
 #endif
 
 static int get_input_packet(InputFile *f, AVPacket *pkt)
@@ -2223,9 +2865,20 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_pipeline_threads()) < 0)
+        goto fail;
+#else
+    if (pipeline_threads)
+        av_log(NULL, AV_LOG_WARNING, "-pipeline_threads needs pthreads support, "
+               "ignoring it.\n");
 #endif
 
     while (!received_sigterm) {
+#if HAVE_PTHREADS
+        if ((ret = pipeline_threads_error()) < 0)
+            goto fail;
+#endif
+
         /* check if there's any stream where output is still needed */
         if (!need_output()) {
             av_log(NULL, AV_LOG_VERBOSE, "No more output streams to write to, finishing.\n");
@@ -2262,6 +2915,9 @@ static int transcode(void)
             output_packet(ist, NULL);
         }
     }
+#if HAVE_PTHREADS
+    free_pipeline_threads();
+#endif
     poll_filters();
     flush_encoders();
 
@@ -2299,6 +2955,7 @@ static int transcode(void)
  fail:
 #if HAVE_PTHREADS
     free_input_threads();
+    free_pipeline_threads();
 #endif
 
     if (output_streams) {
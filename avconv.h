@@ -170,6 +170,15 @@ typedef struct InputFilter {
     struct InputStream *ist;
     struct FilterGraph *graph;
     uint8_t            *name;
+
+    /* parameters the buffer source is configured with, taken from the
+     * decoder until the first frame is sent (format < 0), from the frames
+     * afterwards */
+    int                 format;
+    int                 width, height;
+    AVRational          sample_aspect_ratio;
+    int                 sample_rate;
+    uint64_t            channel_layout;
 } InputFilter;
 
 typedef struct OutputFilter {
@@ -194,6 +203,20 @@ typedef struct FilterGraph {
     int         nb_outputs;
 } FilterGraph;
 
+#if HAVE_PTHREADS
+/* fifo passing packets or frames from one thread to another */
+typedef struct ThreadQueue {
+    AVFifoBuffer   *fifo;
+    int             elem_size;
+    int             max_elems;  /* 0 means the queue grows as needed */
+    int             eof;        /* the producer will not send anything more */
+    int             finished;   /* the consumer will not read anything more */
+    int             error;      /* why the consumer finished, if it failed */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} ThreadQueue;
+#endif
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -229,6 +252,14 @@ typedef struct InputStream {
      * currently video and audio only */
     InputFilter **filters;
     int        nb_filters;
+
+#if HAVE_PTHREADS
+    /* decoding thread, used with -pipeline_threads */
+    pthread_t   dec_thread;
+    int         dec_thread_active;
+    ThreadQueue dec_packets;    /* packets to decode, filled by the main thread */
+    ThreadQueue dec_frames;     /* decoded frames, drained by the main thread */
+#endif
 } InputStream;
 
 typedef struct InputFile {
@@ -270,6 +301,8 @@ typedef struct OutputStream {
     AVCodec *enc;
     int64_t max_frames;
     AVFrame *filtered_frame;
+    int64_t data_size;       /* bytes of encoded data written to the muxer */
+    int frames_dropped;
 
     /* video only */
     AVRational frame_rate;
@@ -299,6 +332,15 @@ typedef struct OutputStream {
     int copy_initial_nonkeyframes;
 
     enum AVPixelFormat pix_fmts[2];
+
+#if HAVE_PTHREADS
+    /* filtering and encoding thread, used with -pipeline_threads */
+    pthread_t   enc_thread;
+    int         enc_thread_active;
+    ThreadQueue enc_frames;     /* decoded frames to filter and encode */
+    int         finish_file;    /* set by the encoding thread when all the
+                                   streams of its file should be finished */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -310,6 +352,10 @@ typedef struct OutputFile {
     uint64_t limit_filesize;
 
     int shortest;
+
+#if HAVE_PTHREADS
+    pthread_mutex_t mux_lock;   /* serializes muxing with -pipeline_threads */
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -342,6 +388,8 @@ extern int copy_tb;
 extern int exit_on_error;
 extern int print_stats;
 extern int qp_hist;
+extern int pipeline_threads;
+extern int filter_threads;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -359,6 +407,7 @@ void assert_avoptions(AVDictionary *m);
 int guess_input_channel_layout(InputStream *ist);
 
 int configure_filtergraph(FilterGraph *fg);
+void ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
 FilterGraph *init_simple_filtergraph(InputStream *ist, OutputStream *ost);
@@ -91,8 +91,9 @@ FilterGraph *init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     GROW_ARRAY(fg->inputs, fg->nb_inputs);
     if (!(fg->inputs[0] = av_mallocz(sizeof(*fg->inputs[0]))))
         exit(1);
-    fg->inputs[0]->ist   = ist;
-    fg->inputs[0]->graph = fg;
+    fg->inputs[0]->ist    = ist;
+    fg->inputs[0]->graph  = fg;
+    fg->inputs[0]->format = -1;
 
     GROW_ARRAY(ist->filters, ist->nb_filters);
     ist->filters[ist->nb_filters - 1] = fg->inputs[0];
@@ -166,8 +167,9 @@ static void init_input_filter(FilterGraph *fg, AVFilterInOut *in)
     GROW_ARRAY(fg->inputs, fg->nb_inputs);
     if (!(fg->inputs[fg->nb_inputs - 1] = av_mallocz(sizeof(*fg->inputs[0]))))
         exit(1);
-    fg->inputs[fg->nb_inputs - 1]->ist   = ist;
-    fg->inputs[fg->nb_inputs - 1]->graph = fg;
+    fg->inputs[fg->nb_inputs - 1]->ist    = ist;
+    fg->inputs[fg->nb_inputs - 1]->graph  = fg;
+    fg->inputs[fg->nb_inputs - 1]->format = -1;
 
     GROW_ARRAY(ist->filters, ist->nb_filters);
     ist->filters[ist->nb_filters - 1] = fg->inputs[fg->nb_inputs - 1];
@@ -356,17 +358,21 @@ static int configure_input_video_filter(FilterGraph *fg, InputFilter *ifilter,
     InputStream *ist = ifilter->ist;
     AVRational tb = ist->framerate.num ? av_inv_q(ist->framerate) :
                                          ist->st->time_base;
-    AVRational sar;
     char args[255], name[255];
     int pad_idx = in->pad_idx;
     int ret;
 
-    sar = ist->st->sample_aspect_ratio.num ?
-          ist->st->sample_aspect_ratio :
-          ist->st->codec->sample_aspect_ratio;
-    snprintf(args, sizeof(args), "%d:%d:%d:%d:%d:%d:%d", ist->st->codec->width,
-             ist->st->codec->height, ist->st->codec->pix_fmt,
-             tb.num, tb.den, sar.num, sar.den);
+    if (ifilter->format < 0) {
+        ifilter->format              = ist->st->codec->pix_fmt;
+        ifilter->width               = ist->st->codec->width;
+        ifilter->height              = ist->st->codec->height;
+        ifilter->sample_aspect_ratio = ist->st->sample_aspect_ratio.num ?
+                                       ist->st->sample_aspect_ratio :
+                                       ist->st->codec->sample_aspect_ratio;
+    }
+    snprintf(args, sizeof(args), "%d:%d:%d:%d:%d:%d:%d", ifilter->width,
+             ifilter->height, ifilter->format, tb.num, tb.den,
+             ifilter->sample_aspect_ratio.num, ifilter->sample_aspect_ratio.den);
     snprintf(name, sizeof(name), "graph %d input from stream %d:%d", fg->index,
              ist->file_index, ist->st->index);
 
@@ -407,12 +413,17 @@ static int configure_input_audio_filter(FilterGraph *fg, InputFilter *ifilter,
     char args[255], name[255];
     int ret;
 
+    if (ifilter->format < 0) {
+        ifilter->format         = ist->st->codec->sample_fmt;
+        ifilter->sample_rate    = ist->st->codec->sample_rate;
+        ifilter->channel_layout = ist->st->codec->channel_layout;
+    }
     snprintf(args, sizeof(args), "time_base=%d/%d:sample_rate=%d:sample_fmt=%s"
              ":channel_layout=0x%"PRIx64,
-             1, ist->st->codec->sample_rate,
-             ist->st->codec->sample_rate,
-             av_get_sample_fmt_name(ist->st->codec->sample_fmt),
-             ist->st->codec->channel_layout);
+             1, ifilter->sample_rate,
+             ifilter->sample_rate,
+             av_get_sample_fmt_name(ifilter->format),
+             ifilter->channel_layout);
     snprintf(name, sizeof(name), "graph %d input from stream %d:%d", fg->index,
              ist->file_index, ist->st->index);
 
@@ -491,6 +502,21 @@ static int configure_input_filter(FilterGraph *fg, InputFilter *ifilter,
     }
 }
 
+/*
+ * Take the parameters the buffer source of ifilter is configured with from
+ * frame, which must have gone through the same processing as the frames
+ * sent to it.
+ */
+void ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame)
+{
+    ifilter->format              = frame->format;
+    ifilter->width               = frame->width;
+    ifilter->height              = frame->height;
+    ifilter->sample_aspect_ratio = frame->sample_aspect_ratio;
+    ifilter->sample_rate         = frame->sample_rate;
+    ifilter->channel_layout      = frame->channel_layout;
+}
+
 int configure_filtergraph(FilterGraph *fg)
 {
     AVFilterInOut *inputs, *outputs, *cur;
@@ -501,6 +527,7 @@ int configure_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->nb_threads = filter_threads;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
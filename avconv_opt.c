@@ -70,6 +70,8 @@ int copy_tb           = 1;
 int exit_on_error     = 0;
 int print_stats       = 1;
 int qp_hist           = 0;
+int pipeline_threads  = 0;
+int filter_threads    = 0;
 
 static int file_overwrite     = 0;
 static int video_discard      = 0;
@@ -2192,6 +2194,10 @@ const OptionDef options[] = {
         "timestamp discontinuity delta threshold", "threshold" },
     { "xerror",         OPT_BOOL | OPT_EXPERT,                       { &exit_on_error },
         "exit on error", "error" },
+    { "pipeline_threads", OPT_BOOL | OPT_EXPERT,                     { &pipeline_threads },
+        "decode, filter and encode each stream in its own thread" },
+    { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT,              { &filter_threads },
+        "number of threads used by slice threaded filters (0 = auto)", "count" },
     { "copyinkf",       OPT_BOOL | OPT_EXPERT | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(copy_initial_nonkeyframes) },
         "copy initial non-keyframes" },
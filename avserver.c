@@ -38,6 +38,7 @@
 #include "libavformat/url.h"
 
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/lfg.h"
 #include "libavutil/dict.h"
 #include "libavutil/intreadwrite.h"
@@ -51,9 +52,16 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include <errno.h>
 #include <time.h>
 #include <sys/wait.h>
@@ -110,6 +118,11 @@ static const char *http_state[] = {
 
 #define SYNC_TIMEOUT (10 * 1000)
 
+/* number of muxed packets kept for the clients of a shared output */
+#define SHARED_OUTPUT_SEGMENTS 1024
+/* maximum number of muxed packets sent with one writev() call */
+#define SHARED_OUTPUT_IOV 16
+
 typedef struct RTSPActionServerSetup {
     uint32_t ipaddr;
     char transport_option[512];
@@ -126,6 +139,19 @@ typedef struct HTTPContext {
     int fd; /* socket file descriptor */
     struct sockaddr_in from_addr; /* origin */
     struct pollfd *poll_entry; /* used when polling */
+#if HAVE_EPOLL_CREATE1
+    struct EventLoop *loop; /* loop serving the connection, NULL when polling */
+    struct pollfd epoll_entry; /* poll_entry when using epoll */
+    int epoll_events; /* events the fd is registered with, 0 if none */
+    /* links in the changed and ready lists of the loop, the prev pointers
+       are NULL when the connection is not on the list */
+    struct HTTPContext *next_changed, **prev_changed;
+    struct HTTPContext *next_ready, **prev_ready;
+#endif
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+    struct Worker *worker; /* non NULL if served by a worker thread */
+    int64_t handover_count; /* data_count when handed over to the worker */
+#endif
     int64_t timeout;
     uint8_t *buffer_ptr, *buffer_end;
     int http_error;
@@ -183,8 +209,36 @@ typedef struct HTTPContext {
     /* RTP/TCP specific */
     struct HTTPContext *rtsp_c;
     uint8_t *packet_buffer, *packet_buffer_ptr, *packet_buffer_end;
+
+    /* shared output specific */
+    struct SharedOutput *shared; /* non NULL if the client reads a shared output */
+    AVBufferRef *shared_buf; /* data between buffer_ptr and buffer_end */
+    int64_t shared_seq; /* next segment to send */
+    int shared_need_key; /* skip segments until a key frame */
 } HTTPContext;
 
+/* output of a stream muxed once and sent to all its HTTP clients. The
+   muxed packets are kept as refcounted segments in a ring, from which
+   each client sends at its own pace. */
+typedef struct SharedOutput {
+    AVFormatContext *fmt_in; /* reader of the feed */
+    AVFormatContext fmt_ctx; /* muxer */
+    AVBufferRef *header;
+    AVBufferRef *segments[SHARED_OUTPUT_SEGMENTS];
+    int key[SHARED_OUTPUT_SEGMENTS]; /* the segment starts with a key frame */
+    int64_t first_seq, next_seq; /* segments held in the ring */
+    int64_t last_key_seq; /* last key frame segment, -1 if none */
+    int got_key_frame;
+    int pending_key; /* a key frame was written but not output yet */
+    int feed_lost; /* the feeder disconnected, clients stop when they catch up */
+    int nb_clients;
+#if HAVE_PTHREADS
+    /* protects the ring and feed_lost, which the worker threads read while
+       the main thread adds the new feed data */
+    pthread_mutex_t lock;
+#endif
+} SharedOutput;
+
 /* each generated stream is described here */
 enum StreamType {
     STREAM_TYPE_LIVE,
@@ -253,6 +307,9 @@ typedef struct FFStream {
     int64_t feed_write_index;   /* current write position in feed (it wraps around) */
     int64_t feed_size;          /* current size of feed */
     struct FFStream *next_feed;
+
+    int share_output;    /* mux once for all HTTP clients */
+    SharedOutput *shared;
 } FFStream;
 
 typedef struct FeedData {
@@ -268,8 +325,44 @@ static HTTPContext *first_http_ctx;
 static FFStream *first_feed;   /* contains only feeds */
 static FFStream *first_stream; /* contains all streams, including feeds */
 
+#if HAVE_EPOLL_CREATE1
+/* connections of one thread waiting for events with epoll */
+typedef struct EventLoop {
+    int epoll_fd;
+    HTTPContext *first_changed; /* connections whose events to wait for may have changed */
+    HTTPContext *first_ready;   /* connections to handle in this iteration */
+} EventLoop;
+
+static EventLoop *http_loop; /* loop of the main thread, NULL when polling */
+#endif
+
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+/* thread sending shared outputs to the HTTP clients the main thread hands
+   over once their reply header is sent. Each worker owns its connections,
+   the main thread only gets them back to close them. */
+typedef struct Worker {
+    pthread_t thread;
+    EventLoop loop;
+    int wake_fd[2];         /* pipe waking up the worker */
+    int64_t cur_time;
+    HTTPContext *first_ctx; /* connections served by the worker */
+    pthread_mutex_t lock;   /* protects the fields below */
+    HTTPContext *incoming;  /* connections handed over, not served yet */
+    int feed_update;        /* new data or a lost feeder in the shared outputs */
+    int nb_ctx;             /* number of connections served or incoming */
+    int failed;             /* the worker stopped on an error */
+} Worker;
+
+static Worker *workers;
+static int nb_running_workers;
+static int main_wake_fd[2] = { -1, -1 }; /* pipe waking up the main thread */
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static HTTPContext *done_ctx; /* connections the workers are done with */
+#endif
+
 static void new_connection(int server_fd, int is_rtsp);
 static void close_connection(HTTPContext *c);
+static void connection_changed(HTTPContext *c);
 
 /* HTTP handling */
 static int handle_connection(HTTPContext *c);
@@ -277,6 +370,8 @@ static int http_parse_request(HTTPContext *c);
 static int http_send_data(HTTPContext *c);
 static void compute_status(HTTPContext *c);
 static int open_input_stream(HTTPContext *c, const char *info);
+static int join_shared_output(HTTPContext *c);
+static void leave_shared_output(HTTPContext *c);
 static int http_start_receive_data(HTTPContext *c);
 static int http_receive_data(HTTPContext *c);
 
@@ -314,6 +409,9 @@ static unsigned int nb_max_http_connections = 2000;
 static unsigned int nb_max_connections = 5;
 static unsigned int nb_connections;
 
+/* number of threads sending shared outputs, -1 for one per CPU core */
+static int nb_workers = -1;
+
 static uint64_t max_bandwidth = 1000;
 static uint64_t current_bandwidth;
 
@@ -403,6 +501,26 @@ static char *ctime1(char *buf2)
     return buf2;
 }
 
+#if HAVE_PTHREADS
+/* serializes the logging of the main thread and the workers */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock_log(void)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&log_lock);
+#endif
+}
+
+static void unlock_log(void)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&log_lock);
+#endif
+}
+
+/* must be called with the log locked */
 static void http_vlog(const char *fmt, va_list vargs)
 {
     static int print_prefix = 1;
@@ -418,6 +536,20 @@ static void http_vlog(const char *fmt, va_list vargs)
     }
 }
 
+#ifdef __GNUC__
+__attribute__ ((format (printf, 1, 2)))
+#endif
+#ifdef __GNUC__
+__attribute__ ((format (printf, 1, 2)))
+#endif
+static void http_log_locked(const char *fmt, ...)
+{
+    va_list vargs;
+    va_start(vargs, fmt);
+    http_vlog(fmt, vargs);
+    va_end(vargs);
+}
+
 #ifdef __GNUC__
 __attribute__ ((format (printf, 1, 2)))
 #endif
@@ -425,7 +557,9 @@ static void http_log(const char *fmt, ...)
 {
     va_list vargs;
     va_start(vargs, fmt);
+    lock_log();
     http_vlog(fmt, vargs);
+    unlock_log();
     va_end(vargs);
 }
 
@@ -435,10 +569,12 @@ static void http_av_log(void *ptr, int level, const char *fmt, va_list vargs)
     AVClass *avc = ptr ? *(AVClass**)ptr : NULL;
     if (level > av_log_get_level())
         return;
+    lock_log();
     if (print_prefix && avc)
-        http_log("[%s @ %p]", avc->item_name(ptr), ptr);
+        http_log_locked("[%s @ %p]", avc->item_name(ptr), ptr);
     print_prefix = strstr(fmt, "\n") != NULL;
     http_vlog(fmt, vargs);
+    unlock_log();
 }
 
 static void log_connection(HTTPContext *c)
@@ -616,45 +752,82 @@ static void start_multicast(void)
 
             /* change state to send data */
             rtp_c->state = HTTPSTATE_SEND_DATA;
+            connection_changed(rtp_c);
         }
     }
 }
 
-/* main loop of the http server */
-static int http_server(void)
+/* return the poll events to wait for on the connection, and lower
+   *delay if it needs to be handled periodically */
+static int connection_poll_events(HTTPContext *c, int *delay)
 {
-    int server_fd = 0, rtsp_server_fd = 0;
-    int ret, delay, delay1;
-    struct pollfd *poll_table, *poll_entry;
-    HTTPContext *c, *c_next;
-
-    if(!(poll_table = av_mallocz((nb_max_http_connections + 2)*sizeof(*poll_table)))) {
-        http_log("Impossible to allocate a poll table handling %d connections.\n", nb_max_http_connections);
-        return -1;
+    switch(c->state) {
+    case HTTPSTATE_SEND_HEADER:
+    case RTSPSTATE_SEND_REPLY:
+    case RTSPSTATE_SEND_PACKET:
+        return POLLOUT;
+    case HTTPSTATE_SEND_DATA_HEADER:
+    case HTTPSTATE_SEND_DATA:
+    case HTTPSTATE_SEND_DATA_TRAILER:
+        if (!c->is_packetized) {
+            /* for TCP, we output as much as we can (may need to put a limit) */
+            return POLLOUT;
+        } else {
+            /* when avserver is doing the timing, we work by
+               looking at which packet need to be sent every
+               10 ms */
+            *delay = FFMIN(*delay, 10); /* one tick wait XXX: 10 ms assumed */
+        }
+        return 0;
+    case HTTPSTATE_WAIT_REQUEST:
+    case HTTPSTATE_RECEIVE_DATA:
+    case HTTPSTATE_WAIT_FEED:
+    case RTSPSTATE_WAIT_REQUEST:
+        /* need to catch errors */
+        return POLLIN; /* Maybe this will work */
+    default:
+        return 0;
     }
+}
 
-    if (my_http_addr.sin_port) {
-        server_fd = socket_open_listen(&my_http_addr);
-        if (server_fd < 0)
-            return -1;
-    }
+/* update the time and the feeders before handling the connections */
+static void prepare_iteration(void)
+{
+    cur_time = av_gettime() / 1000;
 
-    if (my_rtsp_addr.sin_port) {
-        rtsp_server_fd = socket_open_listen(&my_rtsp_addr);
-        if (rtsp_server_fd < 0)
-            return -1;
+    if (need_to_start_children) {
+        need_to_start_children = 0;
+        start_children(first_feed);
     }
+}
 
-    if (!rtsp_server_fd && !server_fd) {
-        http_log("HTTP and RTSP disabled.\n");
-        return -1;
-    }
+static void handle_connections(void)
+{
+    HTTPContext *c, *c_next;
 
-    http_log("AVserver started.\n");
+    prepare_iteration();
 
-    start_children(first_feed);
+    /* now handle the events */
+    for(c = first_http_ctx; c != NULL; c = c_next) {
+        c_next = c->next;
+        if (handle_connection(c) < 0) {
+            /* close and free the connection */
+            log_connection(c);
+            close_connection(c);
+        }
+    }
+}
 
-    start_multicast();
+static int poll_loop(int server_fd, int rtsp_server_fd)
+{
+    int ret, delay;
+    struct pollfd *poll_table, *poll_entry;
+    HTTPContext *c;
+
+    if(!(poll_table = av_mallocz((nb_max_http_connections + 2)*sizeof(*poll_table)))) {
+        http_log("Impossible to allocate a poll table handling %d connections.\n", nb_max_http_connections);
+        return -1;
+    }
 
     for(;;) {
         poll_entry = poll_table;
@@ -670,53 +843,17 @@ static int http_server(void)
         }
 
         /* wait for events on each HTTP handle */
-        c = first_http_ctx;
         delay = 1000;
-        while (c != NULL) {
-            int fd;
-            fd = c->fd;
-            switch(c->state) {
-            case HTTPSTATE_SEND_HEADER:
-            case RTSPSTATE_SEND_REPLY:
-            case RTSPSTATE_SEND_PACKET:
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLOUT;
-                poll_entry++;
-                break;
-            case HTTPSTATE_SEND_DATA_HEADER:
-            case HTTPSTATE_SEND_DATA:
-            case HTTPSTATE_SEND_DATA_TRAILER:
-                if (!c->is_packetized) {
-                    /* for TCP, we output as much as we can (may need to put a limit) */
-                    c->poll_entry = poll_entry;
-                    poll_entry->fd = fd;
-                    poll_entry->events = POLLOUT;
-                    poll_entry++;
-                } else {
-                    /* when avserver is doing the timing, we work by
-                       looking at which packet need to be sent every
-                       10 ms */
-                    delay1 = 10; /* one tick wait XXX: 10 ms assumed */
-                    if (delay1 < delay)
-                        delay = delay1;
-                }
-                break;
-            case HTTPSTATE_WAIT_REQUEST:
-            case HTTPSTATE_RECEIVE_DATA:
-            case HTTPSTATE_WAIT_FEED:
-            case RTSPSTATE_WAIT_REQUEST:
-                /* need to catch errors */
+        for (c = first_http_ctx; c != NULL; c = c->next) {
+            int events = connection_poll_events(c, &delay);
+            if (events) {
                 c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLIN;/* Maybe this will work */
+                poll_entry->fd = c->fd;
+                poll_entry->events = events;
                 poll_entry++;
-                break;
-            default:
+            } else {
                 c->poll_entry = NULL;
-                break;
             }
-            c = c->next;
         }
 
         /* wait for an event on one connection. We poll at least every
@@ -724,26 +861,13 @@ static int http_server(void)
         do {
             ret = poll(poll_table, poll_entry - poll_table, delay);
             if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
-                ff_neterrno() != AVERROR(EINTR))
+                ff_neterrno() != AVERROR(EINTR)) {
+                av_free(poll_table);
                 return -1;
+            }
         } while (ret < 0);
 
-        cur_time = av_gettime() / 1000;
-
-        if (need_to_start_children) {
-            need_to_start_children = 0;
-            start_children(first_feed);
-        }
-
-        /* now handle the events */
-        for(c = first_http_ctx; c != NULL; c = c_next) {
-            c_next = c->next;
-            if (handle_connection(c) < 0) {
-                /* close and free the connection */
-                log_connection(c);
-                close_connection(c);
-            }
-        }
+        handle_connections();
 
         poll_entry = poll_table;
         if (server_fd) {
@@ -760,6 +884,562 @@ static int http_server(void)
     }
 }
 
+/* queue the connection for an update of the events it waits for. This is
+   done after handling it, and is needed whenever its state is changed
+   while another connection is handled. */
+static void connection_changed(HTTPContext *c)
+{
+#if HAVE_EPOLL_CREATE1
+    EventLoop *loop = c->loop;
+
+    if (!loop || c->prev_changed)
+        return;
+    c->next_changed = loop->first_changed;
+    if (c->next_changed)
+        c->next_changed->prev_changed = &c->next_changed;
+    c->prev_changed = &loop->first_changed;
+    loop->first_changed = c;
+#endif
+}
+
+#if HAVE_EPOLL_CREATE1
+/* queue the connection to be handled in this iteration */
+static void connection_ready(HTTPContext *c)
+{
+    EventLoop *loop = c->loop;
+
+    if (c->prev_ready)
+        return;
+    c->next_ready = loop->first_ready;
+    if (c->next_ready)
+        c->next_ready->prev_ready = &c->next_ready;
+    c->prev_ready = &loop->first_ready;
+    loop->first_ready = c;
+}
+
+static void unlink_changed(HTTPContext *c)
+{
+    if (!c->prev_changed)
+        return;
+    *c->prev_changed = c->next_changed;
+    if (c->next_changed)
+        c->next_changed->prev_changed = c->prev_changed;
+    c->prev_changed = NULL;
+}
+
+static void unlink_ready(HTTPContext *c)
+{
+    if (!c->prev_ready)
+        return;
+    *c->prev_ready = c->next_ready;
+    if (c->next_ready)
+        c->next_ready->prev_ready = c->prev_ready;
+    c->prev_ready = NULL;
+}
+
+/* remove the connection from its loop */
+static void detach_connection(HTTPContext *c)
+{
+    struct epoll_event ev = { 0 };
+
+    if (!c->loop)
+        return;
+    unlink_changed(c);
+    unlink_ready(c);
+    if (c->epoll_events)
+        epoll_ctl(c->loop->epoll_fd, EPOLL_CTL_DEL, c->fd, &ev);
+    c->epoll_events = 0;
+    c->loop = NULL;
+}
+
+/* register the events the connection waits for with its loop. A
+   connection that has to be handled periodically is also queued on the
+   ready list, and lowers *delay. */
+static int update_connection_events(HTTPContext *c, int *delay)
+{
+    struct epoll_event ev = { 0 };
+    int period = INT_MAX;
+    int wanted = connection_poll_events(c, &period);
+    int op;
+
+    if (period < INT_MAX) {
+        *delay = FFMIN(*delay, period);
+        connection_ready(c);
+    }
+    c->poll_entry = &c->epoll_entry;
+    c->epoll_entry.fd     = c->fd;
+    c->epoll_entry.events = wanted;
+    if (c->fd < 0 || wanted == c->epoll_events)
+        return 0;
+
+    op = !c->epoll_events ? EPOLL_CTL_ADD :
+         wanted           ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    ev.events   = (wanted & POLLIN  ? EPOLLIN  : 0) |
+                  (wanted & POLLOUT ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if (epoll_ctl(c->loop->epoll_fd, op, c->fd, &ev) < 0)
+        return -1;
+    c->epoll_events = wanted;
+    return 0;
+}
+
+/* queue the connection an event was received for */
+static void connection_event(HTTPContext *c, uint32_t e)
+{
+    c->epoll_entry.revents = (e & EPOLLIN  ? POLLIN  : 0) |
+                             (e & EPOLLOUT ? POLLOUT : 0) |
+                             (e & EPOLLERR ? POLLERR : 0) |
+                             (e & EPOLLHUP ? POLLHUP : 0);
+    connection_ready(c);
+}
+
+#if HAVE_PTHREADS
+static int open_wake_pipe(int fd[2])
+{
+    if (pipe(fd) < 0)
+        return -1;
+    fcntl(fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(fd[1], F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+static void wake_up(int fd)
+{
+    int ret;
+
+    /* if the pipe is full, wake ups are pending already */
+    do {
+        ret = write(fd, "", 1);
+    } while (ret < 0 && errno == EINTR);
+}
+
+static void drain_wake_ups(int fd)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+/* hand the connection over to the least loaded worker, return -1 if all
+   of them failed and the main thread has to keep it */
+static int hand_over_connection(HTTPContext *c)
+{
+    Worker *w;
+    HTTPContext **cp;
+    int i, nb_ctx;
+
+    /* the chosen worker may fail before it is locked again */
+    for (;;) {
+        w      = NULL;
+        nb_ctx = INT_MAX;
+        for (i = 0; i < nb_running_workers; i++) {
+            pthread_mutex_lock(&workers[i].lock);
+            if (!workers[i].failed && workers[i].nb_ctx < nb_ctx) {
+                nb_ctx = workers[i].nb_ctx;
+                w      = &workers[i];
+            }
+            pthread_mutex_unlock(&workers[i].lock);
+        }
+        if (!w)
+            return -1;
+
+        pthread_mutex_lock(&w->lock);
+        if (!w->failed)
+            break;
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    for (cp = &first_http_ctx; *cp != c; cp = &(*cp)->next)
+        ;
+    *cp = c->next;
+    detach_connection(c);
+    c->worker         = w;
+    c->loop           = &w->loop;
+    c->handover_count = c->data_count;
+
+    c->next     = w->incoming;
+    w->incoming = c;
+    w->nb_ctx++;
+    pthread_mutex_unlock(&w->lock);
+    wake_up(w->wake_fd[1]);
+    return 0;
+}
+
+/* close the connections the workers are done with */
+static void close_done_connections(void)
+{
+    HTTPContext *c, *c_next;
+
+    drain_wake_ups(main_wake_fd[0]);
+    pthread_mutex_lock(&done_lock);
+    c        = done_ctx;
+    done_ctx = NULL;
+    pthread_mutex_unlock(&done_lock);
+
+    for (; c; c = c_next) {
+        c_next = c->next;
+        /* the workers leave the stream statistics to the main thread */
+        c->stream->bytes_served += c->data_count - c->handover_count;
+        c->worker = NULL;
+        log_connection(c);
+        close_connection(c);
+    }
+}
+
+/* wake up the workers for new data or a lost feeder in a shared output */
+static void wake_workers(void)
+{
+    int i;
+
+    for (i = 0; i < nb_running_workers; i++) {
+        Worker *w = &workers[i];
+
+        pthread_mutex_lock(&w->lock);
+        if (!w->feed_update) {
+            w->feed_update = 1;
+            wake_up(w->wake_fd[1]);
+        }
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+/* give a connection the worker is done with back to the main thread */
+static void worker_close_connection(Worker *w, HTTPContext *c)
+{
+    HTTPContext **cp;
+
+    for (cp = &w->first_ctx; *cp != c; cp = &(*cp)->next)
+        ;
+    *cp = c->next;
+    detach_connection(c);
+
+    pthread_mutex_lock(&w->lock);
+    w->nb_ctx--;
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_mutex_lock(&done_lock);
+    c->next  = done_ctx;
+    done_ctx = c;
+    pthread_mutex_unlock(&done_lock);
+    wake_up(main_wake_fd[1]);
+}
+
+/* stop taking connections after an error, and give the ones the worker
+   has back to the main thread, which closes them */
+static void worker_fail(Worker *w)
+{
+    HTTPContext *c, *incoming;
+
+    pthread_mutex_lock(&w->lock);
+    w->failed   = 1;
+    incoming    = w->incoming;
+    w->incoming = NULL;
+    pthread_mutex_unlock(&w->lock);
+
+    while ((c = incoming)) {
+        incoming     = c->next;
+        c->next      = w->first_ctx;
+        w->first_ctx = c;
+    }
+    while ((c = w->first_ctx))
+        worker_close_connection(w, c);
+}
+
+static void *worker_thread(void *arg)
+{
+    Worker *w = arg;
+    EventLoop *loop = &w->loop;
+    struct epoll_event events[64];
+    HTTPContext *c, *incoming;
+    sigset_t set;
+    int i, ret, feed_update;
+    int delay = -1; /* the shared outputs need no periodic handling */
+
+    /* leave the signals to the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    for(;;) {
+        pthread_mutex_lock(&w->lock);
+        incoming       = w->incoming;
+        feed_update    = w->feed_update;
+        w->incoming    = NULL;
+        w->feed_update = 0;
+        pthread_mutex_unlock(&w->lock);
+
+        while ((c = incoming)) {
+            incoming     = c->next;
+            c->next      = w->first_ctx;
+            w->first_ctx = c;
+            connection_changed(c);
+        }
+
+        /* wake up any waiting connections */
+        if (feed_update) {
+            for (c = w->first_ctx; c; c = c->next) {
+                if (c->state == HTTPSTATE_WAIT_FEED) {
+                    c->state = HTTPSTATE_SEND_DATA;
+                    connection_changed(c);
+                }
+            }
+        }
+
+        while ((c = loop->first_changed)) {
+            unlink_changed(c);
+            if (update_connection_events(c, &delay) < 0) {
+                http_log("epoll_ctl failed for fd %d: %s\n", c->fd, strerror(errno));
+                worker_close_connection(w, c);
+            }
+        }
+
+        ret = epoll_wait(loop->epoll_fd, events, FF_ARRAY_ELEMS(events), delay);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            http_log("epoll error in worker, stopping it: %s\n", strerror(errno));
+            worker_fail(w);
+            return NULL;
+        }
+
+        w->cur_time = av_gettime() / 1000;
+        for (i = 0; i < ret; i++) {
+            if (events[i].data.ptr == w)
+                drain_wake_ups(w->wake_fd[0]);
+            else
+                connection_event(events[i].data.ptr, events[i].events);
+        }
+
+        while ((c = loop->first_ready)) {
+            unlink_ready(c);
+            ret = handle_connection(c);
+            c->epoll_entry.revents = 0;
+            if (ret < 0)
+                worker_close_connection(w, c);
+            else
+                connection_changed(c);
+        }
+    }
+    return NULL;
+}
+
+/* start the worker threads, return the number of running ones */
+static int start_workers(void)
+{
+    struct epoll_event ev = { 0 };
+    int i, n = nb_workers < 0 ? av_cpu_count() : nb_workers;
+
+    if (!n)
+        return 0;
+    if (open_wake_pipe(main_wake_fd) < 0 ||
+        !(workers = av_mallocz(n * sizeof(*workers)))) {
+        http_log("Could not start the workers\n");
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        Worker *w = &workers[i];
+
+        w->loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (w->loop.epoll_fd < 0)
+            break;
+        if (open_wake_pipe(w->wake_fd) < 0) {
+            close(w->loop.epoll_fd);
+            break;
+        }
+        ev.events   = EPOLLIN;
+        ev.data.ptr = w;
+        pthread_mutex_init(&w->lock, NULL);
+        if (epoll_ctl(w->loop.epoll_fd, EPOLL_CTL_ADD, w->wake_fd[0], &ev) < 0 ||
+            pthread_create(&w->thread, NULL, worker_thread, w)) {
+            pthread_mutex_destroy(&w->lock);
+            close(w->wake_fd[0]);
+            close(w->wake_fd[1]);
+            close(w->loop.epoll_fd);
+            break;
+        }
+    }
+    if (i < n)
+        http_log("Could only start %d of %d workers: %s\n", i, n, strerror(errno));
+    return i;
+}
+#endif
+
+/* Same as poll_loop(), but each fd stays registered with the kernel. Only
+   the connections that were handled, or changed while handling another
+   one, get their events updated before waiting, and only the ones with
+   events or periodic work are handled after it, so that an iteration does
+   not cost anything for idle connections. They are only visited once per
+   second to check the request timeouts.
+   With workers, the clients of shared outputs are handed over to them once
+   their reply header is sent. */
+static int epoll_loop(EventLoop *loop, int server_fd, int rtsp_server_fd)
+{
+    int i, ret, delay, nb_events;
+    int new_http = 0, new_rtsp = 0, done = 0;
+    int64_t last_sweep = 0;
+    struct epoll_event *events, ev = { 0 };
+    HTTPContext *c;
+
+    nb_events = nb_max_http_connections + 3;
+    if (!(events = av_malloc(nb_events * sizeof(*events)))) {
+        http_log("Impossible to allocate an event table handling %d connections.\n", nb_max_http_connections);
+        return -1;
+    }
+
+    /* the listening sockets and the wake up pipe are told apart from the
+       connections by their data pointer, which points to the matching flag */
+    ev.events = EPOLLIN;
+    if (server_fd) {
+        ev.data.ptr = &new_http;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0)
+            goto fail;
+    }
+    if (rtsp_server_fd) {
+        ev.data.ptr = &new_rtsp;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, rtsp_server_fd, &ev) < 0)
+            goto fail;
+    }
+#if HAVE_PTHREADS
+    if (nb_running_workers) {
+        ev.data.ptr = &done;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, main_wake_fd[0], &ev) < 0)
+            goto fail;
+    }
+#endif
+
+    for(;;) {
+        /* update the registered events of the changed connections */
+        delay = 1000;
+        while ((c = loop->first_changed)) {
+            unlink_changed(c);
+            if (update_connection_events(c, &delay) < 0) {
+                http_log("epoll_ctl failed for fd %d: %s\n", c->fd, strerror(errno));
+                log_connection(c);
+                close_connection(c);
+            }
+        }
+
+        /* wait for an event on one connection. We poll at least every
+           second to handle timeouts */
+        do {
+            ret = epoll_wait(loop->epoll_fd, events, nb_events, delay);
+            if (ret < 0 && errno != EINTR)
+                goto fail;
+        } while (ret < 0);
+
+        for (i = 0; i < ret; i++) {
+            void *ptr = events[i].data.ptr;
+
+            if (ptr == &new_http || ptr == &new_rtsp || ptr == &done)
+                *(int *)ptr = 1;
+            else
+                connection_event(ptr, events[i].events);
+        }
+
+        prepare_iteration();
+
+        if (cur_time - last_sweep >= 1000) {
+            for (c = first_http_ctx; c != NULL; c = c->next)
+                if (c->state == HTTPSTATE_WAIT_REQUEST ||
+                    c->state == RTSPSTATE_WAIT_REQUEST)
+                    connection_ready(c);
+            last_sweep = cur_time;
+        }
+
+        /* now handle the events */
+        while ((c = loop->first_ready)) {
+            unlink_ready(c);
+            ret = handle_connection(c);
+            c->epoll_entry.revents = 0;
+            if (ret < 0) {
+                /* close and free the connection */
+                log_connection(c);
+                close_connection(c);
+#if HAVE_PTHREADS
+            } else if (nb_running_workers && c->shared &&
+                       c->state == HTTPSTATE_SEND_DATA_HEADER &&
+                       !hand_over_connection(c)) {
+                /* now served by a worker */
+#endif
+            } else
+                connection_changed(c);
+        }
+
+#if HAVE_PTHREADS
+        if (done)
+            close_done_connections();
+#endif
+
+        /* new HTTP/RTSP connection requests ? */
+        if (new_http)
+            new_connection(server_fd, 0);
+        if (new_rtsp)
+            new_connection(rtsp_server_fd, 1);
+        new_http = new_rtsp = done = 0;
+    }
+
+fail:
+    http_log("epoll error: %s\n", strerror(errno));
+    av_free(events);
+    return -1;
+}
+#endif
+
+/* main loop of the http server */
+static int http_server(void)
+{
+    int server_fd = 0, rtsp_server_fd = 0;
+#if HAVE_EPOLL_CREATE1
+    static EventLoop main_loop;
+#endif
+
+    if (my_http_addr.sin_port) {
+        server_fd = socket_open_listen(&my_http_addr);
+        if (server_fd < 0)
+            return -1;
+    }
+
+    if (my_rtsp_addr.sin_port) {
+        rtsp_server_fd = socket_open_listen(&my_rtsp_addr);
+        if (rtsp_server_fd < 0)
+            return -1;
+    }
+
+    if (!rtsp_server_fd && !server_fd) {
+        http_log("HTTP and RTSP disabled.\n");
+        return -1;
+    }
+
+    http_log("AVserver started.\n");
+
+    /* the loop has to exist before the first connections */
+#if HAVE_EPOLL_CREATE1
+    main_loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (main_loop.epoll_fd >= 0) {
+        http_loop = &main_loop;
+#if HAVE_PTHREADS
+        nb_running_workers = start_workers();
+#endif
+    } else
+        http_log("epoll_create1 failed, falling back to poll: %s\n", strerror(errno));
+#endif
+#if !HAVE_EPOLL_CREATE1 || !HAVE_PTHREADS
+    if (nb_workers > 0)
+        http_log("Workers are not supported on this platform.\n");
+#endif
+
+    start_children(first_feed);
+
+    start_multicast();
+
+#if HAVE_EPOLL_CREATE1
+    if (http_loop)
+        return epoll_loop(http_loop, server_fd, rtsp_server_fd);
+#endif
+    return poll_loop(server_fd, rtsp_server_fd);
+}
+
 /* start waiting for a new HTTP/RTSP request */
 static void start_wait_request(HTTPContext *c, int is_rtsp)
 {
@@ -830,6 +1510,10 @@ static void new_connection(int server_fd, int is_rtsp)
     nb_connections++;
 
     start_wait_request(c, is_rtsp);
+#if HAVE_EPOLL_CREATE1
+    c->loop = http_loop;
+#endif
+    connection_changed(c);
 
     return;
 
@@ -865,6 +1549,10 @@ static void close_connection(HTTPContext *c)
             c1->rtsp_c = NULL;
     }
 
+#if HAVE_EPOLL_CREATE1
+    detach_connection(c);
+#endif
+
     /* remove connection associated resources */
     if (c->fd >= 0)
         closesocket(c->fd);
@@ -912,6 +1600,9 @@ static void close_connection(HTTPContext *c)
     for(i=0; i<ctx->nb_streams; i++)
         av_free(ctx->streams[i]);
 
+    if (c->shared)
+        leave_shared_output(c);
+
     if (c->stream && !c->post && c->stream->stream_type == STREAM_TYPE_LIVE)
         current_bandwidth -= c->stream->bandwidth;
 
@@ -1833,8 +2524,14 @@ static int http_parse_request(HTTPContext *c)
     if (c->stream->stream_type == STREAM_TYPE_STATUS)
         goto send_status;
 
-    /* open input stream */
-    if (open_input_stream(c, info) < 0) {
+    /* open input stream, or use the shared output of the stream */
+    if (c->stream->share_output && c->stream->feed &&
+        c->stream->feed != c->stream) {
+        if (join_shared_output(c) < 0) {
+            snprintf(msg, sizeof(msg), "Input stream corresponding to '%s' not found", url);
+            goto send_error;
+        }
+    } else if (open_input_stream(c, info) < 0) {
         snprintf(msg, sizeof(msg), "Input stream corresponding to '%s' not found", url);
         goto send_error;
     }
@@ -2089,6 +2786,21 @@ static void compute_status(HTTPContext *c)
     avio_printf(pb, "Number of connections: %d / %d<br>\n",
                  nb_connections, nb_max_connections);
 
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+    if (nb_running_workers) {
+        /* their connections are not listed below */
+        avio_printf(pb, "Shared output clients of the %d workers:", nb_running_workers);
+        for (i = 0; i < nb_running_workers; i++) {
+            int nb_ctx;
+            pthread_mutex_lock(&workers[i].lock);
+            nb_ctx = workers[i].nb_ctx;
+            pthread_mutex_unlock(&workers[i].lock);
+            avio_printf(pb, " %d", nb_ctx);
+        }
+        avio_printf(pb, "<br>\n");
+    }
+#endif
+
     avio_printf(pb, "Bandwidth in use: %"PRIu64"k / %"PRIu64"k<br>\n",
                  current_bandwidth, max_bandwidth);
 
@@ -2227,6 +2939,61 @@ static int64_t get_packet_send_clock(HTTPContext *c)
 }
 
 
+/* set up the output format context of a stream, and write its header
+   to a dynamic buffer */
+static int open_output_context(AVFormatContext *ctx, FFStream *stream)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(*ctx));
+    av_dict_set(&ctx->metadata, "author"   , stream->author   , 0);
+    av_dict_set(&ctx->metadata, "comment"  , stream->comment  , 0);
+    av_dict_set(&ctx->metadata, "copyright", stream->copyright, 0);
+    av_dict_set(&ctx->metadata, "title"    , stream->title    , 0);
+
+    ctx->streams = av_mallocz(sizeof(AVStream *) * stream->nb_streams);
+
+    for(i=0;i<stream->nb_streams;i++) {
+        AVStream *src;
+        ctx->streams[i] = av_mallocz(sizeof(AVStream));
+        /* if file or feed, then just take streams from FFStream struct */
+        if (!stream->feed ||
+            stream->feed == stream)
+            src = stream->streams[i];
+        else
+            src = stream->feed->streams[stream->feed_streams[i]];
+
+        *(ctx->streams[i]) = *src;
+        ctx->streams[i]->priv_data = 0;
+        ctx->streams[i]->codec->frame_number = 0; /* XXX: should be done in
+                                       AVStream, not in codec */
+    }
+    /* set output format parameters */
+    ctx->oformat = stream->fmt;
+    ctx->nb_streams = stream->nb_streams;
+
+    /* prepare header and save header data in a stream */
+    if (avio_open_dyn_buf(&ctx->pb) < 0) {
+        /* XXX: potential leak */
+        return -1;
+    }
+    ctx->pb->seekable = 0;
+
+    /*
+     * HACK to avoid mpeg ps muxer to spit many underflow errors
+     * Default value from Libav
+     * Try to set it use configuration option
+     */
+    ctx->max_delay = (int)(0.7*AV_TIME_BASE);
+
+    if (avformat_write_header(ctx, NULL) < 0) {
+        http_log("Error writing output header\n");
+        return -1;
+    }
+    av_dict_free(&ctx->metadata);
+    return 0;
+}
+
 static int http_prepare_data(HTTPContext *c)
 {
     int i, len, ret;
@@ -2235,54 +3002,10 @@ static int http_prepare_data(HTTPContext *c)
     av_freep(&c->pb_buffer);
     switch(c->state) {
     case HTTPSTATE_SEND_DATA_HEADER:
-        memset(&c->fmt_ctx, 0, sizeof(c->fmt_ctx));
-        av_dict_set(&c->fmt_ctx.metadata, "author"   , c->stream->author   , 0);
-        av_dict_set(&c->fmt_ctx.metadata, "comment"  , c->stream->comment  , 0);
-        av_dict_set(&c->fmt_ctx.metadata, "copyright", c->stream->copyright, 0);
-        av_dict_set(&c->fmt_ctx.metadata, "title"    , c->stream->title    , 0);
-
-        c->fmt_ctx.streams = av_mallocz(sizeof(AVStream *) * c->stream->nb_streams);
-
-        for(i=0;i<c->stream->nb_streams;i++) {
-            AVStream *src;
-            c->fmt_ctx.streams[i] = av_mallocz(sizeof(AVStream));
-            /* if file or feed, then just take streams from FFStream struct */
-            if (!c->stream->feed ||
-                c->stream->feed == c->stream)
-                src = c->stream->streams[i];
-            else
-                src = c->stream->feed->streams[c->stream->feed_streams[i]];
-
-            *(c->fmt_ctx.streams[i]) = *src;
-            c->fmt_ctx.streams[i]->priv_data = 0;
-            c->fmt_ctx.streams[i]->codec->frame_number = 0; /* XXX: should be done in
-                                           AVStream, not in codec */
-        }
-        /* set output format parameters */
-        c->fmt_ctx.oformat = c->stream->fmt;
-        c->fmt_ctx.nb_streams = c->stream->nb_streams;
-
         c->got_key_frame = 0;
 
-        /* prepare header and save header data in a stream */
-        if (avio_open_dyn_buf(&c->fmt_ctx.pb) < 0) {
-            /* XXX: potential leak */
+        if (open_output_context(&c->fmt_ctx, c->stream) < 0)
             return -1;
-        }
-        c->fmt_ctx.pb->seekable = 0;
-
-        /*
-         * HACK to avoid mpeg ps muxer to spit many underflow errors
-         * Default value from Libav
-         * Try to set it use configuration option
-         */
-        c->fmt_ctx.max_delay = (int)(0.7*AV_TIME_BASE);
-
-        if (avformat_write_header(&c->fmt_ctx, NULL) < 0) {
-            http_log("Error writing output header\n");
-            return -1;
-        }
-        av_dict_free(&c->fmt_ctx.metadata);
 
         len = avio_close_dyn_buf(c->fmt_ctx.pb, &c->pb_buffer);
         c->buffer_ptr = c->pb_buffer;
@@ -2454,6 +3177,374 @@ static int http_prepare_data(HTTPContext *c)
     return 0;
 }
 
+static void lock_shared_output(SharedOutput *so)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&so->lock);
+#endif
+}
+
+static void unlock_shared_output(SharedOutput *so)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&so->lock);
+#endif
+}
+
+static void close_shared_output(FFStream *stream)
+{
+    SharedOutput *so = stream->shared;
+    AVFormatContext *ctx = &so->fmt_ctx;
+    uint8_t *buf;
+    int i;
+
+    if (avio_open_dyn_buf(&ctx->pb) >= 0) {
+        av_write_trailer(ctx);
+        avio_close_dyn_buf(ctx->pb, &buf);
+        av_free(buf);
+    }
+    av_freep(&ctx->priv_data);
+    for(i=0; i<ctx->nb_streams; i++)
+        av_free(ctx->streams[i]);
+    av_freep(&ctx->streams);
+    av_dict_free(&ctx->metadata);
+
+    if (so->fmt_in)
+        avformat_close_input(&so->fmt_in);
+    av_buffer_unref(&so->header);
+    for (i = 0; i < SHARED_OUTPUT_SEGMENTS; i++)
+        av_buffer_unref(&so->segments[i]);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&so->lock);
+#endif
+    av_freep(&stream->shared);
+}
+
+/* mux the packets available in the feed into at most max_segments new
+   segments of the shared output. Return the number of new segments or a
+   negative error code */
+static int read_shared_output(FFStream *stream, int max_segments)
+{
+    SharedOutput *so = stream->shared;
+    AVFormatContext *ctx = &so->fmt_ctx;
+    int nb_segments = 0;
+
+    ffm_set_write_index(so->fmt_in,
+                        stream->feed->feed_write_index,
+                        stream->feed->feed_size);
+
+    while (nb_segments < max_segments) {
+        AVBufferRef *segment;
+        AVStream *ist, *ost;
+        AVPacket pkt;
+        uint8_t *buf;
+        int i, len, ret, idx;
+
+        /* at the end of the feed data, wait for more */
+        if (av_read_frame(so->fmt_in, &pkt) < 0)
+            break;
+
+        for (i = 0; i < stream->nb_streams; i++)
+            if (stream->feed_streams[i] == pkt.stream_index)
+                break;
+        if (i == stream->nb_streams) {
+            av_free_packet(&pkt);
+            continue;
+        }
+        ist = so->fmt_in->streams[pkt.stream_index];
+        ost = ctx->streams[i];
+        if (pkt.flags & AV_PKT_FLAG_KEY &&
+            (ist->codec->codec_type == AVMEDIA_TYPE_VIDEO ||
+             stream->nb_streams == 1)) {
+            so->got_key_frame = 1;
+            so->pending_key   = 1;
+        }
+        if (stream->send_on_key && !so->got_key_frame) {
+            av_free_packet(&pkt);
+            continue;
+        }
+
+        pkt.stream_index = i;
+        if (pkt.dts != AV_NOPTS_VALUE)
+            pkt.dts = av_rescale_q(pkt.dts, ist->time_base, ost->time_base);
+        if (pkt.pts != AV_NOPTS_VALUE)
+            pkt.pts = av_rescale_q(pkt.pts, ist->time_base, ost->time_base);
+        pkt.duration = av_rescale_q(pkt.duration, ist->time_base, ost->time_base);
+
+        if ((ret = avio_open_dyn_buf(&ctx->pb)) < 0) {
+            av_free_packet(&pkt);
+            return ret;
+        }
+        ctx->pb->seekable = 0;
+        ret = av_write_frame(ctx, &pkt);
+        av_free_packet(&pkt);
+        len = avio_close_dyn_buf(ctx->pb, &buf);
+        if (ret < 0) {
+            http_log("Error writing frame to output\n");
+            av_free(buf);
+            return ret;
+        }
+        if (!len) {
+            av_free(buf);
+            continue;
+        }
+        segment = av_buffer_create(buf, len, av_buffer_default_free, NULL, 0);
+        if (!segment) {
+            av_free(buf);
+            return AVERROR(ENOMEM);
+        }
+
+        /* drop the oldest segment if the ring is full */
+        lock_shared_output(so);
+        if (so->next_seq - so->first_seq == SHARED_OUTPUT_SEGMENTS) {
+            av_buffer_unref(&so->segments[so->first_seq % SHARED_OUTPUT_SEGMENTS]);
+            so->first_seq++;
+        }
+        idx = so->next_seq % SHARED_OUTPUT_SEGMENTS;
+        so->segments[idx] = segment;
+        so->key[idx]      = so->pending_key;
+        if (so->pending_key)
+            so->last_key_seq = so->next_seq;
+        so->pending_key = 0;
+        so->next_seq++;
+        unlock_shared_output(so);
+        nb_segments++;
+    }
+    return nb_segments;
+}
+
+static int open_shared_output(FFStream *stream)
+{
+    SharedOutput *so;
+    int64_t stream_pos = av_gettime() - stream->prebuffer * (int64_t)1000;
+    uint8_t *buf;
+    int len, ret;
+
+    if (!(so = stream->shared = av_mallocz(sizeof(*so))))
+        return AVERROR(ENOMEM);
+    so->last_key_seq = -1;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&so->lock, NULL);
+#endif
+
+    if ((ret = avformat_open_input(&so->fmt_in, stream->feed->feed_filename,
+                                   stream->ifmt, &stream->in_opts)) < 0) {
+        http_log("could not open %s: %d\n", stream->feed->feed_filename, ret);
+        goto fail;
+    }
+    so->fmt_in->flags |= AVFMT_FLAG_GENPTS;
+    if (so->fmt_in->iformat->read_seek)
+        av_seek_frame(so->fmt_in, -1, stream_pos, 0);
+
+    if ((ret = open_output_context(&so->fmt_ctx, stream)) < 0)
+        goto fail;
+    len = avio_close_dyn_buf(so->fmt_ctx.pb, &buf);
+    so->header = av_buffer_create(buf, len, av_buffer_default_free, NULL, 0);
+    if (!so->header) {
+        av_free(buf);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* the output is then fed as new data arrives */
+    if ((ret = read_shared_output(stream, SHARED_OUTPUT_SEGMENTS)) < 0)
+        goto fail;
+    return 0;
+fail:
+    close_shared_output(stream);
+    return ret;
+}
+
+/* mux the new data of the feed into its shared outputs, or mark them as
+   lost when the feeder is gone, and wake up the workers sending them */
+static void update_shared_outputs(FFStream *feed, int lost)
+{
+    FFStream *stream;
+
+    for (stream = first_stream; stream; stream = stream->next) {
+        SharedOutput *so = stream->shared;
+        int ret;
+
+        if (!so || stream->feed != feed)
+            continue;
+        ret = lost ? -1 : read_shared_output(stream, SHARED_OUTPUT_SEGMENTS);
+        lock_shared_output(so);
+        so->feed_lost = ret < 0;
+        unlock_shared_output(so);
+    }
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+    wake_workers();
+#endif
+}
+
+/* start sending the shared output from the last key frame available */
+static void seek_shared_output(HTTPContext *c)
+{
+    SharedOutput *so = c->shared;
+
+    if (so->last_key_seq >= so->first_seq) {
+        c->shared_seq      = so->last_key_seq;
+        c->shared_need_key = 0;
+    } else {
+        c->shared_seq      = so->next_seq;
+        c->shared_need_key = c->stream->send_on_key;
+    }
+}
+
+static int join_shared_output(HTTPContext *c)
+{
+    int ret;
+
+    if (!c->stream->shared && (ret = open_shared_output(c->stream)) < 0)
+        return ret;
+    c->shared = c->stream->shared;
+    c->shared->nb_clients++;
+    c->start_time = cur_time;
+    return 0;
+}
+
+static void leave_shared_output(HTTPContext *c)
+{
+    av_buffer_unref(&c->shared_buf);
+    if (!--c->shared->nb_clients)
+        close_shared_output(c->stream);
+    c->shared = NULL;
+}
+
+/* the worker threads leave the statistics of the stream to the main one */
+static int served_by_worker(HTTPContext *c)
+{
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+    return !!c->worker;
+#else
+    return 0;
+#endif
+}
+
+static int64_t connection_time(HTTPContext *c)
+{
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+    if (c->worker)
+        return c->worker->cur_time;
+#endif
+    return cur_time;
+}
+
+/* send the shared output to a TCP connection, directly from the
+   refcounted segments. The references taken on them keep them valid
+   while sending, even if the main thread drops them from the ring. */
+static int http_send_shared_data(HTTPContext *c)
+{
+    SharedOutput *so = c->shared;
+    AVBufferRef *segments[SHARED_OUTPUT_IOV + 1];
+    struct iovec iov[SHARED_OUTPUT_IOV + 1];
+    int nb_iov = 0, nb_segments = 0, i, ret = 0;
+    int64_t seq;
+    ssize_t len;
+
+    switch (c->state) {
+    case HTTPSTATE_SEND_DATA_HEADER:
+        if (!(c->shared_buf = av_buffer_ref(so->header)))
+            return -1;
+        c->buffer_ptr = c->shared_buf->data;
+        c->buffer_end = c->shared_buf->data + c->shared_buf->size;
+        break;
+    case HTTPSTATE_SEND_DATA:
+        break;
+    default:
+        return -1;
+    }
+
+    if (c->stream->max_time &&
+        c->stream->max_time + c->start_time - connection_time(c) < 0)
+        return -1;
+
+    lock_shared_output(so);
+    if (c->state == HTTPSTATE_SEND_DATA_HEADER) {
+        seek_shared_output(c);
+        c->state = HTTPSTATE_SEND_DATA;
+    }
+    if (c->shared_seq < so->first_seq) {
+        /* the client is too slow and missed some data, skip ahead */
+        seek_shared_output(c);
+    }
+    if (c->buffer_ptr >= c->buffer_end && c->shared_seq >= so->next_seq) {
+        /* wait for more data from the feed, if it is still there */
+        if (so->feed_lost)
+            ret = -1;
+        else
+            c->state = HTTPSTATE_WAIT_FEED;
+        unlock_shared_output(so);
+        return ret;
+    }
+    while (c->shared_need_key && c->shared_seq < so->next_seq &&
+           !so->key[c->shared_seq % SHARED_OUTPUT_SEGMENTS])
+        c->shared_seq++;
+    if (c->shared_seq < so->next_seq)
+        c->shared_need_key = 0;
+
+    if (c->buffer_ptr < c->buffer_end) {
+        iov[nb_iov].iov_base = c->buffer_ptr;
+        iov[nb_iov].iov_len  = c->buffer_end - c->buffer_ptr;
+        nb_iov++;
+    }
+    if (!c->shared_need_key) {
+        for (seq = c->shared_seq; seq < so->next_seq && nb_iov <= SHARED_OUTPUT_IOV; seq++) {
+            AVBufferRef *segment = so->segments[seq % SHARED_OUTPUT_SEGMENTS];
+            if (!(segments[nb_segments] = av_buffer_ref(segment)))
+                break;
+            iov[nb_iov].iov_base = segment->data;
+            iov[nb_iov].iov_len  = segment->size;
+            nb_iov++;
+            nb_segments++;
+        }
+    }
+    unlock_shared_output(so);
+    if (!nb_iov)
+        return 0;
+
+    len = writev(c->fd, iov, nb_iov);
+    if (len < 0) {
+        if (ff_neterrno() != AVERROR(EAGAIN) &&
+            ff_neterrno() != AVERROR(EINTR))
+            /* error : close connection */
+            ret = -1;
+        goto end;
+    }
+    c->data_count += len;
+    if (!served_by_worker(c)) {
+        update_datarate(&c->datarate, c->data_count);
+        c->stream->bytes_served += len;
+    }
+
+    /* advance in the data sent */
+    if (c->buffer_ptr < c->buffer_end) {
+        int size = FFMIN(len, c->buffer_end - c->buffer_ptr);
+        c->buffer_ptr += size;
+        len           -= size;
+    }
+    for (i = 0; len > 0; i++) {
+        AVBufferRef *segment = segments[i];
+
+        c->shared_seq++;
+        if (len < segment->size) {
+            /* keep the reference to the partially sent segment, it may
+               be dropped from the ring before the client catches up */
+            av_buffer_unref(&c->shared_buf);
+            c->shared_buf  = segment;
+            segments[i]    = NULL;
+            c->buffer_ptr  = segment->data + len;
+            c->buffer_end  = segment->data + segment->size;
+            break;
+        }
+        len -= segment->size;
+    }
+end:
+    for (i = 0; i < nb_segments; i++)
+        av_buffer_unref(&segments[i]);
+    return ret;
+}
+
 /* should convert the format at the same time */
 /* send data starting at c->buffer_ptr to the output connection
    (either UDP or TCP connection) */
@@ -2461,6 +3552,9 @@ static int http_send_data(HTTPContext *c)
 {
     int len, ret;
 
+    if (c->shared)
+        return http_send_shared_data(c);
+
     for(;;) {
         if (c->buffer_ptr >= c->buffer_end) {
             ret = http_prepare_data(c);
@@ -2540,6 +3634,7 @@ static int http_send_data(HTTPContext *c)
                            send it later, so a new state is needed to
                            "lock" the RTSP TCP connection */
                         rtsp_c->state = RTSPSTATE_SEND_PACKET;
+                        connection_changed(rtsp_c);
                         break;
                     } else
                         /* all data has been sent */
@@ -2711,10 +3806,13 @@ static int http_receive_data(HTTPContext *c)
             }
 
             /* wake up any waiting connections */
+            update_shared_outputs(c->stream->feed, 0);
             for(c1 = first_http_ctx; c1 != NULL; c1 = c1->next) {
                 if (c1->state == HTTPSTATE_WAIT_FEED &&
-                    c1->stream->feed == c->stream->feed)
+                    c1->stream->feed == c->stream->feed) {
                     c1->state = HTTPSTATE_SEND_DATA;
+                    connection_changed(c1);
+                }
             }
         } else {
             /* We have a header in our hands that contains useful data */
@@ -2767,10 +3865,13 @@ static int http_receive_data(HTTPContext *c)
     c->stream->feed_opened = 0;
     close(c->feed_fd);
     /* wake up any waiting connections to stop waiting for feed */
+    update_shared_outputs(c->stream->feed, 1);
     for(c1 = first_http_ctx; c1 != NULL; c1 = c1->next) {
         if (c1->state == HTTPSTATE_WAIT_FEED &&
-            c1->stream->feed == c->stream->feed)
+            c1->stream->feed == c->stream->feed) {
             c1->state = HTTPSTATE_SEND_DATA_TRAILER;
+            connection_changed(c1);
+        }
     }
     return -1;
 }
@@ -3252,6 +4353,7 @@ static void rtsp_cmd_play(HTTPContext *c, const char *url, RTSPMessageHeader *h)
     }
 
     rtp_c->state = HTTPSTATE_SEND_DATA;
+    connection_changed(rtp_c);
 
     /* now everything is OK, so we can send the connection parameters */
     rtsp_reply_header(c, RTSP_STATUS_OK);
@@ -3278,6 +4380,7 @@ static void rtsp_cmd_pause(HTTPContext *c, const char *url, RTSPMessageHeader *h
 
     rtp_c->state = HTTPSTATE_READY;
     rtp_c->first_pts = AV_NOPTS_VALUE;
+    connection_changed(rtp_c);
     /* now everything is OK, so we can send the connection parameters */
     rtsp_reply_header(c, RTSP_STATUS_OK);
     /* session ID */
@@ -3362,6 +4465,10 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
 
     c->next = first_http_ctx;
     first_http_ctx = c;
+#if HAVE_EPOLL_CREATE1
+    c->loop = http_loop;
+#endif
+    connection_changed(c);
     return c;
 
  fail:
@@ -4106,6 +5213,13 @@ static int parse_ffconfig(const char *filename)
             } else {
                 nb_max_connections = val;
             }
+        } else if (!av_strcasecmp(cmd, "Workers")) {
+            get_arg(arg, sizeof(arg), &p);
+            val = atoi(arg);
+            if (val < 0 || val > 1024) {
+                ERROR("Invalid Workers: %s\n", arg);
+            } else
+                nb_workers = val;
         } else if (!av_strcasecmp(cmd, "MaxBandwidth")) {
             int64_t llval;
             get_arg(arg, sizeof(arg), &p);
@@ -4322,6 +5436,9 @@ static int parse_ffconfig(const char *filename)
         } else if (!av_strcasecmp(cmd, "StartSendOnKey")) {
             if (stream)
                 stream->send_on_key = 1;
+        } else if (!av_strcasecmp(cmd, "ShareOutput")) {
+            if (stream)
+                stream->share_output = 1;
         } else if (!av_strcasecmp(cmd, "AudioCodec")) {
             get_arg(arg, sizeof(arg), &p);
             audio_id = opt_audio_codec(arg);
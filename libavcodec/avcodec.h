@@ -683,6 +683,9 @@ typedef struct RcOverride{
  * Encoders:
  * The encoder needs to be fed with NULL data at the end of encoding until the
  * encoder no longer returns data.
+ * Encoders without this flag also need to be flushed this way when
+ * AVCodecContext.delay is nonzero after opening, which is the case with frame
+ * threading.
  *
  * NOTE: For encoders implementing the AVCodec.encode2() function, setting this
  *       flag also means that the encoder must set the pts and duration for
@@ -1131,6 +1134,8 @@ typedef struct AVCodecContext {
      * Video:
      *   Number of frames the decoded output will be delayed relative to the
      *   encoded input.
+     *   For encoding, this is also set to the number of frames the encoder
+     *   output is delayed by frame threading.
      *
      * Audio:
      *   For encoding, this is the number of "priming" samples added to the
@@ -24,6 +24,7 @@
 #include "bmp.h"
 #include "internal.h"
 #include "msrledec.h"
+#include "thread.h"
 
 static int bmp_decode_frame(AVCodecContext *avctx,
                             void *data, int *got_frame,
@@ -32,6 +33,7 @@ static int bmp_decode_frame(AVCodecContext *avctx,
     const uint8_t *buf = avpkt->data;
     int buf_size       = avpkt->size;
     AVFrame *p         = data;
+    ThreadFrame frame  = { .f = data };
     unsigned int fsize, hsize;
     int width, height;
     unsigned int depth;
@@ -193,7 +195,7 @@ static int bmp_decode_frame(AVCodecContext *avctx,
         return AVERROR_INVALIDDATA;
     }
 
-    if ((ret = ff_get_buffer(avctx, p, 0)) < 0) {
+    if ((ret = ff_thread_get_buffer(avctx, &frame, 0)) < 0) {
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return ret;
     }
@@ -344,6 +346,6 @@ AVCodec ff_bmp_decoder = {
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_BMP,
     .decode         = bmp_decode_frame,
-    .capabilities   = CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
     .long_name      = NULL_IF_CONFIG_SMALL("BMP (Windows and OS/2 bitmap)"),
 };
@@ -24,6 +24,7 @@
 #include "bytestream.h"
 #include "avcodec.h"
 #include "internal.h"
+#include "thread.h"
 
 static unsigned int read32(const uint8_t **ptr, int is_big)
 {
@@ -54,6 +55,7 @@ static int decode_frame(AVCodecContext *avctx,
     const uint8_t *buf_end = avpkt->data + avpkt->size;
     int buf_size       = avpkt->size;
     AVFrame *const p = data;
+    ThreadFrame frame = { .f = data };
     uint8_t *ptr;
 
     unsigned int offset;
@@ -151,7 +153,7 @@ static int decode_frame(AVCodecContext *avctx,
         return ret;
     if (w != avctx->width || h != avctx->height)
         avcodec_set_dimensions(avctx, w, h);
-    if ((ret = ff_get_buffer(avctx, p, 0)) < 0) {
+    if ((ret = ff_thread_get_buffer(avctx, &frame, 0)) < 0) {
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return ret;
     }
@@ -214,5 +216,5 @@ AVCodec ff_dpx_decoder = {
     .id             = AV_CODEC_ID_DPX,
     .decode         = decode_frame,
     .long_name      = NULL_IF_CONFIG_SMALL("DPX image"),
-    .capabilities   = CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
 };
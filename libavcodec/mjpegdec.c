@@ -40,6 +40,7 @@
 #include "mjpeg.h"
 #include "mjpegdec.h"
 #include "jpeglsdec.h"
+#include "thread.h"
 
 
 static int build_vlc(VLC *vlc, const uint8_t *bits_table,
@@ -65,20 +66,54 @@ static int build_vlc(VLC *vlc, const uint8_t *bits_table,
                               huff_code, 2, 2, huff_sym, 2, 2, use_static);
 }
 
+/* (re)build the VLCs of one table from its raw definition */
+static int build_huffman_vlcs(MJpegDecodeContext *s, int class, int index)
+{
+    const uint8_t *bits_table = s->raw_huffman_lengths[class][index];
+    const uint8_t *val_table  = s->raw_huffman_values[class][index];
+    int i, n = 0, code_max = 0, ret;
+
+    for (i = 1; i <= 16; i++)
+        n += bits_table[i];
+    for (i = 0; i < n; i++)
+        code_max = FFMAX(code_max, val_table[i]);
+
+    ff_free_vlc(&s->vlcs[class][index]);
+    av_log(s->avctx, AV_LOG_DEBUG, "class=%d index=%d nb_codes=%d\n",
+           class, index, code_max + 1);
+    if ((ret = build_vlc(&s->vlcs[class][index], bits_table, val_table,
+                         code_max + 1, 0, class > 0)) < 0)
+        return ret;
+
+    if (class > 0) {
+        ff_free_vlc(&s->vlcs[2][index]);
+        if ((ret = build_vlc(&s->vlcs[2][index], bits_table, val_table,
+                             code_max + 1, 0, 0)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static void build_basic_mjpeg_vlc(MJpegDecodeContext *s)
 {
-    build_vlc(&s->vlcs[0][0], avpriv_mjpeg_bits_dc_luminance,
-              avpriv_mjpeg_val_dc, 12, 0, 0);
-    build_vlc(&s->vlcs[0][1], avpriv_mjpeg_bits_dc_chrominance,
-              avpriv_mjpeg_val_dc, 12, 0, 0);
-    build_vlc(&s->vlcs[1][0], avpriv_mjpeg_bits_ac_luminance,
-              avpriv_mjpeg_val_ac_luminance, 251, 0, 1);
-    build_vlc(&s->vlcs[1][1], avpriv_mjpeg_bits_ac_chrominance,
-              avpriv_mjpeg_val_ac_chrominance, 251, 0, 1);
-    build_vlc(&s->vlcs[2][0], avpriv_mjpeg_bits_ac_luminance,
-              avpriv_mjpeg_val_ac_luminance, 251, 0, 0);
-    build_vlc(&s->vlcs[2][1], avpriv_mjpeg_bits_ac_chrominance,
-              avpriv_mjpeg_val_ac_chrominance, 251, 0, 0);
+    static const struct {
+        int class, index;
+        const uint8_t *bits, *values;
+    } ht[] = {
+        { 0, 0, avpriv_mjpeg_bits_dc_luminance,   avpriv_mjpeg_val_dc },
+        { 0, 1, avpriv_mjpeg_bits_dc_chrominance, avpriv_mjpeg_val_dc },
+        { 1, 0, avpriv_mjpeg_bits_ac_luminance,   avpriv_mjpeg_val_ac_luminance },
+        { 1, 1, avpriv_mjpeg_bits_ac_chrominance, avpriv_mjpeg_val_ac_chrominance },
+    };
+    int i, j, n;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(ht); i++) {
+        for (j = 1, n = 0; j <= 16; j++)
+            n += ht[i].bits[j];
+        memcpy(s->raw_huffman_lengths[ht[i].class][ht[i].index], ht[i].bits, 17);
+        memcpy(s->raw_huffman_values[ht[i].class][ht[i].index], ht[i].values, n);
+        build_huffman_vlcs(s, ht[i].class, ht[i].index);
+    }
 }
 
 av_cold int ff_mjpeg_decode_init(AVCodecContext *avctx)
@@ -158,7 +193,7 @@ int ff_mjpeg_decode_dqt(MJpegDecodeContext *s)
 /* decode huffman tables and build VLC decoders */
 int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
 {
-    int len, index, i, class, n, v, code_max;
+    int len, index, i, class, n;
     uint8_t bits_table[17];
     uint8_t val_table[256];
     int ret = 0;
@@ -183,35 +218,22 @@ int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
         if (len < n || n > 256)
             return AVERROR_INVALIDDATA;
 
-        code_max = 0;
-        for (i = 0; i < n; i++) {
-            v = get_bits(&s->gb, 8);
-            if (v > code_max)
-                code_max = v;
-            val_table[i] = v;
-        }
+        for (i = 0; i < n; i++)
+            val_table[i] = get_bits(&s->gb, 8);
         len -= n;
 
         /* build VLC and flush previous vlc if present */
-        ff_free_vlc(&s->vlcs[class][index]);
-        av_log(s->avctx, AV_LOG_DEBUG, "class=%d index=%d nb_codes=%d\n",
-               class, index, code_max + 1);
-        if ((ret = build_vlc(&s->vlcs[class][index], bits_table, val_table,
-                             code_max + 1, 0, class > 0)) < 0)
+        memcpy(s->raw_huffman_lengths[class][index], bits_table, 17);
+        memcpy(s->raw_huffman_values[class][index], val_table, n);
+        if ((ret = build_huffman_vlcs(s, class, index)) < 0)
             return ret;
-
-        if (class > 0) {
-            ff_free_vlc(&s->vlcs[2][index]);
-            if ((ret = build_vlc(&s->vlcs[2][index], bits_table, val_table,
-                                 code_max + 1, 0, 0)) < 0)
-                return ret;
-        }
     }
     return 0;
 }
 
 int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
 {
+    ThreadFrame tframe = { 0 };
     int len, nb_components, i, width, height, pix_fmt_id;
 
     /* XXX: verify len field validity */
@@ -348,8 +370,12 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
             s->avctx->pix_fmt = AV_PIX_FMT_GRAY16;
     }
 
+    /* hand the previous picture back to the main thread if needed, then
+     * reset the properties of the (possibly never used) frame */
+    tframe.f = s->picture_ptr;
+    ff_thread_release_buffer(s->avctx, &tframe);
     av_frame_unref(s->picture_ptr);
-    if (ff_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0) {
+    if (ff_thread_get_buffer(s->avctx, &tframe, AV_GET_BUFFER_FLAG_REF) < 0) {
         av_log(s->avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return -1;
     }
@@ -1437,6 +1463,25 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
     return start_code;
 }
 
+/**
+ * Find the last marker in buf that may change state carried over to the next
+ * image, i.e. any marker but SOS, RSTn and EOI. Once it has been parsed, the
+ * next image can be set up by another frame thread.
+ */
+static const uint8_t *find_last_header_marker(const uint8_t *buf,
+                                              const uint8_t *buf_end)
+{
+    const uint8_t *last = buf;
+
+    while ((buf = memchr(buf, 0xff, buf_end - buf)) && ++buf < buf_end) {
+        int marker = *buf;
+        if (marker >= 0xc0 && marker < 0xff && marker != SOS &&
+            marker != EOI && (marker < RST0 || marker > RST7))
+            last = buf;
+    }
+    return last;
+}
+
 int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
                           AVPacket *avpkt)
 {
@@ -1445,6 +1490,7 @@ int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     MJpegDecodeContext *s = avctx->priv_data;
     const uint8_t *buf_end, *buf_ptr;
     const uint8_t *unescaped_buf_ptr;
+    const uint8_t *setup_end = NULL;
     int unescaped_buf_size;
     int start_code;
     int ret = 0;
@@ -1452,6 +1498,8 @@ int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     s->got_picture = 0; // picture from previous image can not be reused
     buf_ptr = buf;
     buf_end = buf + buf_size;
+    if (avctx->active_thread_type & FF_THREAD_FRAME)
+        setup_end = find_last_header_marker(buf, buf_end);
     while (buf_ptr < buf_end) {
         /* find start next marker */
         start_code = ff_mjpeg_find_marker(s, &buf_ptr, buf_end,
@@ -1569,6 +1617,13 @@ eoi_parser:
                            "Can not process SOS before SOF, skipping\n");
                     break;
                     }
+                /* Let the next frame thread start once all headers of a
+                 * frame picture have been parsed. The field state of
+                 * interlaced pictures still changes at EOI. */
+                if (setup_end && buf_ptr > setup_end && !s->interlaced) {
+                    ff_thread_finish_setup(avctx);
+                    setup_end = NULL;
+                }
                 if ((ret = ff_mjpeg_decode_sos(s, NULL, NULL)) < 0 &&
                     (avctx->err_recognition & AV_EF_EXPLODE))
                     return ret;
@@ -1616,6 +1671,90 @@ the_end:
     return buf_ptr - buf;
 }
 
+static av_cold int mjpeg_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    int class, index, ret;
+
+    s->avctx       = avctx;
+    s->picture_ptr = &s->picture;
+    memset(&s->picture, 0, sizeof(s->picture));
+    s->buffer            = NULL;
+    s->buffer_size       = 0;
+    s->ljpeg_buffer      = NULL;
+    s->ljpeg_buffer_size = 0;
+    memset(s->blocks,   0, sizeof(s->blocks));
+    memset(s->last_nnz, 0, sizeof(s->last_nnz));
+
+    /* the VLC tables are still shared with the context this one was
+     * copied from, rebuild them from the raw definitions */
+    for (class = 0; class < 2; class++) {
+        for (index = 0; index < 4; index++) {
+            int defined = !!s->vlcs[class][index].table;
+
+            memset(&s->vlcs[class][index], 0, sizeof(s->vlcs[class][index]));
+            if (class)
+                memset(&s->vlcs[2][index], 0, sizeof(s->vlcs[2][index]));
+            if (defined && (ret = build_huffman_vlcs(s, class, index)) < 0)
+                return ret;
+        }
+    }
+
+    return 0;
+}
+
+static int mjpeg_update_thread_context(AVCodecContext *dst,
+                                       const AVCodecContext *src)
+{
+    MJpegDecodeContext *s = dst->priv_data, *s1 = src->priv_data;
+    int class, index, ret;
+
+    if (dst == src)
+        return 0;
+
+    memcpy(s->quant_matrixes, s1->quant_matrixes, sizeof(s->quant_matrixes));
+    memcpy(s->qscale,         s1->qscale,         sizeof(s->qscale));
+
+    for (class = 0; class < 2; class++) {
+        for (index = 0; index < 4; index++) {
+            if (!s1->vlcs[class][index].table ||
+                (!memcmp(s->raw_huffman_lengths[class][index],
+                         s1->raw_huffman_lengths[class][index], 17) &&
+                 !memcmp(s->raw_huffman_values[class][index],
+                         s1->raw_huffman_values[class][index], 256)))
+                continue;
+            memcpy(s->raw_huffman_lengths[class][index],
+                   s1->raw_huffman_lengths[class][index], 17);
+            memcpy(s->raw_huffman_values[class][index],
+                   s1->raw_huffman_values[class][index], 256);
+            if ((ret = build_huffman_vlcs(s, class, index)) < 0)
+                return ret;
+        }
+    }
+
+    s->width              = s1->width;
+    s->height             = s1->height;
+    s->first_picture      = s1->first_picture;
+    s->interlaced         = s1->interlaced;
+    s->bottom_field       = s1->bottom_field;
+    s->interlace_polarity = s1->interlace_polarity;
+    s->rgb                = s1->rgb;
+    s->rct                = s1->rct;
+    s->pegasus_rct        = s1->pegasus_rct;
+    s->buggy_avid         = s1->buggy_avid;
+    s->cs_itu601          = s1->cs_itu601;
+
+    /* JPEG-LS parameters */
+    s->maxval             = s1->maxval;
+    s->near               = s1->near;
+    s->t1                 = s1->t1;
+    s->t2                 = s1->t2;
+    s->t3                 = s1->t3;
+    s->reset              = s1->reset;
+
+    return 0;
+}
+
 av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
 {
     MJpegDecodeContext *s = avctx->priv_data;
@@ -1662,9 +1801,11 @@ AVCodec ff_mjpeg_decoder = {
     .init           = ff_mjpeg_decode_init,
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
-    .capabilities   = CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
     .long_name      = NULL_IF_CONFIG_SMALL("MJPEG (Motion JPEG)"),
     .priv_class     = &mjpegdec_class,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(mjpeg_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(mjpeg_update_thread_context),
 };
 
 AVCodec ff_thp_decoder = {
@@ -49,6 +49,8 @@ typedef struct MJpegDecodeContext {
 
     int16_t quant_matrixes[4][64];
     VLC vlcs[3][4];
+    uint8_t raw_huffman_lengths[2][4][17]; ///< code counts per length of the DC/AC tables, [0] unused
+    uint8_t raw_huffman_values[2][4][256]; ///< symbols of the DC/AC tables
     int qscale[4];      ///< quantizer scale calculated from quant_matrixes
 
     int org_height;  /* size given at codec init */
@@ -517,6 +517,8 @@ int ff_mpeg_ref_picture(MpegEncContext *s, Picture *dst, Picture *src)
     dst->mb_var_sum              = src->mb_var_sum;
     dst->mc_mb_var_sum           = src->mc_mb_var_sum;
     dst->b_frame_score           = src->b_frame_score;
+    dst->lookahead_intra_cplx    = src->lookahead_intra_cplx;
+    dst->lookahead_inter_cplx    = src->lookahead_inter_cplx;
     dst->needs_realloc           = src->needs_realloc;
     dst->reference               = src->reference;
     dst->shared                  = src->shared;
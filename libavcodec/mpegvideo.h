@@ -168,6 +168,8 @@ typedef struct Picture{
     int mc_mb_var_sum;          ///< motion compensated MB variance for current frame
 
     int b_frame_score;          /* */
+    int lookahead_intra_cplx;   ///< intra SATD of the half resolution luma, for the rate control lookahead
+    int lookahead_inter_cplx;   ///< same, motion compensated from the previous input picture, capped by the intra SATD per block
     int needs_realloc;          ///< Picture needs to be reallocated (eg due to a frame size change)
 
     int reference;
@@ -305,6 +307,19 @@ typedef struct MpegEncContext {
      * a delay */
     int64_t reordered_pts;
 
+    /**
+     * downscaled input pictures for b_frame_strategy 2, kept across
+     * estimate_best_b_count() calls so that each input is shrunk only once
+     */
+    uint8_t *brd_data[FF_MAX_B_FRAMES + 2];
+    int brd_picture_number[FF_MAX_B_FRAMES + 2]; ///< display_picture_number of each brd_data picture, -1 if not reusable
+
+    /**
+     * half resolution luma of the newest and the previous input picture, for
+     * the complexity estimates of the rate control lookahead
+     */
+    uint8_t *lookahead_lowres[2];
+
     /** bit output */
     PutBitContext pb;
 
@@ -715,6 +730,8 @@ typedef struct MpegEncContext {
 
     int mpv_flags;      ///< flags set by private options
     int quantizer_noise_shaping;
+    int rc_lookahead;   ///< number of input pictures the rate control looks ahead
+    int last_reordered_number; ///< highest display_picture_number moved to reordered_input_picture[]
 
     /* temp buffers for rate control */
     float *cplx_tab, *bits_tab;
@@ -749,7 +766,9 @@ typedef struct MpegEncContext {
                                                                       FF_MPV_OFFSET(luma_elim_threshold), AV_OPT_TYPE_INT, { .i64 = 0 }, INT_MIN, INT_MAX, FF_MPV_OPT_FLAGS },\
 { "chroma_elim_threshold", "single coefficient elimination threshold for chrominance (negative values also consider dc coefficient)",\
                                                                       FF_MPV_OFFSET(chroma_elim_threshold), AV_OPT_TYPE_INT, { .i64 = 0 }, INT_MIN, INT_MAX, FF_MPV_OPT_FLAGS },\
-{ "quantizer_noise_shaping", NULL,                                  FF_MPV_OFFSET(quantizer_noise_shaping), AV_OPT_TYPE_INT, { .i64 = 0 },       0, INT_MAX, FF_MPV_OPT_FLAGS },
+{ "quantizer_noise_shaping", NULL,                                  FF_MPV_OFFSET(quantizer_noise_shaping), AV_OPT_TYPE_INT, { .i64 = 0 },       0, INT_MAX, FF_MPV_OPT_FLAGS },\
+{ "rc_lookahead",   "Number of frames the rate control looks ahead to protect the VBV buffer", \
+                                                                      FF_MPV_OFFSET(rc_lookahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, FF_MAX_B_FRAMES, FF_MPV_OPT_FLAGS },
 
 extern const AVOption ff_mpv_generic_options[];
 
@@ -424,6 +424,24 @@ av_cold int ff_MPV_encode_init(AVCodecContext *avctx)
         return -1;
     }
 
+    if (s->rc_lookahead) {
+        if (!(avctx->codec->capabilities & CODEC_CAP_DELAY)) {
+            av_log(avctx, AV_LOG_ERROR,
+                   "rc_lookahead not supported by codec\n");
+            return -1;
+        }
+        if (s->max_b_frames + s->rc_lookahead > FF_MAX_B_FRAMES) {
+            av_log(avctx, AV_LOG_ERROR,
+                   "rc_lookahead plus max_b_frames must not exceed %d\n",
+                   FF_MAX_B_FRAMES);
+            return -1;
+        }
+        if (!avctx->rc_buffer_size || !avctx->rc_max_rate)
+            av_log(avctx, AV_LOG_WARNING,
+                   "rc_lookahead has no effect without a VBV buffer size "
+                   "and maxrate\n");
+    }
+
     if ((s->codec_id == AV_CODEC_ID_MPEG4 ||
          s->codec_id == AV_CODEC_ID_H263  ||
          s->codec_id == AV_CODEC_ID_H263P) &&
@@ -713,6 +731,7 @@ av_cold int ff_MPV_encode_init(AVCodecContext *avctx)
     }
 
     avctx->has_b_frames = !s->low_delay;
+    avctx->delay       += s->rc_lookahead;
 
     s->encoding = 1;
 
@@ -728,6 +747,16 @@ av_cold int ff_MPV_encode_init(AVCodecContext *avctx)
     if (ARCH_X86)
         ff_MPV_encode_init_x86(s);
 
+    if (s->rc_lookahead) {
+        int stride = FFALIGN(s->width >> 1, 16);
+        for (i = 0; i < 2; i++) {
+            s->lookahead_lowres[i] = av_malloc(stride * (s->height >> 1));
+            if (!s->lookahead_lowres[i])
+                return AVERROR(ENOMEM);
+        }
+    }
+    s->last_reordered_number = -1;
+
     if (!s->dct_quantize)
         s->dct_quantize = ff_dct_quantize_c;
     if (!s->denoise_dct)
@@ -795,9 +824,15 @@ av_cold int ff_MPV_encode_init(AVCodecContext *avctx)
 av_cold int ff_MPV_encode_end(AVCodecContext *avctx)
 {
     MpegEncContext *s = avctx->priv_data;
+    int i;
 
     ff_rate_control_uninit(s);
 
+    for (i = 0; i < FF_MAX_B_FRAMES + 2; i++)
+        av_freep(&s->brd_data[i]);
+    av_freep(&s->lookahead_lowres[0]);
+    av_freep(&s->lookahead_lowres[1]);
+
     ff_MPV_common_end(s);
     if ((CONFIG_MJPEG_ENCODER || CONFIG_LJPEG_ENCODER) &&
         s->out_format == FMT_MJPEG)
@@ -846,13 +881,112 @@ static int get_intra_count(MpegEncContext *s, uint8_t *src,
 }
 
 
+/**
+ * Find a motion vector for the 8x8 block at (x, y) of the half resolution
+ * luma with a small diamond search around the better of the zero vector and
+ * the vector passed in *mx, *my.
+ * @return SATD of the motion compensated block
+ */
+static int lookahead_search(MpegEncContext *s, uint8_t *cur, uint8_t *ref,
+                            int stride, int w, int h, int x, int y,
+                            int *mx, int *my)
+{
+    static const int8_t dia[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    uint8_t *src = cur + y * stride + x;
+    int best     = s->dsp.sad[1](s, src, ref + y * stride + x, stride, 8);
+    int bx = 0, by = 0;
+    int i, step;
+
+    if ((*mx || *my) && x + *mx >= 0 && x + *mx <= w - 8 &&
+                        y + *my >= 0 && y + *my <= h - 8) {
+        int d = s->dsp.sad[1](s, src, ref + (y + *my) * stride + x + *mx,
+                              stride, 8);
+        if (d < best) {
+            best = d;
+            bx   = *mx;
+            by   = *my;
+        }
+    }
+
+    for (step = 0; step < 8; step++) {
+        int cx = bx, cy = by;
+
+        for (i = 0; i < 4; i++) {
+            int vx = cx + dia[i][0];
+            int vy = cy + dia[i][1];
+            int d;
+
+            if (x + vx < 0 || x + vx > w - 8 || y + vy < 0 || y + vy > h - 8)
+                continue;
+            d = s->dsp.sad[1](s, src, ref + (y + vy) * stride + x + vx,
+                              stride, 8);
+            if (d < best) {
+                best = d;
+                bx   = vx;
+                by   = vy;
+            }
+        }
+        if (bx == cx && by == cy)
+            break;
+    }
+
+    *mx = bx;
+    *my = by;
+    return s->dsp.hadamard8_diff[1](s, src, ref + (y + by) * stride + x + bx,
+                                    stride, 8);
+}
+
+/**
+ * Estimate how expensive a new input picture is to code, for the rate
+ * control lookahead. The SATD of its half resolution luma is summed over
+ * 8x8 blocks, once intra and once motion compensated from the previous
+ * input picture, taking the cheaper of the two for each block.
+ */
+static void lookahead_analyse(MpegEncContext *s, Picture *pic,
+                              const AVFrame *pic_arg)
+{
+    const int w      = s->width  >> 1;
+    const int h      = s->height >> 1;
+    const int stride = FFALIGN(w, 16);
+    uint8_t *cur     = s->lookahead_lowres[0];
+    uint8_t *prev    = s->lookahead_lowres[1];
+    int intra = 0, inter = 0;
+    int x, y;
+
+    s->dsp.shrink[1](cur, stride, pic_arg->data[0], pic_arg->linesize[0],
+                     w, h);
+
+    for (y = 0; y + 8 <= h; y += 8) {
+        int mx = 0, my = 0;
+
+        for (x = 0; x + 8 <= w; x += 8) {
+            uint8_t *src = cur + y * stride + x;
+            int i_cost   = s->dsp.hadamard8_diff[5](s, src, NULL, stride, 8);
+            int p_cost   = i_cost;
+
+            if (pic->f.display_picture_number)
+                p_cost = FFMIN(p_cost, lookahead_search(s, cur, prev, stride,
+                                                        w, h, x, y, &mx, &my));
+            intra += i_cost;
+            inter += p_cost;
+        }
+    }
+
+    pic->lookahead_intra_cplx = intra;
+    pic->lookahead_inter_cplx = inter;
+    emms_c();
+
+    FFSWAP(uint8_t *, s->lookahead_lowres[0], s->lookahead_lowres[1]);
+}
+
 static int load_input_picture(MpegEncContext *s, const AVFrame *pic_arg)
 {
     Picture *pic = NULL;
     int64_t pts;
     int i, display_picture_number = 0, ret;
-    const int encoding_delay = s->max_b_frames ? s->max_b_frames :
-                                                 (s->low_delay ? 0 : 1);
+    const int encoding_delay = (s->max_b_frames ? s->max_b_frames :
+                                                  (s->low_delay ? 0 : 1)) +
+                               s->rc_lookahead;
     int direct = 1;
 
     if (pic_arg) {
@@ -964,6 +1098,9 @@ static int load_input_picture(MpegEncContext *s, const AVFrame *pic_arg)
         copy_picture_attributes(s, &pic->f, pic_arg);
         pic->f.display_picture_number = display_picture_number;
         pic->f.pts = pts; // we set this here to avoid modifiying pic_arg
+
+        if (s->rc_lookahead)
+            lookahead_analyse(s, pic, pic_arg);
     }
 
     /* shift buffer entries */
@@ -1027,125 +1164,243 @@ static int encode_frame(AVCodecContext *c, AVFrame *frame)
     return ret;
 }
 
-static int estimate_best_b_count(MpegEncContext *s)
+typedef struct BCountEstimate {
+    AVCodecContext *c[FF_MAX_B_FRAMES + 1]; ///< one encoder per candidate
+    uint8_t *data[FF_MAX_B_FRAMES + 2];     ///< downscaled pictures
+    int64_t rd[FF_MAX_B_FRAMES + 1];
+    int max_b_frames;
+    int p_lambda, b_lambda, lambda2;
+} BCountEstimate;
+
+/**
+ * Return the downscaled version of pic, shrinking it only if it is not
+ * already in the cache.
+ * @param reuse  whether pic is an input picture that later calls may ask
+ *               for again; the reconstructed reference is not
+ * @param used   cache entries already taken by this call
+ */
+static uint8_t *get_brd_picture(MpegEncContext *s, AVCodecContext *c,
+                                Picture *pic, int reuse, int *used)
 {
-    AVCodec *codec    = avcodec_find_encoder(s->avctx->codec_id);
-    AVCodecContext *c = avcodec_alloc_context3(NULL);
-    AVFrame input[FF_MAX_B_FRAMES + 2];
     const int scale = s->avctx->brd_scale;
-    int i, j, out_size, p_lambda, b_lambda, lambda2;
-    int64_t best_rd  = INT64_MAX;
-    int best_b_count = -1;
+    int ysize = c->width * c->height;
+    int csize = (c->width / 2) * (c->height / 2);
+    int i, slot = -1;
+    uint8_t *data[3];
+    Picture pre_input;
+
+    if (pic && reuse) {
+        for (i = 0; i < FF_MAX_B_FRAMES + 2; i++) {
+            if (s->brd_data[i] && !used[i] &&
+                s->brd_picture_number[i] == pic->f.display_picture_number) {
+                used[i] = 1;
+                return s->brd_data[i];
+            }
+        }
+    }
 
-    assert(scale >= 0 && scale <= 3);
+    /* take an entry which no picture of this call refers to */
+    for (i = 0; i < FF_MAX_B_FRAMES + 2 && slot < 0; i++)
+        if (!used[i] && !s->brd_data[i])
+            slot = i;
+    for (i = 0; i < FF_MAX_B_FRAMES + 2 && slot < 0; i++)
+        if (!used[i])
+            slot = i;
+    if (slot < 0)
+        return NULL;
+
+    if (!s->brd_data[slot]) {
+        s->brd_data[slot] = av_malloc(ysize + 2 * csize);
+        if (!s->brd_data[slot])
+            return NULL;
+    }
+    used[slot]                  = 1;
+    s->brd_picture_number[slot] = -1;
 
-    //emms_c();
-    //s->next_picture_ptr->quality;
-    p_lambda = s->last_lambda_for[AV_PICTURE_TYPE_P];
-    //p_lambda * FFABS(s->avctx->b_quant_factor) + s->avctx->b_quant_offset;
-    b_lambda = s->last_lambda_for[AV_PICTURE_TYPE_B];
-    if (!b_lambda) // FIXME we should do this somewhere else
-        b_lambda = p_lambda;
-    lambda2  = (b_lambda * b_lambda + (1 << FF_LAMBDA_SHIFT) / 2) >>
-               FF_LAMBDA_SHIFT;
-
-    c->width        = s->width  >> scale;
-    c->height       = s->height >> scale;
-    c->flags        = CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR |
-                      CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
-    c->flags       |= s->avctx->flags & CODEC_FLAG_QPEL;
-    c->mb_decision  = s->avctx->mb_decision;
-    c->me_cmp       = s->avctx->me_cmp;
-    c->mb_cmp       = s->avctx->mb_cmp;
-    c->me_sub_cmp   = s->avctx->me_sub_cmp;
-    c->pix_fmt      = AV_PIX_FMT_YUV420P;
-    c->time_base    = s->avctx->time_base;
-    c->max_b_frames = s->max_b_frames;
-
-    if (avcodec_open2(c, codec, NULL) < 0)
-        return -1;
+    if (!pic)
+        return s->brd_data[slot];
+
+    pre_input = *pic;
+    if (!pre_input.shared && reuse) {
+        pre_input.f.data[0] += INPLACE_OFFSET;
+        pre_input.f.data[1] += INPLACE_OFFSET;
+        pre_input.f.data[2] += INPLACE_OFFSET;
+    }
 
-    for (i = 0; i < s->max_b_frames + 2; i++) {
+    data[0] = s->brd_data[slot];
+    data[1] = data[0] + ysize;
+    data[2] = data[1] + csize;
+    s->dsp.shrink[scale](data[0], c->width,
+                         pre_input.f.data[0], pre_input.f.linesize[0],
+                         c->width,      c->height);
+    s->dsp.shrink[scale](data[1], c->width / 2,
+                         pre_input.f.data[1], pre_input.f.linesize[1],
+                         c->width >> 1, c->height >> 1);
+    s->dsp.shrink[scale](data[2], c->width / 2,
+                         pre_input.f.data[2], pre_input.f.linesize[2],
+                         c->width >> 1, c->height >> 1);
+
+    if (reuse)
+        s->brd_picture_number[slot] = pic->f.display_picture_number;
+
+    return s->brd_data[slot];
+}
+
+/**
+ * Encode the downscaled pictures with j B-frames between P-frames and
+ * compute the rate-distortion cost.
+ */
+static int estimate_b_count_thread(AVCodecContext *avctx, void *arg,
+                                   int j, int threadnr)
+{
+    BCountEstimate *e = arg;
+    AVCodecContext *c = e->c[j];
+    AVFrame input[FF_MAX_B_FRAMES + 2];
+    int i, out_size;
+    int64_t rd = 0;
+
+    for (i = 0; i < e->max_b_frames + 2; i++) {
         int ysize = c->width * c->height;
         int csize = (c->width / 2) * (c->height / 2);
-        Picture pre_input, *pre_input_ptr = i ? s->input_picture[i - 1] :
-                                                s->next_picture_ptr;
 
         avcodec_get_frame_defaults(&input[i]);
-        input[i].data[0]     = av_malloc(ysize + 2 * csize);
+        input[i].data[0]     = e->data[i];
         input[i].data[1]     = input[i].data[0] + ysize;
         input[i].data[2]     = input[i].data[1] + csize;
         input[i].linesize[0] = c->width;
         input[i].linesize[1] =
         input[i].linesize[2] = c->width / 2;
+    }
 
-        if (pre_input_ptr && (!i || s->input_picture[i - 1])) {
-            pre_input = *pre_input_ptr;
+    c->error[0] = c->error[1] = c->error[2] = 0;
 
-            if (!pre_input.shared && i) {
-                pre_input.f.data[0] += INPLACE_OFFSET;
-                pre_input.f.data[1] += INPLACE_OFFSET;
-                pre_input.f.data[2] += INPLACE_OFFSET;
-            }
+    input[0].pict_type = AV_PICTURE_TYPE_I;
+    input[0].quality   = 1 * FF_QP2LAMBDA;
 
-            s->dsp.shrink[scale](input[i].data[0], input[i].linesize[0],
-                                 pre_input.f.data[0], pre_input.f.linesize[0],
-                                 c->width,      c->height);
-            s->dsp.shrink[scale](input[i].data[1], input[i].linesize[1],
-                                 pre_input.f.data[1], pre_input.f.linesize[1],
-                                 c->width >> 1, c->height >> 1);
-            s->dsp.shrink[scale](input[i].data[2], input[i].linesize[2],
-                                 pre_input.f.data[2], pre_input.f.linesize[2],
-                                 c->width >> 1, c->height >> 1);
-        }
-    }
+    out_size = encode_frame(c, &input[0]);
 
-    for (j = 0; j < s->max_b_frames + 1; j++) {
-        int64_t rd = 0;
+    //rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
 
-        if (!s->input_picture[j])
-            break;
+    for (i = 0; i < e->max_b_frames + 1; i++) {
+        int is_p = i % (j + 1) == j || i == e->max_b_frames;
 
-        c->error[0] = c->error[1] = c->error[2] = 0;
+        input[i + 1].pict_type = is_p ?
+                                 AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
+        input[i + 1].quality   = is_p ? e->p_lambda : e->b_lambda;
 
-        input[0].pict_type = AV_PICTURE_TYPE_I;
-        input[0].quality   = 1 * FF_QP2LAMBDA;
+        out_size = encode_frame(c, &input[i + 1]);
 
-        out_size = encode_frame(c, &input[0]);
+        rd += (out_size * e->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
 
-        //rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
+    /* get the delayed frames */
+    while (out_size) {
+        out_size = encode_frame(c, NULL);
+        rd += (out_size * e->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
 
-        for (i = 0; i < s->max_b_frames + 1; i++) {
-            int is_p = i % (j + 1) == j || i == s->max_b_frames;
+    rd += c->error[0] + c->error[1] + c->error[2];
 
-            input[i + 1].pict_type = is_p ?
-                                     AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
-            input[i + 1].quality   = is_p ? p_lambda : b_lambda;
+    e->rd[j] = rd;
+    return 0;
+}
 
-            out_size = encode_frame(c, &input[i + 1]);
+static int estimate_best_b_count(MpegEncContext *s)
+{
+    AVCodec *codec = avcodec_find_encoder(s->avctx->codec_id);
+    BCountEstimate e = { { 0 } };
+    int used[FF_MAX_B_FRAMES + 2] = { 0 };
+    const int scale = s->avctx->brd_scale;
+    int i, j, nb_candidates, nb_contexts;
+    int64_t best_rd  = INT64_MAX;
+    int best_b_count = -1;
 
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
+    assert(scale >= 0 && scale <= 3);
 
-        /* get the delayed frames */
-        while (out_size) {
-            out_size = encode_frame(c, NULL);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
+    //emms_c();
+    //s->next_picture_ptr->quality;
+    e.p_lambda = s->last_lambda_for[AV_PICTURE_TYPE_P];
+    //p_lambda * FFABS(s->avctx->b_quant_factor) + s->avctx->b_quant_offset;
+    e.b_lambda = s->last_lambda_for[AV_PICTURE_TYPE_B];
+    if (!e.b_lambda) // FIXME we should do this somewhere else
+        e.b_lambda = e.p_lambda;
+    e.lambda2  = (e.b_lambda * e.b_lambda + (1 << FF_LAMBDA_SHIFT) / 2) >>
+                 FF_LAMBDA_SHIFT;
+    e.max_b_frames = s->max_b_frames;
+
+    for (nb_candidates = 0; nb_candidates < s->max_b_frames + 1; nb_candidates++)
+        if (!s->input_picture[nb_candidates])
+            break;
+    if (!nb_candidates)
+        return -1;
 
-        rd += c->error[0] + c->error[1] + c->error[2];
+    /* Without slice threads the candidates are encoded one after another
+     * with a single encoder, whose rate control and motion estimation
+     * state carries over from one candidate to the next. With slice
+     * threads each candidate gets a fresh encoder, so they are all
+     * measured from the same state. The decisions, and therefore the
+     * bitstream, then differ from the single threaded ones.
+     * The encoders are opened here, avcodec_open2() must not run
+     * concurrently without a lock manager. */
+    nb_contexts = s->avctx->active_thread_type & FF_THREAD_SLICE ?
+                  nb_candidates : 1;
+    for (j = 0; j < nb_contexts; j++) {
+        AVCodecContext *c = avcodec_alloc_context3(NULL);
+        if (!c)
+            goto end;
+        e.c[j] = c;
+
+        c->width        = s->width  >> scale;
+        c->height       = s->height >> scale;
+        c->flags        = CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR |
+                          CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
+        c->flags       |= s->avctx->flags & CODEC_FLAG_QPEL;
+        c->mb_decision  = s->avctx->mb_decision;
+        c->me_cmp       = s->avctx->me_cmp;
+        c->mb_cmp       = s->avctx->mb_cmp;
+        c->me_sub_cmp   = s->avctx->me_sub_cmp;
+        c->pix_fmt      = AV_PIX_FMT_YUV420P;
+        c->time_base    = s->avctx->time_base;
+        c->max_b_frames = s->max_b_frames;
+
+        if (avcodec_open2(c, codec, NULL) < 0)
+            goto end;
+    }
+    for (; j < nb_candidates; j++)
+        e.c[j] = e.c[0];
+
+    /* the inputs shift by the chosen B-frame count plus one between calls,
+     * so most of them were already shrunk by the previous call */
+    for (i = 1; i < s->max_b_frames + 2; i++) {
+        e.data[i] = get_brd_picture(s, e.c[0], s->input_picture[i - 1], 1,
+                                    used);
+        if (!e.data[i])
+            goto end;
+    }
+    e.data[0] = get_brd_picture(s, e.c[0], s->next_picture_ptr, 0, used);
+    if (!e.data[0])
+        goto end;
+
+    if (nb_contexts > 1)
+        s->avctx->execute2(s->avctx, estimate_b_count_thread, &e, NULL,
+                           nb_candidates);
+    else
+        for (j = 0; j < nb_candidates; j++)
+            estimate_b_count_thread(s->avctx, &e, j, 0);
 
-        if (rd < best_rd) {
-            best_rd = rd;
+    for (j = 0; j < nb_candidates; j++) {
+        if (e.rd[j] < best_rd) {
+            best_rd = e.rd[j];
             best_b_count = j;
         }
     }
 
-    avcodec_close(c);
-    av_freep(&c);
-
-    for (i = 0; i < s->max_b_frames + 2; i++) {
-        av_freep(&input[i].data[0]);
+end:
+    for (j = 0; j < nb_contexts; j++) {
+        if (e.c[j]) {
+            avcodec_close(e.c[j]);
+            av_freep(&e.c[j]);
+        }
     }
 
     return best_b_count;
@@ -1275,6 +1530,9 @@ static int select_input_picture(MpegEncContext *s)
                     s->coded_picture_number++;
             }
         }
+        /* the anchor is always the last picture in display order */
+        s->last_reordered_number =
+            s->reordered_input_picture[0]->f.display_picture_number;
     }
 no_output_pic:
     if (s->reordered_input_picture[0]) {
@@ -1303,6 +1561,10 @@ no_output_pic:
 
             copy_picture_attributes(s, &pic->f,
                                     &s->reordered_input_picture[0]->f);
+            pic->lookahead_intra_cplx =
+                s->reordered_input_picture[0]->lookahead_intra_cplx;
+            pic->lookahead_inter_cplx =
+                s->reordered_input_picture[0]->lookahead_inter_cplx;
 
             /* mark us unused / free shared pic */
             av_frame_unref(&s->reordered_input_picture[0]->f);
@@ -1509,12 +1771,12 @@ vbv_retry:
         avctx->frame_bits  = s->frame_bits;
 
         pkt->pts = s->current_picture.f.pts;
-        if (!s->low_delay) {
+        if (!s->low_delay && s->pict_type != AV_PICTURE_TYPE_B) {
             if (!s->current_picture.f.coded_picture_number)
                 pkt->dts = pkt->pts - s->dts_delta;
             else
                 pkt->dts = s->reordered_pts;
-            s->reordered_pts = s->input_picture[0]->f.pts;
+            s->reordered_pts = pkt->pts;
         } else
             pkt->dts = pkt->pts;
         if (s->current_picture.f.key_frame)
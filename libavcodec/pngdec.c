@@ -24,6 +24,7 @@
 #include "internal.h"
 #include "png.h"
 #include "pngdsp.h"
+#include "thread.h"
 
 /* TODO:
  * - add 2, 4 and 16 bit depth support
@@ -37,7 +38,8 @@ typedef struct PNGDecContext {
     PNGDSPContext dsp;
 
     GetByteContext gb;
-    AVFrame *prev;
+    ThreadFrame previous_picture;
+    ThreadFrame picture;
 
     int state;
     int width, height;
@@ -391,11 +393,15 @@ static int decode_frame(AVCodecContext *avctx,
     PNGDecContext * const s = avctx->priv_data;
     const uint8_t *buf      = avpkt->data;
     int buf_size            = avpkt->size;
-    AVFrame *p              = data;
+    AVFrame *p;
     uint8_t *crow_buf_base  = NULL;
     uint32_t tag, length;
     int ret;
 
+    ff_thread_release_buffer(avctx, &s->previous_picture);
+    FFSWAP(ThreadFrame, s->picture, s->previous_picture);
+    p = s->picture.f;
+
     /* check signature */
     if (buf_size < 8 ||
         memcmp(buf, ff_pngsig, 8) != 0 &&
@@ -487,7 +493,8 @@ static int decode_frame(AVCodecContext *avctx,
                     goto fail;
                 }
 
-                if (ff_get_buffer(avctx, p, AV_GET_BUFFER_FLAG_REF) < 0) {
+                if (ff_thread_get_buffer(avctx, &s->picture,
+                                         AV_GET_BUFFER_FLAG_REF) < 0) {
                     av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
                     goto fail;
                 }
@@ -495,6 +502,8 @@ static int decode_frame(AVCodecContext *avctx,
                 p->key_frame        = 1;
                 p->interlaced_frame = !!s->interlace_type;
 
+                ff_thread_finish_setup(avctx);
+
                 /* compute the compressed row size */
                 if (!s->interlace_type) {
                     s->crow_size = s->row_size + 1;
@@ -588,12 +597,13 @@ static int decode_frame(AVCodecContext *avctx,
     }
  exit_loop:
      /* handle p-frames only if a predecessor frame is available */
-     if (s->prev->data[0]) {
+     if (s->previous_picture.f->data[0]) {
          if (!(avpkt->flags & AV_PKT_FLAG_KEY)) {
             int i, j;
             uint8_t *pd      = p->data[0];
-            uint8_t *pd_last = s->prev->data[0];
+            uint8_t *pd_last = s->previous_picture.f->data[0];
 
+            ff_thread_await_progress(&s->previous_picture, INT_MAX, 0);
             for (j = 0; j < s->height; j++) {
                 for (i = 0; i < s->width * s->bpp; i++) {
                     pd[i] += pd_last[i];
@@ -604,9 +614,10 @@ static int decode_frame(AVCodecContext *avctx,
         }
     }
 
-     av_frame_unref(s->prev);
-     if ((ret = av_frame_ref(s->prev, p)) < 0)
-         goto fail;
+    ff_thread_report_progress(&s->picture, INT_MAX, 0);
+
+    if ((ret = av_frame_ref(data, p)) < 0)
+        goto fail;
 
     *got_frame = 1;
 
@@ -619,17 +630,40 @@ static int decode_frame(AVCodecContext *avctx,
     av_freep(&s->tmp_row);
     return ret;
  fail:
+    ff_thread_report_progress(&s->picture, INT_MAX, 0);
+    ff_thread_release_buffer(avctx, &s->picture);
     ret = -1;
     goto the_end;
 }
 
+static int update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    PNGDecContext *psrc = src->priv_data;
+    PNGDecContext *pdst = dst->priv_data;
+
+    if (dst == src)
+        return 0;
+
+    ff_thread_release_buffer(dst, &pdst->picture);
+    if (psrc->picture.f->data[0])
+        return ff_thread_ref_frame(&pdst->picture, &psrc->picture);
+
+    return 0;
+}
+
 static av_cold int png_dec_init(AVCodecContext *avctx)
 {
     PNGDecContext *s = avctx->priv_data;
 
-    s->prev = av_frame_alloc();
-    if (!s->prev)
+    s->previous_picture.f = av_frame_alloc();
+    s->picture.f          = av_frame_alloc();
+    if (!s->previous_picture.f || !s->picture.f) {
+        av_frame_free(&s->previous_picture.f);
+        av_frame_free(&s->picture.f);
         return AVERROR(ENOMEM);
+    }
+
+    avctx->internal->allocate_progress = 1;
 
     ff_pngdsp_init(&s->dsp);
 
@@ -640,7 +674,10 @@ static av_cold int png_dec_end(AVCodecContext *avctx)
 {
     PNGDecContext *s = avctx->priv_data;
 
-    av_frame_free(&s->prev);
+    ff_thread_release_buffer(avctx, &s->previous_picture);
+    av_frame_free(&s->previous_picture.f);
+    ff_thread_release_buffer(avctx, &s->picture);
+    av_frame_free(&s->picture.f);
 
     return 0;
 }
@@ -653,6 +690,8 @@ AVCodec ff_png_decoder = {
     .init           = png_dec_init,
     .close          = png_dec_end,
     .decode         = decode_frame,
-    .capabilities   = CODEC_CAP_DR1 /*| CODEC_CAP_DRAW_HORIZ_BAND*/,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(png_dec_init),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(update_thread_context),
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS /*| CODEC_CAP_DRAW_HORIZ_BAND*/,
     .long_name      = NULL_IF_CONFIG_SMALL("PNG (Portable Network Graphics) image"),
 };
@@ -31,29 +31,13 @@
 
 #include "config.h"
 
-#if HAVE_SCHED_GETAFFINITY
-#define _GNU_SOURCE
-#include <sched.h>
-#endif
-#if HAVE_GETPROCESSAFFINITYMASK
-#include <windows.h>
-#endif
-#if HAVE_SYSCTL
-#if HAVE_SYS_PARAM_H
-#include <sys/param.h>
-#endif
-#include <sys/types.h>
-#include <sys/sysctl.h>
-#endif
-#if HAVE_SYSCONF
-#include <unistd.h>
-#endif
-
 #include "avcodec.h"
 #include "internal.h"
 #include "thread.h"
 #include "libavutil/avassert.h"
 #include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/opt.h"
 
 #if HAVE_PTHREADS
 #include <pthread.h>
@@ -145,6 +129,11 @@ typedef struct FrameThreadContext {
                                     * While it is set, ff_thread_en/decode_frame won't return any results.
                                     */
 
+    int nb_pending;                /**<
+                                    * Number of frames submitted to encoding threads
+                                    * whose packets have not been returned yet.
+                                    */
+
     int die;                       ///< Set when threads should exit.
 } FrameThreadContext;
 
@@ -153,40 +142,6 @@ typedef struct FrameThreadContext {
  * limit the number of threads to 16 for automatic detection */
 #define MAX_AUTO_THREADS 16
 
-static int get_logical_cpus(AVCodecContext *avctx)
-{
-    int ret, nb_cpus = 1;
-#if HAVE_SCHED_GETAFFINITY && defined(CPU_COUNT)
-    cpu_set_t cpuset;
-
-    CPU_ZERO(&cpuset);
-
-    ret = sched_getaffinity(0, sizeof(cpuset), &cpuset);
-    if (!ret) {
-        nb_cpus = CPU_COUNT(&cpuset);
-    }
-#elif HAVE_GETPROCESSAFFINITYMASK
-    DWORD_PTR proc_aff, sys_aff;
-    ret = GetProcessAffinityMask(GetCurrentProcess(), &proc_aff, &sys_aff);
-    if (ret)
-        nb_cpus = av_popcount64(proc_aff);
-#elif HAVE_SYSCTL && defined(HW_NCPU)
-    int mib[2] = { CTL_HW, HW_NCPU };
-    size_t len = sizeof(nb_cpus);
-
-    ret = sysctl(mib, 2, &nb_cpus, &len, NULL, 0);
-    if (ret == -1)
-        nb_cpus = 0;
-#elif HAVE_SYSCONF && defined(_SC_NPROC_ONLN)
-    nb_cpus = sysconf(_SC_NPROC_ONLN);
-#elif HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
-    nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
-#endif
-    av_log(avctx, AV_LOG_DEBUG, "detected %d logical cores\n", nb_cpus);
-    return nb_cpus;
-}
-
-
 static void* attribute_align_arg worker(void *v)
 {
     AVCodecContext *avctx = v;
@@ -292,7 +247,7 @@ static int thread_init(AVCodecContext *avctx)
     int thread_count = avctx->thread_count;
 
     if (!thread_count) {
-        int nb_cpus = get_logical_cpus(avctx);
+        int nb_cpus = av_cpu_count();
         // use number of cores + 1 as thread count if there is more than one
         if (nb_cpus > 1)
             thread_count = avctx->thread_count = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
@@ -368,13 +323,21 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
             ff_thread_finish_setup(avctx);
 
         pthread_mutex_lock(&p->mutex);
-        avcodec_get_frame_defaults(&p->frame);
         p->got_frame = 0;
-        p->result = codec->decode(avctx, &p->frame, &p->got_frame, &p->avpkt);
+        if (av_codec_is_encoder(codec)) {
+            p->result = codec->encode2(avctx, &p->avpkt, &p->frame, &p->got_frame);
+            if (p->result >= 0 && p->got_frame &&
+                !(codec->capabilities & CODEC_CAP_DELAY))
+                p->avpkt.pts = p->avpkt.dts = p->frame.pts;
+            av_frame_unref(&p->frame);
+        } else {
+            avcodec_get_frame_defaults(&p->frame);
+            p->result = codec->decode(avctx, &p->frame, &p->got_frame, &p->avpkt);
 
-        /* many decoders assign whole AVFrames, thus overwriting extended_data;
-         * make sure it's set correctly */
-        p->frame.extended_data = p->frame.data;
+            /* many decoders assign whole AVFrames, thus overwriting extended_data;
+             * make sure it's set correctly */
+            p->frame.extended_data = p->frame.data;
+        }
 
         if (p->state == STATE_SETTING_UP) ff_thread_finish_setup(avctx);
 
@@ -659,6 +622,99 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     return (p->result >= 0) ? avpkt->size : p->result;
 }
 
+int ff_thread_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
+                           const AVFrame *frame, int *got_packet_ptr)
+{
+    FrameThreadContext *fctx = avctx->thread_opaque;
+    PerThreadContext *p;
+    int err;
+
+    *got_packet_ptr = 0;
+
+    /*
+     * Submit the frame to the next encoding thread. Threads are used in
+     * order, so the next one has already returned its previous packet.
+     */
+
+    if (frame) {
+        p = &fctx->threads[fctx->next_decoding];
+
+        pthread_mutex_lock(&p->mutex);
+        err = av_frame_ref(&p->frame, frame);
+        if (err < 0) {
+            pthread_mutex_unlock(&p->mutex);
+            return err;
+        }
+        p->state = STATE_SETTING_UP;
+        pthread_cond_signal(&p->input_cond);
+        pthread_mutex_unlock(&p->mutex);
+
+        if (++fctx->next_decoding >= avctx->thread_count)
+            fctx->next_decoding = 0;
+
+        /* keep all threads busy before returning the first packet */
+        if (++fctx->nb_pending < avctx->thread_count)
+            return 0;
+    } else if (!fctx->nb_pending) {
+        return 0;
+    }
+
+    /*
+     * Return the packet of the oldest frame.
+     */
+
+    p = &fctx->threads[fctx->next_finished];
+
+    if (p->state != STATE_INPUT_READY) {
+        pthread_mutex_lock(&p->progress_mutex);
+        while (p->state != STATE_INPUT_READY)
+            pthread_cond_wait(&p->output_cond, &p->progress_mutex);
+        pthread_mutex_unlock(&p->progress_mutex);
+    }
+
+    if (++fctx->next_finished >= avctx->thread_count)
+        fctx->next_finished = 0;
+    fctx->nb_pending--;
+
+    err = p->result;
+    if (err >= 0 && p->got_frame) {
+        if (avpkt->data) {
+            /* the caller supplied its own buffer */
+            if (avpkt->size < p->avpkt.size) {
+                av_log(avctx, AV_LOG_ERROR,
+                       "Provided packet is too small, needs to be %d\n",
+                       p->avpkt.size);
+                err = AVERROR(EINVAL);
+            } else {
+                memcpy(avpkt->data, p->avpkt.data, p->avpkt.size);
+                avpkt->size     = p->avpkt.size;
+                avpkt->pts      = p->avpkt.pts;
+                avpkt->dts      = p->avpkt.dts;
+                avpkt->duration = p->avpkt.duration;
+                avpkt->flags    = p->avpkt.flags;
+                *got_packet_ptr = 1;
+            }
+            av_free_packet(&p->avpkt);
+        } else {
+            *avpkt = p->avpkt;
+            *got_packet_ptr = 1;
+        }
+    } else {
+        av_free_packet(&p->avpkt);
+    }
+    av_init_packet(&p->avpkt);
+    p->avpkt.data = NULL;
+    p->avpkt.size = 0;
+
+    if (err >= 0 && p->avctx->coded_frame) {
+        avctx->coded_frame->key_frame = p->avctx->coded_frame->key_frame;
+        avctx->coded_frame->pict_type = p->avctx->coded_frame->pict_type;
+        avctx->coded_frame->quality   = p->avctx->coded_frame->quality;
+    }
+
+    return err;
+}
+
 void ff_thread_report_progress(ThreadFrame *f, int n, int field)
 {
     PerThreadContext *p;
@@ -755,6 +811,14 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
         av_frame_unref(&p->frame);
     }
 
+    if (av_codec_is_encoder(codec)) {
+        /* the user's context was never initialized by the codec itself */
+        if (codec->priv_class)
+            av_opt_free(avctx->priv_data);
+        av_freep(&avctx->extradata);
+        av_frame_free(&avctx->coded_frame);
+    }
+
     for (i = 0; i < thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
 
@@ -767,7 +831,10 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
         av_freep(&p->buf);
         av_freep(&p->released_buffers);
 
-        if (i) {
+        if (av_codec_is_encoder(codec))
+            av_freep(&p->avctx->extradata);
+
+        if (i || av_codec_is_encoder(codec)) {
             av_freep(&p->avctx->priv_data);
             av_freep(&p->avctx->internal);
             av_freep(&p->avctx->slice_offset);
@@ -781,6 +848,61 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
     av_freep(&avctx->thread_opaque);
 }
 
+/**
+ * Initialize the encoder of one encoding thread from the user's settings.
+ *
+ * @param avctx the user's context, which the codec is not initialized on
+ * @param copy  the context of the thread
+ * @param index index of the thread
+ */
+static int frame_encoder_thread_init(AVCodecContext *avctx,
+                                     AVCodecContext *copy, int index)
+{
+    const AVCodec *codec = avctx->codec;
+    int err;
+
+    copy->priv_data      = NULL;
+    copy->internal       = NULL;
+    copy->extradata      = NULL;
+    copy->extradata_size = 0;
+    copy->coded_frame    = NULL;
+    copy->thread_count   = 1;
+
+    if (codec->priv_data_size) {
+        copy->priv_data = av_malloc(codec->priv_data_size);
+        if (!copy->priv_data)
+            return AVERROR(ENOMEM);
+        memcpy(copy->priv_data, avctx->priv_data, codec->priv_data_size);
+    }
+    copy->internal = av_malloc(sizeof(AVCodecInternal));
+    if (!copy->internal)
+        return AVERROR(ENOMEM);
+    *copy->internal = *avctx->internal;
+
+    if (codec->init && (err = codec->init(copy)) < 0)
+        return err;
+
+    /* export the stream parameters the encoder set up during init */
+    if (!index) {
+        if (copy->extradata_size) {
+            avctx->extradata = av_mallocz(copy->extradata_size +
+                                          FF_INPUT_BUFFER_PADDING_SIZE);
+            if (!avctx->extradata)
+                return AVERROR(ENOMEM);
+            memcpy(avctx->extradata, copy->extradata, copy->extradata_size);
+            avctx->extradata_size = copy->extradata_size;
+        }
+        avctx->codec_tag             = copy->codec_tag;
+        avctx->bits_per_coded_sample = copy->bits_per_coded_sample;
+        avctx->has_b_frames          = copy->has_b_frames;
+        avctx->coded_frame           = av_frame_alloc();
+        if (!avctx->coded_frame)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
 static int frame_thread_init(AVCodecContext *avctx)
 {
     int thread_count = avctx->thread_count;
@@ -790,7 +912,7 @@ static int frame_thread_init(AVCodecContext *avctx)
     int i, err = 0;
 
     if (!thread_count) {
-        int nb_cpus = get_logical_cpus(avctx);
+        int nb_cpus = av_cpu_count();
         // use number of cores + 1 as thread count if there is more than one
         if (nb_cpus > 1)
             thread_count = avctx->thread_count = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
@@ -831,7 +953,10 @@ static int frame_thread_init(AVCodecContext *avctx)
         copy->thread_opaque = p;
         copy->pkt = &p->avpkt;
 
-        if (!i) {
+        if (av_codec_is_encoder(codec)) {
+            /* every thread runs a complete single-threaded encoder */
+            err = frame_encoder_thread_init(avctx, copy, i);
+        } else if (!i) {
             src = copy;
 
             if (codec->init)
@@ -839,12 +964,14 @@ static int frame_thread_init(AVCodecContext *avctx)
 
             update_context_from_thread(avctx, copy, 1);
         } else {
-            copy->priv_data = av_malloc(codec->priv_data_size);
-            if (!copy->priv_data) {
-                err = AVERROR(ENOMEM);
-                goto error;
+            if (codec->priv_data_size) {
+                copy->priv_data = av_malloc(codec->priv_data_size);
+                if (!copy->priv_data) {
+                    err = AVERROR(ENOMEM);
+                    goto error;
+                }
+                memcpy(copy->priv_data, src->priv_data, codec->priv_data_size);
             }
-            memcpy(copy->priv_data, src->priv_data, codec->priv_data_size);
             copy->internal = av_malloc(sizeof(AVCodecInternal));
             if (!copy->internal) {
                 err = AVERROR(ENOMEM);
@@ -863,6 +990,10 @@ static int frame_thread_init(AVCodecContext *avctx)
             p->thread_init = 1;
     }
 
+    /* packets come back once all threads are busy */
+    if (av_codec_is_encoder(codec))
+        avctx->delay = thread_count - 1;
+
     return 0;
 
 error:
@@ -888,12 +1019,15 @@ void ff_thread_flush(AVCodecContext *avctx)
 
     fctx->next_decoding = fctx->next_finished = 0;
     fctx->delaying = 1;
+    fctx->nb_pending = 0;
     fctx->prev_thread = NULL;
     for (i = 0; i < avctx->thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
         // Make sure decode flush calls with size=0 won't return old frames
         p->got_frame = 0;
         av_frame_unref(&p->frame);
+        if (av_codec_is_encoder(avctx->codec))
+            av_free_packet(&p->avpkt);
 
         release_delayed_buffers(p);
     }
@@ -1022,6 +1156,13 @@ static void validate_thread_parameters(AVCodecContext *avctx)
                                 && !(avctx->flags & CODEC_FLAG_TRUNCATED)
                                 && !(avctx->flags & CODEC_FLAG_LOW_DELAY)
                                 && !(avctx->flags2 & CODEC_FLAG2_CHUNKS);
+    /* encoding threads cannot share two-pass statistics, an adaptive
+     * context model or the MJPEG rate control across frames */
+    if (av_codec_is_encoder(avctx->codec))
+        frame_threading_supported &= !(avctx->flags & (CODEC_FLAG_PASS1 | CODEC_FLAG_PASS2))
+                                  && avctx->context_model <= 0
+                                  && (avctx->codec_id != AV_CODEC_ID_MJPEG ||
+                                      avctx->flags & CODEC_FLAG_QSCALE);
     if (avctx->thread_count == 1) {
         avctx->active_thread_type = 0;
     } else if (frame_threading_supported && (avctx->thread_type & FF_THREAD_FRAME)) {
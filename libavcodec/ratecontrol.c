@@ -137,6 +137,10 @@ int ff_rate_control_init(MpegEncContext *s)
         rcc->pred[i].count = 1.0;
         rcc->pred[i].decay = 0.4;
 
+        rcc->lookahead_pred[i].coeff = FF_QP2LAMBDA * 2.0;
+        rcc->lookahead_pred[i].count = 1.0;
+        rcc->lookahead_pred[i].decay = 0.4;
+
         rcc->i_cplx_sum [i] =
         rcc->p_cplx_sum [i] =
         rcc->mv_bits_sum[i] =
@@ -307,6 +311,8 @@ int ff_vbv_update(MpegEncContext *s, int frame_size)
     av_dlog(s, "%d %f %d %f %f\n",
             buffer_size, rcc->buffer_index, frame_size, min_rate, max_rate);
 
+    rcc->last_unstuffed_bits = frame_size;
+
     if (buffer_size) {
         int left;
 
@@ -592,6 +598,106 @@ static void update_predictor(Predictor *p, double q, double var, double size)
     p->coeff += new_coeff;
 }
 
+static int lookahead_cplx(Picture *pic, int pict_type)
+{
+    return pict_type == AV_PICTURE_TYPE_I ? pic->lookahead_intra_cplx
+                                          : pic->lookahead_inter_cplx;
+}
+
+/**
+ * Guess the type of a picture the encoder has not decided on yet: I if it
+ * is forced to be or barely resembles the picture before it, else P.
+ */
+static int lookahead_pict_type(Picture *pic)
+{
+    if (pic->f.pict_type)
+        return pic->f.pict_type;
+    if (pic->lookahead_inter_cplx * 10LL > pic->lookahead_intra_cplx * 9LL)
+        return AV_PICTURE_TYPE_I;
+    return AV_PICTURE_TYPE_P;
+}
+
+static double lookahead_qfactor(AVCodecContext *a, int pict_type)
+{
+    if (pict_type == AV_PICTURE_TYPE_I)
+        return FFABS(a->i_quant_factor);
+    if (pict_type == AV_PICTURE_TYPE_B)
+        return FFABS(a->b_quant_factor);
+    return 1.0;
+}
+
+/**
+ * Simulate the VBV buffer over the current picture and the ones queued
+ * after it in coding order, all coded at q scaled by the I/B quant factors.
+ * If the buffer would underflow, raise q so that the current picture saves
+ * its share of the missing bits.
+ */
+static double lookahead_qscale(MpegEncContext *s, double q, int qmax)
+{
+    RateControlContext *rcc  = &s->rc_context;
+    AVCodecContext *a        = s->avctx;
+    const double buffer_size = a->rc_buffer_size;
+    const double max_rate    = a->rc_max_rate * av_q2d(a->time_base);
+    int    type[FF_MAX_B_FRAMES + 1];
+    int    cplx[FF_MAX_B_FRAMES + 1];
+    double level = rcc->buffer_index;
+    double size, target;
+    int i, n = 0, full = 0;
+
+    type[n]   = s->pict_type;
+    cplx[n++] = lookahead_cplx(&s->current_picture, s->pict_type);
+
+    /* B-frames already chosen to follow the current picture */
+    for (i = 1; i < MAX_PICTURE_COUNT && n <= s->rc_lookahead; i++) {
+        Picture *pic = s->reordered_input_picture[i];
+        if (!pic)
+            break;
+        type[n]   = pic->f.pict_type;
+        cplx[n++] = lookahead_cplx(pic, pic->f.pict_type);
+    }
+    /* input pictures not yet reordered, the older ones are already coded
+     * or queued above */
+    for (i = 0; i < MAX_PICTURE_COUNT && n <= s->rc_lookahead; i++) {
+        Picture *pic = s->input_picture[i];
+        if (!pic || pic->f.display_picture_number <= s->last_reordered_number)
+            continue;
+        type[n] = lookahead_pict_type(pic);
+        cplx[n] = lookahead_cplx(pic, type[n]);
+        n++;
+    }
+
+    for (i = 0; i < n; i++) {
+        double qi = q * lookahead_qfactor(a, type[i]) /
+                        lookahead_qfactor(a, type[0]);
+
+        level -= predict_size(&rcc->lookahead_pred[type[i]], qi, cplx[i]);
+        if (level < 0)
+            break;
+        level += max_rate;
+        if (level > buffer_size) {
+            level = buffer_size;
+            full  = 1;
+        }
+    }
+
+    /* Nothing to do if the buffer holds, if the current picture itself is
+     * too big, which modify_qscale() already dealt with, or if the buffer
+     * runs full in between and so would waste what it saves. */
+    if (i == n || i == 0 || full)
+        return q;
+
+    size   = predict_size(&rcc->lookahead_pred[type[0]], q, cplx[0]);
+    target = size + level / i;
+    q      = target * qmax > size * q ? q * size / target : qmax;
+
+    if (a->debug & FF_DEBUG_RC)
+        av_log(a, AV_LOG_DEBUG,
+               "lookahead: buffer short by %d bits in %d pictures, q:%f\n",
+               (int)-level, i, q);
+
+    return q;
+}
+
 static void adaptive_quantization(MpegEncContext *s, double q)
 {
     int i;
@@ -756,6 +862,11 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
         update_predictor(&rcc->pred[s->last_pict_type],
                          rcc->last_qscale,
                          sqrt(last_var), s->frame_bits);
+        if (s->rc_lookahead)
+            update_predictor(&rcc->lookahead_pred[s->last_pict_type],
+                             rcc->last_qscale,
+                             rcc->last_lookahead_cplx,
+                             rcc->last_unstuffed_bits);
     }
 
     if (s->flags & CODEC_FLAG_PASS2) {
@@ -848,6 +959,10 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
 
         q = modify_qscale(s, rce, q, picture_number);
 
+        if (s->rc_lookahead && a->rc_buffer_size && a->rc_max_rate &&
+            picture_number > 2)
+            q = lookahead_qscale(s, q, qmax);
+
         rcc->pass1_wanted_bits += s->bit_rate / fps;
 
         assert(q > 0.0);
@@ -876,9 +991,10 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
         q = (int)(q + 0.5);
 
     if (!dry_run) {
-        rcc->last_qscale        = q;
-        rcc->last_mc_mb_var_sum = pic->mc_mb_var_sum;
-        rcc->last_mb_var_sum    = pic->mb_var_sum;
+        rcc->last_qscale         = q;
+        rcc->last_mc_mb_var_sum  = pic->mc_mb_var_sum;
+        rcc->last_mb_var_sum     = pic->mb_var_sum;
+        rcc->last_lookahead_cplx = lookahead_cplx(pic, pict_type);
     }
     return q;
 }
@@ -79,6 +79,9 @@ typedef struct RateControlContext{
     uint64_t qscale_sum[5];
     int frame_count[5];
     int last_non_b_pict_type;
+    Predictor lookahead_pred[5];  ///< frame size from the lookahead complexity, per picture type
+    int last_lookahead_cplx;      ///< lookahead complexity of the last coded picture
+    int last_unstuffed_bits;      ///< size of the last coded picture without VBV stuffing
 
     void *non_lavc_opaque;        ///< context for non lavc rc code (for example xvid)
     float dry_run_qscale;         ///< for xvid rc
@@ -24,6 +24,7 @@
 #include "bytestream.h"
 #include "internal.h"
 #include "sgi.h"
+#include "thread.h"
 
 typedef struct SgiState {
     unsigned int width;
@@ -155,6 +156,7 @@ static int decode_frame(AVCodecContext *avctx,
 {
     SgiState *s = avctx->priv_data;
     AVFrame *p = data;
+    ThreadFrame frame = { .f = data };
     unsigned int dimension, rle;
     int ret = 0;
     uint8_t *out_buf, *out_end;
@@ -204,7 +206,7 @@ static int decode_frame(AVCodecContext *avctx,
         return -1;
     avcodec_set_dimensions(avctx, s->width, s->height);
 
-    if (ff_get_buffer(avctx, p, 0) < 0) {
+    if (ff_thread_get_buffer(avctx, &frame, 0) < 0) {
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed.\n");
         return -1;
     }
@@ -240,5 +242,5 @@ AVCodec ff_sgi_decoder = {
     .priv_data_size = sizeof(SgiState),
     .decode         = decode_frame,
     .long_name      = NULL_IF_CONFIG_SMALL("SGI image"),
-    .capabilities   = CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
 };
@@ -25,6 +25,7 @@
 #include "bytestream.h"
 #include "internal.h"
 #include "targa.h"
+#include "thread.h"
 
 typedef struct TargaContext {
     GetByteContext gb;
@@ -99,6 +100,7 @@ static int decode_frame(AVCodecContext *avctx,
 {
     TargaContext * const s = avctx->priv_data;
     AVFrame * const p = data;
+    ThreadFrame frame = { .f = data };
     uint8_t *dst;
     int stride;
     int idlen, compr, y, w, h, bpp, flags, ret;
@@ -146,7 +148,7 @@ static int decode_frame(AVCodecContext *avctx,
         return ret;
     if(w != avctx->width || h != avctx->height)
         avcodec_set_dimensions(avctx, w, h);
-    if ((ret = ff_get_buffer(avctx, p, 0)) < 0){
+    if ((ret = ff_thread_get_buffer(avctx, &frame, 0)) < 0){
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return ret;
     }
@@ -238,6 +240,6 @@ AVCodec ff_targa_decoder = {
     .id             = AV_CODEC_ID_TARGA,
     .priv_data_size = sizeof(TargaContext),
     .decode         = decode_frame,
-    .capabilities   = CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
     .long_name      = NULL_IF_CONFIG_SMALL("Truevision Targa image"),
 };
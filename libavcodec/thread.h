@@ -61,6 +61,17 @@ void ff_thread_flush(AVCodecContext *avctx);
 int ff_thread_decode_frame(AVCodecContext *avctx, AVFrame *picture,
                            int *got_picture_ptr, AVPacket *avpkt);
 
+/**
+ * Submit a new frame to an encoding thread.
+ * Returns the packet of the oldest submitted frame in avpkt once all
+ * threads are busy, so packets are returned in the order of the frames.
+ * Passing a NULL frame returns the remaining packets one at a time.
+ *
+ * Parameters and return value are the same as avcodec_encode_video2().
+ */
+int ff_thread_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
+                           const AVFrame *frame, int *got_packet_ptr);
+
 /**
  * If the codec defines update_thread_context(), call this
  * when they are ready for the next thread to start decoding
@@ -961,15 +961,6 @@ int attribute_align_arg avcodec_open2(AVCodecContext *avctx, const AVCodec *code
         avctx->time_base.den = avctx->sample_rate;
     }
 
-    if (HAVE_THREADS && !avctx->thread_opaque) {
-        ret = ff_thread_init(avctx);
-        if (ret < 0) {
-            goto free_and_end;
-        }
-    }
-    if (!HAVE_THREADS && !(codec->capabilities & CODEC_CAP_AUTO_THREADS))
-        avctx->thread_count = 1;
-
     if (av_codec_is_encoder(avctx->codec)) {
         int i;
         if (avctx->codec->sample_fmts) {
@@ -1037,6 +1028,16 @@ int attribute_align_arg avcodec_open2(AVCodecContext *avctx, const AVCodec *code
             avctx->rc_initial_buffer_occupancy = avctx->rc_buffer_size * 3 / 4;
     }
 
+    /* encoding threads are initialized with the validated parameters */
+    if (HAVE_THREADS && !avctx->thread_opaque) {
+        ret = ff_thread_init(avctx);
+        if (ret < 0) {
+            goto free_and_end;
+        }
+    }
+    if (!HAVE_THREADS && !(codec->capabilities & CODEC_CAP_AUTO_THREADS))
+        avctx->thread_count = 1;
+
     if (avctx->codec->init && !(avctx->active_thread_type & FF_THREAD_FRAME)) {
         ret = avctx->codec->init(avctx);
         if (ret < 0) {
@@ -1270,7 +1271,8 @@ int attribute_align_arg avcodec_encode_video2(AVCodecContext *avctx,
 
     *got_packet_ptr = 0;
 
-    if (!(avctx->codec->capabilities & CODEC_CAP_DELAY) && !frame) {
+    if (!(avctx->codec->capabilities & CODEC_CAP_DELAY) && !frame &&
+        !(avctx->active_thread_type & FF_THREAD_FRAME)) {
         av_free_packet(avpkt);
         av_init_packet(avpkt);
         avpkt->size = 0;
@@ -1282,11 +1284,15 @@ int attribute_align_arg avcodec_encode_video2(AVCodecContext *avctx,
 
     av_assert0(avctx->codec->encode2);
 
-    ret = avctx->codec->encode2(avctx, avpkt, frame, got_packet_ptr);
+    if (HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME)
+        ret = ff_thread_encode_frame(avctx, avpkt, frame, got_packet_ptr);
+    else
+        ret = avctx->codec->encode2(avctx, avpkt, frame, got_packet_ptr);
     if (!ret) {
         if (!*got_packet_ptr)
             avpkt->size = 0;
-        else if (!(avctx->codec->capabilities & CODEC_CAP_DELAY))
+        else if (!(avctx->codec->capabilities & CODEC_CAP_DELAY) &&
+                 !(avctx->active_thread_type & FF_THREAD_FRAME))
             avpkt->pts = avpkt->dts = frame->pts;
 
         if (!user_packet && avpkt->size) {
@@ -235,6 +235,8 @@ typedef struct VC1Context{
     int quantizer_mode;   ///< 2bits, quantizer mode used for sequence, see QUANT_*
     int finterpflag;      ///< INTERPFRM present
     //@}
+    /* The sequence header fields above, from res_sprite on, are copied
+     * between frame threads as one block. */
 
     /** Frame decoding info for all profiles */
     //@{
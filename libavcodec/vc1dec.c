@@ -36,6 +36,7 @@
 #include "vc1data.h"
 #include "vc1acdata.h"
 #include "msmpeg4data.h"
+#include "thread.h"
 #include "unary.h"
 #include "mathops.h"
 #include "vdpau_internal.h"
@@ -325,6 +326,23 @@ static void vc1_smooth_overlap_filter_iblk(VC1Context *v)
     }
 }
 
+/**
+ * Wait for the rows of the forward (dir 0) or backward (dir 1) reference
+ * picture needed for prediction down to luma line y to be decoded by
+ * another frame thread. For field pictures y is given in field lines.
+ */
+static void vc1_await_ref_line(VC1Context *v, int dir, int y)
+{
+    MpegEncContext *s = &v->s;
+    Picture *ref = dir ? &s->next_picture : &s->last_picture;
+
+    if (!(s->avctx->active_thread_type & FF_THREAD_FRAME))
+        return;
+    if (v->field_mode)
+        y = 2 * y + 1;
+    ff_thread_await_progress(&ref->tf, av_clip(y >> 4, 0, s->mb_height - 1), 0);
+}
+
 /** Do motion compensation over 1 macroblock
  * Mostly adapted hpel_motion and qpel_motion from mpegvideo.c
  */
@@ -412,6 +430,8 @@ static void vc1_mc_1mv(VC1Context *v, int dir)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    vc1_await_ref_line(v, dir, FFMAX(src_y + 18, 2 * uvsrc_y + 17));
+
     srcY += src_y   * s->linesize   + src_x;
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
@@ -653,6 +673,8 @@ static void vc1_mc_4mv_luma(VC1Context *v, int n, int dir)
         }
     }
 
+    vc1_await_ref_line(v, dir, src_y + 18);
+
     srcY += src_y * s->linesize + src_x;
     if (v->field_mode && v->ref_field_type[dir])
         srcY += s->current_picture_ptr->f.linesize[0];
@@ -838,6 +860,8 @@ static void vc1_mc_4mv_chroma(VC1Context *v, int dir)
         uvsrc_y = av_clip(uvsrc_y, -8, s->avctx->coded_height >> 1);
     }
 
+    vc1_await_ref_line(v, dir, 2 * uvsrc_y + 17);
+
     if (!dir) {
         if (v->field_mode) {
             if ((v->cur_field_type != chroma_ref_type) && v->cur_field_type) {
@@ -960,6 +984,7 @@ static void vc1_mc_4mv_chroma4(VC1Context *v)
         // FIXME: implement proper pull-back (see vc1cropmv.c, vc1CROPMV_ChromaPullBack())
         uvsrc_x = av_clip(uvsrc_x, -8, s->avctx->coded_width  >> 1);
         uvsrc_y = av_clip(uvsrc_y, -8, s->avctx->coded_height >> 1);
+        vc1_await_ref_line(v, 0, 2 * uvsrc_y + 17);
         srcU = s->last_picture.f.data[1] + uvsrc_y * s->uvlinesize + uvsrc_x;
         srcV = s->last_picture.f.data[2] + uvsrc_y * s->uvlinesize + uvsrc_x;
         uvmx_field[i] = (uvmx_field[i] & 3) << 1;
@@ -1870,6 +1895,8 @@ static void vc1_interp_mc(VC1Context *v)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    vc1_await_ref_line(v, 1, FFMAX(src_y + 18, 2 * uvsrc_y + 17));
+
     srcY += src_y   * s->linesize   + src_x;
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
@@ -2045,6 +2072,7 @@ static inline void vc1_pred_b_mv(VC1Context *v, int dmv_x[2], int dmv_y[2],
         return;
     }
     if (!v->field_mode) {
+        vc1_await_ref_line(v, 1, s->mb_y * 16 + 15);
         s->mv[0][0][0] = scale_mv(s->next_picture.motion_val[1][xy][0], v->bfraction, 0, s->quarter_sample);
         s->mv[0][0][1] = scale_mv(s->next_picture.motion_val[1][xy][1], v->bfraction, 0, s->quarter_sample);
         s->mv[1][0][0] = scale_mv(s->next_picture.motion_val[1][xy][0], v->bfraction, 1, s->quarter_sample);
@@ -2236,6 +2264,7 @@ static inline void vc1_pred_b_mv_intfi(VC1Context *v, int n, int *dmv_x, int *dm
 
     if (v->bmvtype == BMV_TYPE_DIRECT) {
         int total_opp, k, f;
+        vc1_await_ref_line(v, 1, s->mb_y * 16 + 15);
         if (s->next_picture.mb_type[mb_pos + v->mb_off] != MB_TYPE_INTRA) {
             s->mv[0][0][0] = scale_mv(s->next_picture.motion_val[1][s->block_index[0] + v->blocks_off][0],
                                       v->bfraction, 0, s->quarter_sample);
@@ -4312,6 +4341,21 @@ static void vc1_decode_b_mb_intfi(VC1Context *v)
     }
 }
 
+/**
+ * Report the macroblock rows up to mb_y of a reference picture as final to
+ * frame threads waiting on it. Overlap smoothing and the in-loop filter may
+ * still modify the two rows above the one being decoded, so the block loops
+ * report with that lag. Field pictures are only reported once complete.
+ */
+static void vc1_report_decode_progress(VC1Context *v, int mb_y)
+{
+    MpegEncContext *s = &v->s;
+
+    if (!v->field_mode && s->pict_type != AV_PICTURE_TYPE_B &&
+        mb_y >= 0 && !s->er.error_occurred)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, mb_y, 0);
+}
+
 /** Decode blocks of I-frame
  */
 static void vc1_decode_i_blocks(VC1Context *v)
@@ -4441,11 +4485,13 @@ static void vc1_decode_i_blocks(VC1Context *v)
             ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
+        vc1_report_decode_progress(v, s->mb_y - 2);
 
         s->first_slice_line = 0;
     }
     if (v->s.loop_filter)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y - 1) * 16, 16);
+    vc1_report_decode_progress(v, s->end_mb_y - 1);
 
     /* This is intentionally mb_height and not end_mb_y - unlike in advanced
      * profile, these only differ are when decoding MSS2 rectangles. */
@@ -4569,6 +4615,7 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
             ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+        vc1_report_decode_progress(v, s->mb_y - 2);
         s->first_slice_line = 0;
     }
 
@@ -4583,6 +4630,7 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
     }
     if (v->s.loop_filter)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y-1)*16, 16);
+    vc1_report_decode_progress(v, s->end_mb_y - 1);
     ff_er_add_slice(&s->er, 0, s->start_mb_y << v->field_mode, s->mb_width - 1,
                     (s->end_mb_y << v->field_mode) - 1, ER_MB_END);
 }
@@ -4646,6 +4694,7 @@ static void vc1_decode_p_blocks(VC1Context *v)
         memmove(v->is_intra_base, v->is_intra, sizeof(v->is_intra_base[0]) * s->mb_stride);
         memmove(v->luma_mv_base,  v->luma_mv,  sizeof(v->luma_mv_base[0])  * s->mb_stride);
         if (s->mb_y != s->start_mb_y) ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
+        vc1_report_decode_progress(v, s->mb_y - 2);
         s->first_slice_line = 0;
     }
     if (apply_loop_filter) {
@@ -4658,6 +4707,7 @@ static void vc1_decode_p_blocks(VC1Context *v)
     }
     if (s->end_mb_y >= s->start_mb_y)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y - 1) * 16, 16);
+    vc1_report_decode_progress(v, s->end_mb_y - 1);
     ff_er_add_slice(&s->er, 0, s->start_mb_y << v->field_mode, s->mb_width - 1,
                     (s->end_mb_y << v->field_mode) - 1, ER_MB_END);
 }
@@ -4733,10 +4783,12 @@ static void vc1_decode_skip_blocks(VC1Context *v)
         s->mb_x = 0;
         ff_init_block_index(s);
         ff_update_block_index(s);
+        vc1_await_ref_line(v, 0, s->mb_y * 16 + 15);
         memcpy(s->dest[0], s->last_picture.f.data[0] + s->mb_y * 16 * s->linesize,   s->linesize   * 16);
         memcpy(s->dest[1], s->last_picture.f.data[1] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         memcpy(s->dest[2], s->last_picture.f.data[2] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
+        vc1_report_decode_progress(v, s->mb_y);
         s->first_slice_line = 0;
     }
     s->pict_type = AV_PICTURE_TYPE_P;
@@ -5157,6 +5209,7 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
     v->s.avctx = avctx;
     avctx->flags |= CODEC_FLAG_EMU_EDGE;
     v->s.flags   |= CODEC_FLAG_EMU_EDGE;
+    avctx->internal->allocate_progress = 1;
 
     if (ff_vc1_init_common(v) < 0)
         return -1;
@@ -5299,6 +5352,94 @@ av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
     return 0;
 }
 
+static uint8_t *rebase_mv_f(uint8_t *const dst_base[3], uint8_t *const src_base[3],
+                            int size, const uint8_t *ptr)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (ptr >= src_base[i] && ptr < src_base[i] + size)
+            return dst_base[i] + (ptr - src_base[i]);
+    return NULL;
+}
+
+static int vc1_update_thread_context(AVCodecContext *dst,
+                                     const AVCodecContext *src)
+{
+    VC1Context *v = dst->priv_data, *v1 = src->priv_data;
+    MpegEncContext *s = &v->s, *s1 = &v1->s;
+    int i, ret;
+
+    if (dst == src || !s1->context_initialized)
+        return 0;
+
+    /* The source thread may have set up its context and parsed in-band
+     * headers without starting a picture; only the headers can be
+     * propagated then. */
+    if (s1->linesize) {
+        if (s->context_initialized &&
+            (s->width != s1->width || s->height != s1->height))
+            ff_vc1_decode_end(dst);
+
+        if ((ret = ff_mpeg_update_thread_context(dst, src)) < 0)
+            return ret;
+
+        if (!v->mv_f_base && ff_vc1_decode_init_alloc_tables(v) < 0)
+            return AVERROR(ENOMEM);
+        s->h_edge_pos = s1->h_edge_pos;
+        s->v_edge_pos = s1->v_edge_pos;
+    }
+
+    /* sequence header */
+    memcpy(&v->res_sprite, &v1->res_sprite,
+           (char *)&v1->mv_mode - (char *)&v1->res_sprite);
+    s->max_b_frames     = s1->max_b_frames;
+    s->resync_marker    = s1->resync_marker;
+    s->loop_filter      = s1->loop_filter;
+
+    /* entry point header */
+    v->broken_link      = v1->broken_link;
+    v->closed_entry     = v1->closed_entry;
+    v->range_mapy_flag  = v1->range_mapy_flag;
+    v->range_mapy       = v1->range_mapy;
+    v->range_mapuv_flag = v1->range_mapuv_flag;
+    v->range_mapuv      = v1->range_mapuv;
+
+    /* state carried from the previous picture */
+    s->quarter_sample   = s1->quarter_sample;
+    v->rnd              = v1->rnd;
+    v->tff              = v1->tff;
+    v->refdist          = v1->refdist;
+
+    /* B-frames reuse the intensity compensation of their anchor */
+    v->use_ic           = v1->use_ic;
+    v->lumscale         = v1->lumscale;
+    v->lumshift         = v1->lumshift;
+    v->lumscale2        = v1->lumscale2;
+    v->lumshift2        = v1->lumshift2;
+    memcpy(v->luty,   v1->luty,   sizeof(v->luty));
+    memcpy(v->lutuv,  v1->lutuv,  sizeof(v->lutuv));
+    memcpy(v->luty2,  v1->luty2,  sizeof(v->luty2));
+    memcpy(v->lutuv2, v1->lutuv2, sizeof(v->lutuv2));
+
+    /* field MV direction planes, used by B-field direct prediction */
+    if (v1->interlace && s1->linesize) {
+        int size = 2 * (s->b8_stride * (s->mb_height * 2 + 1) +
+                        s->mb_stride * (s->mb_height + 1) * 2);
+        uint8_t *const dst_base[3] = { v->mv_f_base, v->mv_f_last_base, v->mv_f_next_base };
+        uint8_t *const src_base[3] = { v1->mv_f_base, v1->mv_f_last_base, v1->mv_f_next_base };
+
+        for (i = 0; i < 3; i++)
+            memcpy(dst_base[i], src_base[i], size);
+        for (i = 0; i < 2; i++) {
+            v->mv_f[i]      = rebase_mv_f(dst_base, src_base, size, v1->mv_f[i]);
+            v->mv_f_last[i] = rebase_mv_f(dst_base, src_base, size, v1->mv_f_last[i]);
+            v->mv_f_next[i] = rebase_mv_f(dst_base, src_base, size, v1->mv_f_next[i]);
+        }
+    }
+
+    return 0;
+}
 
 /** Decode a VC1/WMV3 frame
  * @todo TODO: Handle VC-1 IDUs (Transport level?)
@@ -5571,6 +5712,12 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
             v->mv_f[0] = tmp[0];
             v->mv_f[1] = tmp[1];
         }
+        /* Field pictures, and P-frames of interlaced sequences, update the
+         * field MV direction planes the following B-field pictures predict
+         * from, so those only finish setup once they are fully decoded. */
+        if (!v->field_mode &&
+            !(v->interlace && v->fcm == PROGRESSIVE && s->pict_type == AV_PICTURE_TYPE_P))
+            ff_thread_finish_setup(avctx);
         mb_height = s->mb_height >> v->field_mode;
         for (i = 0; i <= n_slices; i++) {
             if (i > 0 &&  slices[i - 1].mby_start >= mb_height) {
@@ -5669,6 +5816,8 @@ end:
     return buf_size;
 
 err:
+    if (s->current_picture_ptr)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, INT_MAX, 0);
     av_free(buf2);
     for (i = 0; i < n_slices; i++)
         av_free(slices[i].buf);
@@ -5708,7 +5857,8 @@ AVCodec ff_vc1_decoder = {
     .close          = ff_vc1_decode_end,
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
-    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY,
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY | CODEC_CAP_FRAME_THREADS,
     .long_name      = NULL_IF_CONFIG_SMALL("SMPTE VC-1"),
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
     .profiles       = NULL_IF_CONFIG_SMALL(profiles)
@@ -5724,7 +5874,8 @@ AVCodec ff_wmv3_decoder = {
     .close          = ff_vc1_decode_end,
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
-    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY,
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY | CODEC_CAP_FRAME_THREADS,
     .long_name      = NULL_IF_CONFIG_SMALL("Windows Media Video 9"),
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
     .profiles       = NULL_IF_CONFIG_SMALL(profiles)
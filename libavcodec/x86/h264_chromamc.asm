@@ -676,3 +676,188 @@ chroma_mc8_ssse3_func avg, h264, _rnd
 chroma_mc8_ssse3_func avg, vc1,  _nornd
 INIT_MMX ssse3
 chroma_mc4_ssse3_func avg, h264
+
+; stores 4 rows of 8 pixels packed as rows 0,2|1,3 in m0, r6 = 3*stride
+%macro chroma_mc8_avx2_store 1
+%ifidn %1, avg
+    vmovq            xm1, [r0     ]
+    vmovhps          xm1, xm1, [r0+r2*2]
+    vmovq            xm2, [r0+r2  ]
+    vmovhps          xm2, xm2, [r0+r6  ]
+    vinserti128       m1, m1, xm2, 1
+    vpavgb            m0, m0, m1
+%endif
+    vextracti128     xm1, m0, 1
+    vmovq    [r0     ], xm0
+    vmovhps  [r0+r2*2], xm0
+    vmovq    [r0+r2  ], xm1
+    vmovhps  [r0+r6  ], xm1
+    sub              r3d, 4
+    lea               r0, [r0+r2*4]
+%endmacro
+
+; The AVX2 version filters 4 rows at once, row n+1 of each pair sitting in the
+; upper lane. As in the SSSE3 version, the copy and 1-D cases get their own
+; loops so that column 8 and row h are only read when they are weighted.
+%macro chroma_mc8_avx2_func 1
+cglobal %1_h264_chroma_mc8_rnd, 6, 7, 8
+%if ARCH_X86_64
+    movsxd        r2, r2d
+%endif
+    mov          r6d, r5d
+    or           r6d, r4d
+    jne .at_least_one_non_zero
+    ; mx == 0 AND my == 0 - no filter needed
+    lea           r6, [r2*3]
+.next4rows_mv0:
+    vmovq            xm0, [r1     ]
+    vmovhps          xm0, xm0, [r1+r2*2]
+    vmovq            xm1, [r1+r2  ]
+    vmovhps          xm1, xm1, [r1+r6  ]
+    lea               r1, [r1+r2*4]
+    vinserti128       m0, m0, xm1, 1  ; rows 0,2|1,3
+    chroma_mc8_avx2_store %1
+    jg .next4rows_mv0
+    RET
+
+.at_least_one_non_zero:
+    test         r5d, r5d
+    je .my_is_zero
+    test         r4d, r4d
+    je .mx_is_zero
+
+    ; general case, bilinear
+    mov          r6d, r4d
+    shl          r4d, 8
+    sub          r4d, r6d
+    mov          r6d, 8
+    add          r4d, 8           ; x*255+8 = x<<8 | (8-x)
+    sub          r6d, r5d
+    imul         r6d, r4d         ; (8-y)*(x*255+8) = (8-y)*x<<8 | (8-y)*(8-x)
+    imul         r4d, r5d         ;    y *(x*255+8) =    y *x<<8 |    y *(8-x)
+
+    vmovd            xm7, r6d
+    vmovd            xm6, r4d
+    vpbroadcastw      m7, xm7
+    vpbroadcastw      m6, xm6
+    vpbroadcastw      m5, [pw_32]
+    lea               r6, [r2*3]
+    vmovq            xm0, [r1  ]
+    vmovq            xm1, [r1+1]
+    vpunpcklbw       xm0, xm0, xm1
+
+.next4rows:
+    vmovq            xm1, [r1+r2*1  ]
+    vmovq            xm2, [r1+r2*1+1]
+    vmovq            xm3, [r1+r2*2  ]
+    vmovq            xm4, [r1+r2*2+1]
+    vpunpcklbw       xm1, xm1, xm2    ; row 1
+    vpunpcklbw       xm3, xm3, xm4    ; row 2
+    vmovq            xm2, [r1+r6    ]
+    vmovq            xm4, [r1+r6  +1]
+    lea               r1, [r1+r2*4]
+    vpunpcklbw       xm2, xm2, xm4    ; row 3
+
+    vinserti128       m0, m0, xm1, 1  ; rows 0|1
+    vinserti128       m1, m1, xm3, 1  ; rows 1|2
+    vpmaddubsw        m0, m0, m7
+    vpmaddubsw        m1, m1, m6
+    vpaddw            m0, m0, m5
+    vpaddw            m0, m0, m1
+    vpsrlw            m0, m0, 6
+
+    vmovq            xm1, [r1  ]
+    vmovq            xm4, [r1+1]
+    vpunpcklbw       xm4, xm1, xm4    ; row 4
+    vinserti128       m3, m3, xm2, 1  ; rows 2|3
+    vinserti128       m2, m2, xm4, 1  ; rows 3|4
+    vpmaddubsw        m3, m3, m7
+    vpmaddubsw        m2, m2, m6
+    vpaddw            m3, m3, m5
+    vpaddw            m3, m3, m2
+    vpsrlw            m3, m3, 6
+
+    vpackuswb         m0, m0, m3      ; rows 0,2|1,3
+    chroma_mc8_avx2_store %1
+    vmovdqa          xm0, xm4
+    jg .next4rows
+    RET
+
+.my_is_zero:
+    mov          r5d, r4d
+    shl          r4d, 8
+    add          r4d, 8
+    sub          r4d, r5d         ; 255*x+8 = x<<8 | (8-x)
+    vmovd            xm7, r4d
+    vpbroadcastw      m7, xm7
+    vpbroadcastw      m6, [pw_4]
+    lea               r6, [r2*3]
+
+.next4xrows:
+    vmovq            xm0, [r1       ]
+    vmovq            xm1, [r1     +1]
+    vmovq            xm2, [r1+r2*2  ]
+    vmovq            xm3, [r1+r2*2+1]
+    vpunpcklbw       xm0, xm0, xm1    ; row 0
+    vpunpcklbw       xm2, xm2, xm3    ; row 2
+    vmovq            xm1, [r1+r2    ]
+    vmovq            xm3, [r1+r2  +1]
+    vmovq            xm4, [r1+r6    ]
+    vmovq            xm5, [r1+r6  +1]
+    lea               r1, [r1+r2*4]
+    vpunpcklbw       xm1, xm1, xm3    ; row 1
+    vpunpcklbw       xm4, xm4, xm5    ; row 3
+    vinserti128       m0, m0, xm1, 1  ; rows 0|1
+    vinserti128       m2, m2, xm4, 1  ; rows 2|3
+    vpmaddubsw        m0, m0, m7
+    vpmaddubsw        m2, m2, m7
+    vpaddw            m0, m0, m6
+    vpaddw            m2, m2, m6
+    vpsrlw            m0, m0, 3
+    vpsrlw            m2, m2, 3
+    vpackuswb         m0, m0, m2      ; rows 0,2|1,3
+    chroma_mc8_avx2_store %1
+    jg .next4xrows
+    RET
+
+.mx_is_zero:
+    mov          r4d, r5d
+    shl          r5d, 8
+    add          r5d, 8
+    sub          r5d, r4d         ; 255*y+8 = y<<8 | (8-y)
+    vmovd            xm7, r5d
+    vpbroadcastw      m7, xm7
+    vpbroadcastw      m6, [pw_4]
+    lea               r6, [r2*3]
+    vmovq            xm0, [r1]
+
+.next4yrows:
+    vmovq            xm1, [r1+r2  ]
+    vmovq            xm2, [r1+r2*2]
+    vmovq            xm3, [r1+r6  ]
+    lea               r1, [r1+r2*4]
+    vmovq            xm4, [r1     ]
+    vpunpcklbw       xm0, xm0, xm1    ; rows 0/1
+    vpunpcklbw       xm1, xm1, xm2    ; rows 1/2
+    vpunpcklbw       xm2, xm2, xm3    ; rows 2/3
+    vpunpcklbw       xm3, xm3, xm4    ; rows 3/4
+    vinserti128       m0, m0, xm1, 1  ; rows 0|1
+    vinserti128       m2, m2, xm3, 1  ; rows 2|3
+    vpmaddubsw        m0, m0, m7
+    vpmaddubsw        m2, m2, m7
+    vpaddw            m0, m0, m6
+    vpaddw            m2, m2, m6
+    vpsrlw            m0, m0, 3
+    vpsrlw            m2, m2, 3
+    vpackuswb         m0, m0, m2      ; rows 0,2|1,3
+    chroma_mc8_avx2_store %1
+    vmovdqa          xm0, xm4
+    jg .next4yrows
+    RET
+%endmacro
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+chroma_mc8_avx2_func put
+chroma_mc8_avx2_func avg
+%endif
@@ -28,6 +28,36 @@ AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
     return ff_get_audio_buffer(link->dst->outputs[0], nb_samples);
 }
 
+/**
+ * Set up the link frame pool for frames of at least nb_samples samples.
+ * The pool buffers are kept for smaller frames and only grow.
+ */
+static int update_frame_pool(AVFilterLink *link, int channels, int nb_samples)
+{
+    FFFramePool *pool = link->frame_pool;
+    int size[4] = { 0 };
+    int ret;
+
+    if (pool && pool->pools[0] && pool->format == link->format &&
+        pool->channel_layout == link->channel_layout &&
+        pool->nb_samples >= nb_samples)
+        return 0;
+
+    size[0] = av_samples_get_buffer_size(NULL, channels, nb_samples,
+                                         link->format, 0);
+    if (size[0] < 0)
+        return size[0];
+
+    if ((ret = ff_frame_pool_init(link, size)) < 0)
+        return ret;
+
+    pool = link->frame_pool;
+    pool->format         = link->format;
+    pool->channel_layout = link->channel_layout;
+    pool->nb_samples     = nb_samples;
+    return 0;
+}
+
 AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *frame = av_frame_alloc();
@@ -42,9 +72,12 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
     if (buf_size < 0)
         goto fail;
 
-    frame->buf[0] = av_buffer_alloc(buf_size);
+    if (update_frame_pool(link, channels, nb_samples) < 0)
+        goto fail;
+    frame->buf[0] = av_buffer_pool_get(link->frame_pool->pools[0]);
     if (!frame->buf[0])
         goto fail;
+    link->frame_pool->requests++;
 
     frame->nb_samples = nb_samples;
     ret = avcodec_fill_audio_frame(frame, channels, link->format,
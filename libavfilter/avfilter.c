@@ -24,6 +24,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
+#include "libavutil/cpu.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
@@ -349,14 +350,37 @@ static const AVClass *filter_child_class_next(const AVClass *prev)
     return NULL;
 }
 
+#define OFFSET(x) offsetof(AVFilterContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM
+static const AVOption avfilter_options[] = {
+    { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
+        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .unit = "thread_type" },
+    { NULL },
+};
+
 static const AVClass avfilter_class = {
     .class_name = "AVFilter",
     .item_name  = filter_name,
     .version    = LIBAVUTIL_VERSION_INT,
     .child_next = filter_child_next,
     .child_class_next = filter_child_class_next,
+    .option           = avfilter_options,
 };
 
+static int default_execute(AVFilterContext *ctx, avfilter_action_func *func, void *arg,
+                           int *ret, int nb_jobs)
+{
+    int i;
+
+    for (i = 0; i < nb_jobs; i++) {
+        int r = func(ctx, arg, i, nb_jobs);
+        if (ret)
+            ret[i] = r;
+    }
+    return 0;
+}
+
 AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name)
 {
     AVFilterContext *ret;
@@ -371,6 +395,13 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name)
     ret->av_class = &avfilter_class;
     ret->filter   = filter;
     ret->name     = inst_name ? av_strdup(inst_name) : NULL;
+    av_opt_set_defaults(ret);
+
+    ret->internal = av_mallocz(sizeof(*ret->internal));
+    if (!ret->internal)
+        goto err;
+    ret->internal->execute = default_execute;
+
     if (filter->priv_size) {
         ret->priv     = av_mallocz(filter->priv_size);
         if (!ret->priv)
@@ -418,10 +449,72 @@ err:
     av_freep(&ret->output_pads);
     ret->nb_outputs = 0;
     av_freep(&ret->priv);
+    av_freep(&ret->internal);
     av_free(ret);
     return NULL;
 }
 
+int ff_filter_get_nb_threads(AVFilterContext *ctx)
+{
+    if (!(ctx->thread_type & AVFILTER_THREAD_SLICE))
+        return 1;
+    return ctx->graph->nb_threads > 0 ? ctx->graph->nb_threads : av_cpu_count();
+}
+
+static AVBufferRef *frame_pool_alloc(void *opaque, int size)
+{
+    FFFramePool *pool = opaque;
+    pool->misses++;
+    return av_buffer_alloc(size);
+}
+
+int ff_frame_pool_init(AVFilterLink *link, const int size[4])
+{
+    FFFramePool *pool = link->frame_pool;
+    int i;
+
+    if (!pool) {
+        pool = link->frame_pool = av_mallocz(sizeof(*pool));
+        if (!pool)
+            return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < 4; i++) {
+        av_buffer_pool_uninit(&pool->pools[i]);
+        if (size[i]) {
+            pool->pools[i] = av_buffer_pool_init2(size[i], pool,
+                                                  frame_pool_alloc);
+            if (!pool->pools[i])
+                goto fail;
+        }
+    }
+    return 0;
+fail:
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+    pool->format = -1;
+    return AVERROR(ENOMEM);
+}
+
+void ff_frame_pool_free(AVFilterLink *link)
+{
+    FFFramePool *pool = link->frame_pool;
+    int i;
+
+    if (!pool)
+        return;
+
+    if (pool->requests)
+        av_log(link->dst, AV_LOG_DEBUG,
+               "Frame pool of input %s: %u buffers reused, %u allocated\n",
+               link->dstpad->name, pool->requests - pool->misses,
+               pool->misses);
+
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+    av_freep(&link->frame_pool);
+}
+
 #if FF_API_AVFILTER_OPEN
 int avfilter_open(AVFilterContext **filter_ctx, AVFilter *filter, const char *inst_name)
 {
@@ -451,6 +544,7 @@ void avfilter_free(AVFilterContext *filter)
             ff_formats_unref(&link->out_samplerates);
             ff_channel_layouts_unref(&link->in_channel_layouts);
             ff_channel_layouts_unref(&link->out_channel_layouts);
+            ff_frame_pool_free(link);
         }
         av_freep(&link);
     }
@@ -464,6 +558,7 @@ void avfilter_free(AVFilterContext *filter)
             ff_formats_unref(&link->out_samplerates);
             ff_channel_layouts_unref(&link->in_channel_layouts);
             ff_channel_layouts_unref(&link->out_channel_layouts);
+            ff_frame_pool_free(link);
         }
         av_freep(&link);
     }
@@ -477,6 +572,7 @@ void avfilter_free(AVFilterContext *filter)
     av_freep(&filter->inputs);
     av_freep(&filter->outputs);
     av_freep(&filter->priv);
+    av_freep(&filter->internal);
     av_free(filter);
 }
 
@@ -524,6 +620,15 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
     int ret = 0;
 
+    if (ctx->graph && ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
+        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        ctx->graph->internal->thread_execute) {
+        ctx->thread_type       = AVFILTER_THREAD_SLICE;
+        ctx->internal->execute = ctx->graph->internal->thread_execute;
+    } else {
+        ctx->thread_type = 0;
+    }
+
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict(ctx->priv, options);
         if (ret < 0) {
@@ -123,6 +123,49 @@ void ff_avfilter_default_free_buffer(AVFilterBuffer *buf);
 /** Tell is a format is contained in the provided list terminated by -1. */
 int ff_fmt_is_in(int fmt, const int *fmts);
 
+struct AVFilterGraphInternal {
+    void *thread;
+    avfilter_execute_func *thread_execute;
+};
+
+struct AVFilterInternal {
+    avfilter_execute_func *execute;
+};
+
+/**
+ * Pools of data buffers used by the default get_buffer functions for the
+ * frames allocated on a link.
+ */
+typedef struct FFFramePool {
+    AVBufferPool *pools[4];
+    int linesize[4];
+
+    /* properties of the frames the pools were set up for */
+    int format;
+    int width, height;          ///< video only
+    uint64_t channel_layout;    ///< audio only
+    int nb_samples;             ///< audio only, maximum number of samples
+
+    unsigned requests;          ///< buffers requested from the pools
+    unsigned misses;            ///< requests the pools had to allocate for
+} FFFramePool;
+
+/**
+ * Set up the frame pool of a link for buffers of the given sizes, dropping
+ * any previous pools. The frame properties must be set by the caller.
+ *
+ * @param size size of the buffers of each of the four pools, 0 for an
+ *             unused pool
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ff_frame_pool_init(AVFilterLink *link, const int size[4]);
+
+/**
+ * Free the frame pool of a link, logging its statistics.
+ * Frames still using buffers from the pool stay valid.
+ */
+void ff_frame_pool_free(AVFilterLink *link);
+
 #define FF_DPRINTF_START(ctx, func) av_dlog(NULL, "%-16s: ", #func)
 
 void ff_dlog_link(void *ctx, AVFilterLink *link, int end);
@@ -206,6 +249,13 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame);
  */
 AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name);
 
+/**
+ * Get the number of jobs a slice threaded filter should split its work into,
+ * i.e. the number of threads available to it. Always 1 for filters that do
+ * not run with slice threading.
+ */
+int ff_filter_get_nb_threads(AVFilterContext *ctx);
+
 /**
  * Remove a filter from a graph;
  */
@@ -72,7 +72,7 @@ typedef struct {
     int hsub, vsub;
     int radius[4];
     int power[4];
-    uint8_t *temp[2]; ///< temporary buffer used in blur_power()
+    uint8_t *temp[4][2]; ///< per-plane temporary buffers used in blur_power()
 } BoxBlurContext;
 
 #define Y 0
@@ -108,9 +108,12 @@ static av_cold int init(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     BoxBlurContext *boxblur = ctx->priv;
+    int i;
 
-    av_freep(&boxblur->temp[0]);
-    av_freep(&boxblur->temp[1]);
+    for (i = 0; i < 4; i++) {
+        av_freep(&boxblur->temp[i][0]);
+        av_freep(&boxblur->temp[i][1]);
+    }
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -137,15 +140,14 @@ static int config_input(AVFilterLink *inlink)
     int cw, ch;
     double var_values[VARS_NB], res;
     char *expr;
-    int ret;
-
-    av_freep(&boxblur->temp[0]);
-    av_freep(&boxblur->temp[1]);
-    if (!(boxblur->temp[0] = av_malloc(FFMAX(w, h))))
-       return AVERROR(ENOMEM);
-    if (!(boxblur->temp[1] = av_malloc(FFMAX(w, h)))) {
-        av_freep(&boxblur->temp[0]);
-        return AVERROR(ENOMEM);
+    int ret, i;
+
+    for (i = 0; i < 4; i++) {
+        av_freep(&boxblur->temp[i][0]);
+        av_freep(&boxblur->temp[i][1]);
+        if (!(boxblur->temp[i][0] = av_malloc(FFMAX(w, h))) ||
+            !(boxblur->temp[i][1] = av_malloc(FFMAX(w, h))))
+            return AVERROR(ENOMEM);
     }
 
     boxblur->hsub = desc->log2_chroma_w;
@@ -298,16 +300,42 @@ static void vblur(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_li
                    h, radius, power, temp);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int nb_planes;
+} ThreadData;
+
+static int blur_plane(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    BoxBlurContext *boxblur = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in  = td->in;
+    AVFrame *out = td->out;
+    int plane;
+    int cw = ctx->inputs[0]->w >> boxblur->hsub, ch = in->height >> boxblur->vsub;
+    int w[4] = { ctx->inputs[0]->w, cw, cw, ctx->inputs[0]->w };
+    int h[4] = { in->height, ch, ch, in->height };
+
+    for (plane = jobnr; plane < td->nb_planes; plane += nb_jobs) {
+        hblur(out->data[plane], out->linesize[plane],
+              in ->data[plane], in ->linesize[plane],
+              w[plane], h[plane], boxblur->radius[plane], boxblur->power[plane],
+              boxblur->temp[plane]);
+        vblur(out->data[plane], out->linesize[plane],
+              out->data[plane], out->linesize[plane],
+              w[plane], h[plane], boxblur->radius[plane], boxblur->power[plane],
+              boxblur->temp[plane]);
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
-    BoxBlurContext *boxblur = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
+    ThreadData td;
     AVFrame *out;
-    int plane;
-    int cw = inlink->w >> boxblur->hsub, ch = in->height >> boxblur->vsub;
-    int w[4] = { inlink->w, cw, cw, inlink->w };
-    int h[4] = { in->height, ch, ch, in->height };
 
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -316,17 +344,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
     av_frame_copy_props(out, in);
 
-    for (plane = 0; in->data[plane] && plane < 4; plane++)
-        hblur(out->data[plane], out->linesize[plane],
-              in ->data[plane], in ->linesize[plane],
-              w[plane], h[plane], boxblur->radius[plane], boxblur->power[plane],
-              boxblur->temp);
-
-    for (plane = 0; in->data[plane] && plane < 4; plane++)
-        vblur(out->data[plane], out->linesize[plane],
-              out->data[plane], out->linesize[plane],
-              w[plane], h[plane], boxblur->radius[plane], boxblur->power[plane],
-              boxblur->temp);
+    td.in  = in;
+    td.out = out;
+    for (td.nb_planes = 0; td.nb_planes < 4 && in->data[td.nb_planes]; td.nb_planes++)
+        ;
+    ctx->internal->execute(ctx, blur_plane, &td, NULL,
+                           FFMIN(td.nb_planes, ff_filter_get_nb_threads(ctx)));
 
     av_frame_free(&in);
 
@@ -384,4 +407,6 @@ AVFilter avfilter_vf_boxblur = {
 
     .inputs    = avfilter_vf_boxblur_inputs,
     .outputs   = avfilter_vf_boxblur_outputs,
+
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -79,13 +79,13 @@ void ff_gradfun_blur_line_c(uint16_t *dc, uint16_t *buf, uint16_t *buf1, uint8_t
     }
 }
 
-static void filter(GradFunContext *ctx, uint8_t *dst, uint8_t *src, int width, int height, int dst_linesize, int src_linesize, int r)
+static void filter(GradFunContext *ctx, uint16_t *work_buf, uint8_t *dst, uint8_t *src, int width, int height, int dst_linesize, int src_linesize, int r)
 {
     int bstride = FFALIGN(width, 16) / 2;
     int y;
     uint32_t dc_factor = (1 << 21) / (r * r);
-    uint16_t *dc = ctx->buf + 16;
-    uint16_t *buf = ctx->buf + bstride + 32;
+    uint16_t *dc = work_buf + 16;
+    uint16_t *buf = work_buf + bstride + 32;
     int thresh = ctx->thresh;
 
     memset(dc, 0, (bstride + 16) * sizeof(*buf));
@@ -141,7 +141,10 @@ static av_cold int init(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     GradFunContext *gf = ctx->priv;
-    av_freep(&gf->buf);
+    int i;
+
+    for (i = 0; i < 4; i++)
+        av_freep(&gf->buf[i]);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -165,10 +168,14 @@ static int config_input(AVFilterLink *inlink)
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     int hsub = desc->log2_chroma_w;
     int vsub = desc->log2_chroma_h;
+    int i;
 
-    gf->buf = av_mallocz((FFALIGN(inlink->w, 16) * (gf->radius + 1) / 2 + 32) * sizeof(uint16_t));
-    if (!gf->buf)
-        return AVERROR(ENOMEM);
+    for (i = 0; i < 4; i++) {
+        av_freep(&gf->buf[i]);
+        gf->buf[i] = av_mallocz((FFALIGN(inlink->w, 16) * (gf->radius + 1) / 2 + 32) * sizeof(uint16_t));
+        if (!gf->buf[i])
+            return AVERROR(ENOMEM);
+    }
 
     gf->chroma_w = -((-inlink->w) >> hsub);
     gf->chroma_h = -((-inlink->h) >> vsub);
@@ -177,12 +184,46 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int nb_planes;
+} ThreadData;
+
+static int filter_plane(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    GradFunContext *gf = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData *td = arg;
+    AVFrame *in  = td->in;
+    AVFrame *out = td->out;
+    int p;
+
+    for (p = jobnr; p < td->nb_planes; p += nb_jobs) {
+        int w = inlink->w;
+        int h = inlink->h;
+        int r = gf->radius;
+        if (p) {
+            w = gf->chroma_w;
+            h = gf->chroma_h;
+            r = gf->chroma_r;
+        }
+
+        if (FFMIN(w, h) > 2 * r)
+            filter(gf, gf->buf[p], out->data[p], in->data[p], w, h, out->linesize[p], in->linesize[p], r);
+        else if (out->data[p] != in->data[p])
+            av_image_copy_plane(out->data[p], out->linesize[p], in->data[p], in->linesize[p], w, h);
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    GradFunContext *gf = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx  = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ThreadData td;
     AVFrame *out;
-    int p, direct;
+    int direct;
 
     if (av_frame_is_writable(in)) {
         direct = 1;
@@ -200,21 +241,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         out->height = outlink->h;
     }
 
-    for (p = 0; p < 4 && in->data[p]; p++) {
-        int w = inlink->w;
-        int h = inlink->h;
-        int r = gf->radius;
-        if (p) {
-            w = gf->chroma_w;
-            h = gf->chroma_h;
-            r = gf->chroma_r;
-        }
-
-        if (FFMIN(w, h) > 2 * r)
-            filter(gf, out->data[p], in->data[p], w, h, out->linesize[p], in->linesize[p], r);
-        else if (out->data[p] != in->data[p])
-            av_image_copy_plane(out->data[p], out->linesize[p], in->data[p], in->linesize[p], w, h);
-    }
+    td.in  = in;
+    td.out = out;
+    for (td.nb_planes = 0; td.nb_planes < 4 && in->data[td.nb_planes]; td.nb_planes++)
+        ;
+    ctx->internal->execute(ctx, filter_plane, &td, NULL,
+                           FFMIN(td.nb_planes, ff_filter_get_nb_threads(ctx)));
 
     if (!direct)
         av_frame_free(&in);
@@ -266,4 +298,6 @@ AVFilter avfilter_vf_gradfun = {
 
     .inputs    = avfilter_vf_gradfun_inputs,
     .outputs   = avfilter_vf_gradfun_outputs,
+
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
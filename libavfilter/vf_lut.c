@@ -279,57 +279,74 @@ static int config_props(AVFilterLink *inlink)
     return 0;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFilterContext *ctx = inlink->dst;
     LutContext *lut = ctx->priv;
-    AVFilterLink *outlink = ctx->outputs[0];
-    AVFrame *out;
-    uint8_t *inrow, *outrow, *inrow0, *outrow0;
+    ThreadData *td  = arg;
+    AVFrame *in  = td->in;
+    AVFrame *out = td->out;
+    uint8_t *inrow, *outrow;
     int i, j, k, plane;
 
-    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-    if (!out) {
-        av_frame_free(&in);
-        return AVERROR(ENOMEM);
-    }
-    av_frame_copy_props(out, in);
-
     if (lut->is_rgb) {
         /* packed */
-        inrow0  = in ->data[0];
-        outrow0 = out->data[0];
+        int slice_start = (in->height *  jobnr   ) / nb_jobs;
+        int slice_end   = (in->height * (jobnr+1)) / nb_jobs;
 
-        for (i = 0; i < in->height; i ++) {
-            inrow  = inrow0;
-            outrow = outrow0;
-            for (j = 0; j < inlink->w; j++) {
+        for (i = slice_start; i < slice_end; i++) {
+            inrow  = in ->data[0] + i * in ->linesize[0];
+            outrow = out->data[0] + i * out->linesize[0];
+            for (j = 0; j < ctx->inputs[0]->w; j++) {
                 for (k = 0; k < lut->step; k++)
                     outrow[k] = lut->lut[lut->rgba_map[k]][inrow[k]];
                 outrow += lut->step;
                 inrow  += lut->step;
             }
-            inrow0  += in ->linesize[0];
-            outrow0 += out->linesize[0];
         }
     } else {
         /* planar */
         for (plane = 0; plane < 4 && in->data[plane]; plane++) {
             int vsub = plane == 1 || plane == 2 ? lut->vsub : 0;
             int hsub = plane == 1 || plane == 2 ? lut->hsub : 0;
-
-            inrow  = in ->data[plane];
-            outrow = out->data[plane];
-
-            for (i = 0; i < in->height >> vsub; i ++) {
-                for (j = 0; j < inlink->w>>hsub; j++)
+            int h = in->height >> vsub;
+            int slice_start = (h *  jobnr   ) / nb_jobs;
+            int slice_end   = (h * (jobnr+1)) / nb_jobs;
+
+            for (i = slice_start; i < slice_end; i++) {
+                inrow  = in ->data[plane] + i * in ->linesize[plane];
+                outrow = out->data[plane] + i * out->linesize[plane];
+                for (j = 0; j < ctx->inputs[0]->w >> hsub; j++)
                     outrow[j] = lut->lut[plane][inrow[j]];
-                inrow  += in ->linesize[plane];
-                outrow += out->linesize[plane];
             }
         }
     }
 
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ThreadData td;
+    AVFrame *out;
+
+    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+    av_frame_copy_props(out, in);
+
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, filter_slice, &td, NULL,
+                           FFMIN(outlink->h, ff_filter_get_nb_threads(ctx)));
+
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
 }
@@ -366,6 +383,8 @@ static const AVFilterPad outputs[] = {
                                                                         \
         .inputs        = inputs,                                        \
         .outputs       = outputs,                                       \
+                                                                        \
+        .flags         = AVFILTER_FLAG_SLICE_THREADS,                   \
     }
 
 #if CONFIG_LUT_FILTER
@@ -182,15 +182,23 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
-static void blend_frame(AVFilterContext *ctx,
-                        AVFrame *dst, AVFrame *src,
-                        int x, int y)
+typedef struct ThreadData {
+    AVFrame *dst, *src;
+    int x, y;
+} ThreadData;
+
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *over = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *dst = td->dst;
+    AVFrame *src = td->src;
+    int x = td->x, y = td->y;
     int i, j, k;
     int width, height;
     int overlay_end_y = y + src->height;
     int end_y, start_y;
+    int slice_start, slice_end;
 
     width = FFMIN(dst->width - x, src->width);
     end_y = FFMIN(dst->height, overlay_end_y);
@@ -204,7 +212,13 @@ static void blend_frame(AVFilterContext *ctx,
         int r = dst->format == AV_PIX_FMT_BGR24 ? 0 : 2;
         if (y < 0)
             sp += -y * src->linesize[0];
-        for (i = 0; i < height; i++) {
+
+        slice_start = (height *  jobnr   ) / nb_jobs;
+        slice_end   = (height * (jobnr+1)) / nb_jobs;
+        dp += slice_start * dst->linesize[0];
+        sp += slice_start * src->linesize[0];
+
+        for (i = slice_start; i < slice_end; i++) {
             uint8_t *d = dp, *s = sp;
             for (j = 0; j < width; j++) {
                 d[r] = (d[r] * (0xff - s[3]) + s[0] * s[3] + 128) >> 8;
@@ -230,7 +244,14 @@ static void blend_frame(AVFilterContext *ctx,
                 sp += ((-y) >> vsub) * src->linesize[i];
                 ap += -y * src->linesize[3];
             }
-            for (j = 0; j < hp; j++) {
+
+            slice_start = (hp *  jobnr   ) / nb_jobs;
+            slice_end   = (hp * (jobnr+1)) / nb_jobs;
+            dp += slice_start * dst->linesize[i];
+            sp += slice_start * src->linesize[i];
+            ap += slice_start * (1 << vsub) * src->linesize[3];
+
+            for (j = slice_start; j < slice_end; j++) {
                 uint8_t *d = dp, *s = sp, *a = ap;
                 for (k = 0; k < wp; k++) {
                     // average alpha for color components, improve quality
@@ -256,6 +277,22 @@ static void blend_frame(AVFilterContext *ctx,
             }
         }
     }
+
+    return 0;
+}
+
+static void blend_frame(AVFilterContext *ctx,
+                        AVFrame *dst, AVFrame *src,
+                        int x, int y)
+{
+    ThreadData td = { .dst = dst, .src = src, .x = x, .y = y };
+    int height = FFMIN(dst->height, y + src->height) - FFMAX(y, 0);
+
+    if (height <= 0)
+        return;
+
+    ctx->internal->execute(ctx, blend_slice, &td, NULL,
+                           FFMIN(height, ff_filter_get_nb_threads(ctx)));
 }
 
 static int filter_frame_main(AVFilterLink *inlink, AVFrame *frame)
@@ -406,4 +443,6 @@ AVFilter avfilter_vf_overlay = {
 
     .inputs    = avfilter_vf_overlay_inputs,
     .outputs   = avfilter_vf_overlay_outputs,
+
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -227,11 +227,32 @@ static int config_props(AVFilterLink *outlink)
         inlink->format == outlink->format)
         scale->sws = NULL;
     else {
-        scale->sws = sws_getContext(inlink ->w, inlink ->h, inlink ->format,
-                                    outlink->w, outlink->h, outlink->format,
-                                    scale->flags, NULL, NULL, NULL);
+        int nb_threads = 1, ret;
+
+        /* libswscale splits the frame into bands on its own worker threads,
+         * the filtergraph slice threading settings only give their number */
+        if (ctx->graph && ctx->graph->thread_type & AVFILTER_THREAD_SLICE)
+            nb_threads = ctx->graph->nb_threads;
+
+        scale->sws = sws_alloc_context();
         if (!scale->sws)
-            return AVERROR(EINVAL);
+            return AVERROR(ENOMEM);
+
+        av_opt_set_int(scale->sws, "srcw",       inlink ->w,      0);
+        av_opt_set_int(scale->sws, "srch",       inlink ->h,      0);
+        av_opt_set_int(scale->sws, "src_format", inlink ->format, 0);
+        av_opt_set_int(scale->sws, "dstw",       outlink->w,      0);
+        av_opt_set_int(scale->sws, "dsth",       outlink->h,      0);
+        av_opt_set_int(scale->sws, "dst_format", outlink->format, 0);
+        av_opt_set_int(scale->sws, "sws_flags",  scale->flags,    0);
+        av_opt_set_int(scale->sws, "threads",    nb_threads,      0);
+
+        ret = sws_init_context(scale->sws, NULL, NULL);
+        if (ret < 0) {
+            sws_freeContext(scale->sws);
+            scale->sws = NULL;
+            return ret;
+        }
     }
 
 
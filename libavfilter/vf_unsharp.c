@@ -59,7 +59,7 @@ typedef struct FilterParam {
     int steps_y;                             ///< vertical step count
     int scalebits;                           ///< bits to shift pixel
     int32_t halfscale;                       ///< amount to add to pixel
-    uint32_t *sc[(MAX_SIZE * MAX_SIZE) - 1]; ///< finite state machine storage
+    uint32_t *sc[2][(MAX_SIZE * MAX_SIZE) - 1]; ///< finite state machine storage, one per plane
 } FilterParam;
 
 typedef struct {
@@ -73,9 +73,9 @@ typedef struct {
 
 static void apply_unsharp(      uint8_t *dst, int dst_stride,
                           const uint8_t *src, int src_stride,
-                          int width, int height, FilterParam *fp)
+                          int width, int height, FilterParam *fp,
+                          uint32_t **sc)
 {
-    uint32_t **sc = fp->sc;
     uint32_t sr[(MAX_SIZE * MAX_SIZE) - 1], tmp1, tmp2;
 
     int32_t res;
@@ -159,9 +159,10 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width)
+static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type,
+                              int width, int nb_planes)
 {
-    int z;
+    int z, p;
     const char *effect;
 
     effect = fp->amount == 0 ? "none" : fp->amount < 0 ? "blur" : "sharpen";
@@ -169,8 +170,9 @@ static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char
     av_log(ctx, AV_LOG_VERBOSE, "effect:%s type:%s msize_x:%d msize_y:%d amount:%0.2f\n",
            effect, effect_type, fp->msize_x, fp->msize_y, fp->amount / 65535.0);
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        fp->sc[z] = av_malloc(sizeof(*(fp->sc[z])) * (width + 2 * fp->steps_x));
+    for (p = 0; p < nb_planes; p++)
+        for (z = 0; z < 2 * fp->steps_y; z++)
+            fp->sc[p][z] = av_malloc(sizeof(*(fp->sc[p][z])) * (width + 2 * fp->steps_x));
 }
 
 static int config_props(AVFilterLink *link)
@@ -181,18 +183,19 @@ static int config_props(AVFilterLink *link)
     unsharp->hsub = desc->log2_chroma_w;
     unsharp->vsub = desc->log2_chroma_h;
 
-    init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w);
-    init_filter_param(link->dst, &unsharp->chroma, "chroma", SHIFTUP(link->w, unsharp->hsub));
+    init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w, 1);
+    init_filter_param(link->dst, &unsharp->chroma, "chroma", SHIFTUP(link->w, unsharp->hsub), 2);
 
     return 0;
 }
 
 static void free_filter_param(FilterParam *fp)
 {
-    int z;
+    int z, p;
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        av_free(fp->sc[z]);
+    for (p = 0; p < 2; p++)
+        for (z = 0; z < 2 * fp->steps_y; z++)
+            av_free(fp->sc[p][z]);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -203,13 +206,37 @@ static av_cold void uninit(AVFilterContext *ctx)
     free_filter_param(&unsharp->chroma);
 }
 
-static int filter_frame(AVFilterLink *link, AVFrame *in)
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int unsharp_plane(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    UnsharpContext *unsharp = link->dst->priv;
-    AVFilterLink *outlink   = link->dst->outputs[0];
-    AVFrame *out;
+    UnsharpContext *unsharp = ctx->priv;
+    AVFilterLink *link      = ctx->inputs[0];
+    ThreadData *td          = arg;
     int cw = SHIFTUP(link->w, unsharp->hsub);
     int ch = SHIFTUP(link->h, unsharp->vsub);
+    int plane;
+
+    for (plane = jobnr; plane < 3; plane += nb_jobs) {
+        FilterParam *fp = plane ? &unsharp->chroma : &unsharp->luma;
+
+        apply_unsharp(td->out->data[plane], td->out->linesize[plane],
+                      td->in->data[plane],  td->in->linesize[plane],
+                      plane ? cw : link->w, plane ? ch : link->h,
+                      fp, fp->sc[plane ? plane - 1 : 0]);
+    }
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx  = link->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ThreadData td;
+    AVFrame *out;
 
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -218,9 +245,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     }
     av_frame_copy_props(out, in);
 
-    apply_unsharp(out->data[0], out->linesize[0], in->data[0], in->linesize[0], link->w, link->h, &unsharp->luma);
-    apply_unsharp(out->data[1], out->linesize[1], in->data[1], in->linesize[1], cw,      ch,      &unsharp->chroma);
-    apply_unsharp(out->data[2], out->linesize[2], in->data[2], in->linesize[2], cw,      ch,      &unsharp->chroma);
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, unsharp_plane, &td, NULL,
+                           FFMIN(3, ff_filter_get_nb_threads(ctx)));
 
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
@@ -277,4 +305,6 @@ AVFilter avfilter_vf_unsharp = {
     .inputs    = avfilter_vf_unsharp_inputs,
 
     .outputs   = avfilter_vf_unsharp_outputs,
+
+    .flags     = AVFILTER_FLAG_SLICE_THREADS,
 };
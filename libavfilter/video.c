@@ -20,8 +20,10 @@
 #include <stdio.h>
 
 #include "libavutil/buffer.h"
+#include "libavutil/common.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -32,13 +34,54 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
     return ff_get_video_buffer(link->dst->outputs[0], w, h);
 }
 
-/* TODO: set the buffer's priv member to a context structure for the whole
- * filter chain.  This will allow for a buffer pool instead of the constant
- * alloc & free cycle currently implemented. */
+/**
+ * Set up the link frame pool for frames of the given size, with the same
+ * layout av_frame_get_buffer() uses for an alignment of 32.
+ */
+static int update_frame_pool(AVFilterLink *link, int w, int h)
+{
+    FFFramePool *pool = link->frame_pool;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
+    int linesize[4] = { 0 }, size[4] = { 0 };
+    int i, ret;
+
+    if (pool && pool->pools[0] && pool->format == link->format &&
+        pool->width == w && pool->height == h)
+        return 0;
+
+    if (!desc)
+        return AVERROR(EINVAL);
+    if ((ret = av_image_check_size(w, h, 0, link->dst)) < 0 ||
+        (ret = av_image_fill_linesizes(linesize, link->format, w)) < 0)
+        return ret;
+
+    for (i = 0; i < 4 && linesize[i]; i++) {
+        int plane_h = h;
+        if (i == 1 || i == 2)
+            plane_h = -((-h) >> desc->log2_chroma_h);
+
+        linesize[i] = FFALIGN(linesize[i], 32);
+        size[i]     = linesize[i] * plane_h;
+    }
+    if (desc->flags & PIX_FMT_PAL || desc->flags & PIX_FMT_PSEUDOPAL)
+        size[1] = 1024;
+
+    if ((ret = ff_frame_pool_init(link, size)) < 0)
+        return ret;
+
+    pool = link->frame_pool;
+    memcpy(pool->linesize, linesize, sizeof(linesize));
+    pool->format = link->format;
+    pool->width  = w;
+    pool->height = h;
+    return 0;
+}
+
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
     AVFrame *frame = av_frame_alloc();
-    int ret;
+    FFFramePool *pool;
+    int i;
 
     if (!frame)
         return NULL;
@@ -47,11 +90,25 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     frame->height = h;
     frame->format = link->format;
 
-    ret = av_frame_get_buffer(frame, 32);
-    if (ret < 0)
-        av_frame_free(&frame);
+    if (update_frame_pool(link, w, h) < 0)
+        goto fail;
+    pool = link->frame_pool;
+
+    for (i = 0; i < 4 && pool->pools[i]; i++) {
+        frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+        if (!frame->buf[i])
+            goto fail;
+        pool->requests++;
+
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = pool->linesize[i];
+    }
+    frame->extended_data = frame->data;
 
     return frame;
+fail:
+    av_frame_free(&frame);
+    return NULL;
 }
 
 #if FF_API_AVFILTERBUFFER
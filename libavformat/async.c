@@ -0,0 +1,345 @@
+/*
+ * Asynchronous read-ahead protocol
+ *
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Asynchronous read-ahead protocol.
+ *
+ * A background thread reads the nested resource into a ring buffer, so
+ * that stalls of the nested protocol do not block the caller as long as
+ * buffered data is available.
+ *
+ * The byte at stream position pos is stored at buffer[pos % buffer_size].
+ * The buffer holds the stream range [start, end), and the caller reads
+ * from read_pos inside this range. Part of the buffer is left to data
+ * that has already been read, so that short backward seeks are served
+ * from the buffer as well.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "avformat.h"
+#include "url.h"
+
+#define READ_CHUNK_SIZE 4096
+
+typedef struct AsyncContext {
+    const AVClass *class;
+    URLContext *inner;
+    int64_t inner_size;
+
+    int buffer_size;            ///< size of the ring buffer in bytes
+    int back_size;              ///< bytes kept behind the read position
+    uint8_t *buffer;
+
+    int64_t start;              ///< stream position of the oldest buffered byte
+    int64_t end;                ///< stream position after the newest buffered byte
+    int64_t read_pos;           ///< stream position of the next byte to return
+
+    int64_t seek_request;       ///< position requested from the fill thread, or -1
+    int64_t seek_result;        ///< result of the last seek of the nested resource
+    int seek_completed;
+
+    int eof;                    ///< the fill thread reached the end of the resource
+    int error;                  ///< error returned by the nested protocol
+    int abort_request;
+
+    pthread_t thread;
+    int thread_created;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_wakeup_main;
+    pthread_cond_t cond_wakeup_thread;
+} AsyncContext;
+
+/**
+ * Return the number of bytes the fill thread may write at once, or 0
+ * if the buffer is full. Must be called with the mutex held.
+ */
+static int writable_size(AsyncContext *c)
+{
+    int64_t limit = c->read_pos + c->buffer_size -
+                    FFMIN(c->read_pos - c->start, c->back_size);
+    int offset    = c->end % c->buffer_size;
+
+    return FFMIN3(limit - c->end, c->buffer_size - offset, READ_CHUNK_SIZE);
+}
+
+/**
+ * Interrupt callback of the nested protocol, aborting blocking operations
+ * of the fill thread when the context is closed. The interrupt callback of
+ * the caller is not invoked from here, as it is not required to be thread
+ * safe; async_read() checks it in the calling thread instead.
+ */
+static int async_check_interrupt(void *arg)
+{
+    AsyncContext *c = arg;
+    int abort_request;
+
+    pthread_mutex_lock(&c->mutex);
+    abort_request = c->abort_request;
+    pthread_mutex_unlock(&c->mutex);
+
+    return abort_request;
+}
+
+static void *async_fill_thread(void *arg)
+{
+    URLContext *h  = arg;
+    AsyncContext *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        int64_t end;
+        int size, ret;
+
+        if (c->seek_request >= 0) {
+            int64_t pos = c->seek_request;
+
+            c->seek_request = -1;
+            pthread_mutex_unlock(&c->mutex);
+            ret = ffurl_seek(c->inner, pos, SEEK_SET);
+            pthread_mutex_lock(&c->mutex);
+
+            c->seek_result    = ret;
+            c->seek_completed = 1;
+            if (ret >= 0) {
+                c->start = c->end = c->read_pos = ret;
+                c->eof   = 0;
+                c->error = 0;
+            }
+            pthread_cond_signal(&c->cond_wakeup_main);
+            continue;
+        }
+
+        size = writable_size(c);
+        if (c->eof || c->error || size <= 0) {
+            pthread_cond_wait(&c->cond_wakeup_thread, &c->mutex);
+            continue;
+        }
+
+        /* drop the oldest data to make room for the new one; the region
+         * written below is outside [start, end) and is not read by the
+         * calling thread meanwhile */
+        end      = c->end;
+        c->start = FFMAX(c->start, end + size - c->buffer_size);
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = ffurl_read(c->inner, c->buffer + end % c->buffer_size, size);
+
+        pthread_mutex_lock(&c->mutex);
+        if (ret > 0) {
+            c->end += ret;
+        } else if (ret == 0 || ret == AVERROR_EOF) {
+            c->eof = 1;
+        } else if (ret != AVERROR(EAGAIN)) {
+            c->error = ret;
+        }
+        pthread_cond_signal(&c->cond_wakeup_main);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+static int async_open(URLContext *h, const char *arg, int flags)
+{
+    AsyncContext *c = h->priv_data;
+    AVIOInterruptCB int_cb = { async_check_interrupt, c };
+    int ret;
+
+    if (!av_strstart(arg, "async+", &arg) &&
+        !av_strstart(arg, "async:", &arg)) {
+        av_log(h, AV_LOG_ERROR, "Unsupported url %s\n", arg);
+        return AVERROR(EINVAL);
+    }
+
+    if (flags & AVIO_FLAG_WRITE) {
+        av_log(h, AV_LOG_ERROR, "Only reading is supported\n");
+        return AVERROR(ENOSYS);
+    }
+    if (c->buffer_size <= 0 || c->back_size < 0 ||
+        c->back_size >= c->buffer_size) {
+        av_log(h, AV_LOG_ERROR, "Invalid buffer sizes\n");
+        return AVERROR(EINVAL);
+    }
+
+    /* async_check_interrupt() takes the mutex, also while opening */
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond_wakeup_main, NULL);
+    pthread_cond_init(&c->cond_wakeup_thread, NULL);
+
+    /* the fill thread has nothing else to do, let it block in the nested
+     * protocol rather than spin on EAGAIN; async_check_interrupt() still
+     * aborts it on close */
+    ret = ffurl_open(&c->inner, arg, flags & ~AVIO_FLAG_NONBLOCK, &int_cb, NULL);
+    if (ret < 0)
+        goto fail;
+
+    h->is_streamed = c->inner->is_streamed;
+    c->inner_size  = h->is_streamed ? AVERROR(ENOSYS) : ffurl_size(c->inner);
+
+    c->buffer = av_malloc(c->buffer_size);
+    if (!c->buffer) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    c->seek_request = -1;
+
+    ret = pthread_create(&c->thread, NULL, async_fill_thread, h);
+    if (ret) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    c->thread_created = 1;
+
+    return 0;
+
+fail:
+    pthread_cond_destroy(&c->cond_wakeup_thread);
+    pthread_cond_destroy(&c->cond_wakeup_main);
+    pthread_mutex_destroy(&c->mutex);
+    av_freep(&c->buffer);
+    ffurl_close(c->inner);
+    return ret;
+}
+
+static int async_read(URLContext *h, uint8_t *buf, int size)
+{
+    AsyncContext *c = h->priv_data;
+    int ret = 0;
+
+    pthread_mutex_lock(&c->mutex);
+    while (c->read_pos == c->end) {
+        if (c->error) {
+            ret = c->error;
+        } else if (c->eof) {
+            ret = AVERROR_EOF;
+        } else if (h->flags & AVIO_FLAG_NONBLOCK) {
+            ret = AVERROR(EAGAIN);
+        } else if (ff_check_interrupt(&h->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+        }
+        if (ret < 0)
+            break;
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+
+    if (!ret) {
+        int offset = c->read_pos % c->buffer_size;
+
+        size = FFMIN3(size, c->end - c->read_pos, c->buffer_size - offset);
+        memcpy(buf, c->buffer + offset, size);
+        c->read_pos += size;
+        ret = size;
+        pthread_cond_signal(&c->cond_wakeup_thread);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t async_seek(URLContext *h, int64_t pos, int whence)
+{
+    AsyncContext *c = h->priv_data;
+    int64_t ret;
+
+    if (whence == AVSEEK_SIZE)
+        return c->inner_size;
+
+    pthread_mutex_lock(&c->mutex);
+    if (whence == SEEK_CUR)
+        pos += c->read_pos;
+    else if (whence == SEEK_END)
+        pos = c->inner_size >= 0 ? c->inner_size + pos : -1;
+    else if (whence != SEEK_SET)
+        pos = -1;
+
+    if (pos < 0) {
+        ret = AVERROR(EINVAL);
+    } else if (pos >= c->start && pos <= c->end) {
+        /* inside the buffered window */
+        c->read_pos = pos;
+        ret         = pos;
+        pthread_cond_signal(&c->cond_wakeup_thread);
+    } else if (h->is_streamed) {
+        ret = AVERROR(ENOSYS);
+    } else {
+        c->seek_request   = pos;
+        c->seek_completed = 0;
+        pthread_cond_signal(&c->cond_wakeup_thread);
+        while (!c->seek_completed)
+            pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+        ret = c->seek_result;
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int async_close(URLContext *h)
+{
+    AsyncContext *c = h->priv_data;
+
+    if (c->thread_created) {
+        pthread_mutex_lock(&c->mutex);
+        c->abort_request = 1;
+        pthread_cond_signal(&c->cond_wakeup_thread);
+        pthread_mutex_unlock(&c->mutex);
+        pthread_join(c->thread, NULL);
+
+        pthread_cond_destroy(&c->cond_wakeup_thread);
+        pthread_cond_destroy(&c->cond_wakeup_main);
+        pthread_mutex_destroy(&c->mutex);
+    }
+    av_freep(&c->buffer);
+    ffurl_close(c->inner);
+
+    return 0;
+}
+
+#define OFFSET(x) offsetof(AsyncContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+static const AVOption options[] = {
+    { "async_buffer_size", "Size of the read-ahead buffer in bytes", OFFSET(buffer_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, 1, INT_MAX, D },
+    { "async_back_size", "Bytes kept behind the read position for backward seeks", OFFSET(back_size), AV_OPT_TYPE_INT, { .i64 = 256 << 10 }, 0, INT_MAX, D },
+    { NULL }
+};
+
+static const AVClass async_context_class = {
+    .class_name = "async",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+URLProtocol ff_async_protocol = {
+    .name            = "async",
+    .url_open        = async_open,
+    .url_read        = async_read,
+    .url_seek        = async_seek,
+    .url_close       = async_close,
+    .priv_data_size  = sizeof(AsyncContext),
+    .priv_data_class = &async_context_class,
+    .flags           = URL_PROTOCOL_FLAG_NESTED_SCHEME,
+};
@@ -887,6 +887,7 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_NOBUFFER     0x0040 ///< Do not buffer frames when possible
 #define AVFMT_FLAG_CUSTOM_IO    0x0080 ///< The caller has supplied a custom AVIOContext, don't avio_close() it.
 #define AVFMT_FLAG_DISCARD_CORRUPT  0x0100 ///< Discard frames marked corrupted
+#define AVFMT_FLAG_ZEROCOPY     0x0200 ///< Let packets reference the I/O buffer instead of copying the data, when the demuxer supports it
 
     /**
      * decoding: size of data to probe; encoding: unused.
@@ -1021,6 +1022,12 @@ typedef struct AVFormatContext {
      */
 #define RAW_PACKET_BUFFER_SIZE 2500000
     int raw_packet_buffer_remaining_size;
+
+    /**
+     * Packets waiting to be interleaved when muxing with the default
+     * interleaving.
+     */
+    struct FFInterleaveQueue *interleave_queue;
 } AVFormatContext;
 
 typedef struct AVPacketList {
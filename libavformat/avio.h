@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
@@ -115,6 +116,23 @@ typedef struct AVIOContext {
      * A combination of AVIO_SEEKABLE_ flags or 0 when the stream is not seekable.
      */
     int seekable;
+
+    /**
+     * Reference to the I/O buffer when packets may reference it in place,
+     * NULL otherwise.
+     * This field is internal to libavformat and access from outside is not
+     * allowed.
+     */
+    AVBufferRef *buffer_ref;
+
+    /**
+     * Reference size bytes at position pos without reading them into the
+     * buffer, see URLProtocol.url_read_ref.
+     * This field is internal to libavformat and access from outside is not
+     * allowed.
+     */
+    int (*read_ref)(void *opaque, int64_t pos, int size,
+                    AVBufferRef **buf, uint8_t **data);
 } AVIOContext;
 
 /* unbuffered I/O */
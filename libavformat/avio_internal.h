@@ -47,6 +47,27 @@ int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size);
 
 void ffio_fill(AVIOContext *s, int b, int count);
 
+/**
+ * Make the I/O buffer refcounted, so that ffio_read_ref() can return
+ * references to it. Once a reference is held, the buffer is not written
+ * anymore and reading continues in a new buffer.
+ */
+int ffio_enable_buffer_ref(AVIOContext *s);
+
+/**
+ * Read size bytes from AVIOContext by referencing them inside the I/O
+ * buffer, or inside the protocol's own memory if it supports
+ * url_read_ref, instead of copying them.
+ * The data is followed by FF_INPUT_BUFFER_PADDING_SIZE readable bytes,
+ * which are not necessarily zero.
+ *
+ * @param buf  set to a new reference to the memory holding the data
+ * @param data set to the start of the data on success
+ * @return size on success, 0 if the data cannot be referenced and must be
+ *         read with avio_read() instead, a negative AVERROR code on failure
+ */
+int ffio_read_ref(AVIOContext *s, int size, AVBufferRef **buf, uint8_t **data);
+
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
 {
     avio_wl32(pb, MKTAG(s[0], s[1], s[2], s[3]));
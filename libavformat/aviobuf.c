@@ -364,10 +364,15 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = !s->max_packet_size &&
                           s->buf_end - s->buffer < s->buffer_size ?
                           s->buf_end : s->buffer;
-    int len             = s->buffer_size - (dst - s->buffer);
+    int len;
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
 
+    /* never write behind data that packets still reference */
+    if (s->buffer_ref && !av_buffer_is_writable(s->buffer_ref))
+        dst = s->buffer;
+    len = s->buffer_size - (dst - s->buffer);
+
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
         s->eof_reached = 1;
@@ -391,6 +396,17 @@ static void fill_buffer(AVIOContext *s)
         len = s->buffer_size;
     }
 
+    /* packets still reference the buffer, continue in a new one */
+    if (s->buffer_ref && !av_buffer_is_writable(s->buffer_ref)) {
+        if (ffio_set_buf_size(s, s->buffer_size) < 0) {
+            s->eof_reached = 1;
+            s->error       = AVERROR(ENOMEM);
+            return;
+        }
+        s->checksum_ptr = dst = s->buffer;
+        len = s->buffer_size;
+    }
+
     if (s->read_packet)
         len = s->read_packet(s->opaque, dst, len);
     else
@@ -684,19 +700,91 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     if(h->prot) {
         (*s)->read_pause = (int (*)(void *, int))h->prot->url_read_pause;
         (*s)->read_seek  = (int64_t (*)(void *, int, int64_t, int))h->prot->url_read_seek;
+        (*s)->read_ref   = (int (*)(void *, int64_t, int, AVBufferRef **, uint8_t **))h->prot->url_read_ref;
     }
     (*s)->av_class = &ffio_url_class;
     return 0;
 }
 
+int ffio_enable_buffer_ref(AVIOContext *s)
+{
+    if (s->buffer_ref)
+        return 0;
+    if (s->write_flag)
+        return AVERROR(EINVAL);
+
+    s->buffer_ref = av_buffer_create(s->buffer, s->buffer_size,
+                                     av_buffer_default_free, NULL, 0);
+    if (!s->buffer_ref)
+        return AVERROR(ENOMEM);
+    /* the unused part of the buffer may end up as packet padding */
+    memset(s->buf_end, 0, s->buffer + s->buffer_size - s->buf_end);
+    return 0;
+}
+
+int ffio_read_ref(AVIOContext *s, int size, AVBufferRef **buf, uint8_t **data)
+{
+    uint8_t *ptr = s->buf_ptr;
+    int len      = s->buf_end - s->buf_ptr;
+    int64_t pos, ret;
+
+    if (size <= 0)
+        return 0;
+
+    /* append to the buffer if the packet can still fit into it; fill_buffer
+     * then writes behind buf_end and keeps the unread data */
+    while (len < size && !s->max_packet_size && !s->eof_reached &&
+           !s->read_ref &&
+           s->buffer_size <= IO_BUFFER_SIZE &&
+           av_buffer_is_writable(s->buffer_ref) &&
+           ptr + size + FF_INPUT_BUFFER_PADDING_SIZE <=
+           s->buffer + s->buffer_size) {
+        fill_buffer(s);
+        s->buf_ptr = ptr;
+        len        = s->buf_end - s->buf_ptr;
+    }
+
+    if (len >= size &&
+        ptr + size + FF_INPUT_BUFFER_PADDING_SIZE <=
+        s->buffer + s->buffer_size) {
+        if (!(*buf = av_buffer_ref(s->buffer_ref)))
+            return AVERROR(ENOMEM);
+        *data       = ptr;
+        s->buf_ptr += size;
+        return size;
+    }
+
+    /* let the protocol reference the data and skip it in the buffer */
+    if (!s->read_ref || s->update_checksum)
+        return 0;
+    pos = avio_tell(s);
+    ret = s->read_ref(s->opaque, pos, size, buf, data);
+    if (ret <= 0)
+        return ret;
+    if ((ret = avio_seek(s, pos + size, SEEK_SET)) < 0) {
+        av_buffer_unref(buf);
+        return ret;
+    }
+    return size;
+}
+
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
     uint8_t *buffer;
-    buffer = av_malloc(buf_size);
-    if (!buffer)
-        return AVERROR(ENOMEM);
 
-    av_free(s->buffer);
+    if (s->buffer_ref) {
+        AVBufferRef *ref = av_buffer_allocz(buf_size);
+        if (!ref)
+            return AVERROR(ENOMEM);
+        av_buffer_unref(&s->buffer_ref);
+        s->buffer_ref = ref;
+        buffer        = ref->data;
+    } else {
+        buffer = av_malloc(buf_size);
+        if (!buffer)
+            return AVERROR(ENOMEM);
+        av_free(s->buffer);
+    }
     s->buffer = buffer;
     s->buffer_size = buf_size;
     s->buf_ptr = buffer;
@@ -746,7 +834,18 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char *buf, int buf_size
         buf_size = new_size;
     }
 
-    av_free(s->buffer);
+    if (s->buffer_ref) {
+        AVBufferRef *ref = av_buffer_create(buf, alloc_size,
+                                            av_buffer_default_free, NULL, 0);
+        if (!ref) {
+            av_free(buf);
+            return AVERROR(ENOMEM);
+        }
+        memset(buf + buf_size, 0, alloc_size - buf_size);
+        av_buffer_unref(&s->buffer_ref);
+        s->buffer_ref = ref;
+    } else
+        av_free(s->buffer);
     s->buf_ptr = s->buffer = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
@@ -788,7 +887,10 @@ int avio_close(AVIOContext *s)
 
     avio_flush(s);
     h = s->opaque;
-    av_freep(&s->buffer);
+    if (s->buffer_ref)
+        av_buffer_unref(&s->buffer_ref);
+    else
+        av_free(s->buffer);
     av_free(s);
     return ffurl_close(h);
 }
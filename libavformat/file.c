@@ -31,6 +31,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -156,6 +159,229 @@ URLProtocol ff_file_protocol = {
 
 #endif /* CONFIG_FILE_PROTOCOL */
 
+#if CONFIG_MMAP_PROTOCOL
+
+/* memory-mapped file protocol */
+
+typedef struct MmapContext {
+    const AVClass *class;
+    int fd;
+    int64_t size;           ///< size of the file
+    int64_t pos;            ///< read position
+    int64_t page_size;
+    int window_size;        ///< minimum size of the mapped windows
+    int advice;             ///< posix_madvise() advice given for new windows
+    AVBufferRef *window;    ///< currently mapped part of the file
+    int64_t window_pos;     ///< file position of the start of the window
+} MmapContext;
+
+#define OFFSET(x) offsetof(MmapContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+static const AVOption mmap_options[] = {
+    { "mmap_window_size", "Size of the parts of the file mapped at once", OFFSET(window_size), AV_OPT_TYPE_INT, { .i64 = 64 << 20 }, 1 << 16, INT_MAX / 2, D },
+#if HAVE_POSIX_MADVISE
+    { "mmap_advice", "Access pattern advice for the mapped file", OFFSET(advice), AV_OPT_TYPE_INT, { .i64 = POSIX_MADV_NORMAL }, INT_MIN, INT_MAX, D, "advice" },
+    { "normal",     "No special treatment",                 0, AV_OPT_TYPE_CONST, { .i64 = POSIX_MADV_NORMAL },     0, 0, D, "advice" },
+    { "sequential", "Read ahead aggressively",              0, AV_OPT_TYPE_CONST, { .i64 = POSIX_MADV_SEQUENTIAL }, 0, 0, D, "advice" },
+    { "random",     "Do not read ahead",                    0, AV_OPT_TYPE_CONST, { .i64 = POSIX_MADV_RANDOM },     0, 0, D, "advice" },
+    { "willneed",   "Start reading the whole window ahead", 0, AV_OPT_TYPE_CONST, { .i64 = POSIX_MADV_WILLNEED },   0, 0, D, "advice" },
+#endif
+    { NULL }
+};
+
+static const AVClass mmap_class = {
+    .class_name = "mmap",
+    .item_name  = av_default_item_name,
+    .option     = mmap_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+static void mmap_unmap_window(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(intptr_t)opaque);
+}
+
+static int mmap_update_size(MmapContext *c)
+{
+    struct stat st;
+
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(errno);
+    c->size = st.st_size;
+    return 0;
+}
+
+/**
+ * Map a new window of at least min_size bytes from the page containing pos.
+ * The previous window stays mapped as long as packets reference it.
+ */
+static int mmap_map_window(MmapContext *c, int64_t pos, int64_t min_size)
+{
+    int64_t start = pos - pos % c->page_size;
+    int64_t size  = FFMIN(FFMAX(c->window_size, min_size), c->size - start);
+    AVBufferRef *window;
+    void *data;
+
+    if (size <= 0 || size > INT_MAX)
+        return AVERROR(EINVAL);
+
+    data = mmap(NULL, size, PROT_READ, MAP_SHARED, c->fd, start);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+#if HAVE_POSIX_MADVISE
+    if (c->advice != POSIX_MADV_NORMAL)
+        posix_madvise(data, size, c->advice);
+#endif
+
+    window = av_buffer_create(data, size, mmap_unmap_window,
+                              (void *)(intptr_t)size, AV_BUFFER_FLAG_READONLY);
+    if (!window) {
+        munmap(data, size);
+        return AVERROR(ENOMEM);
+    }
+    av_buffer_unref(&c->window);
+    c->window     = window;
+    c->window_pos = start;
+    return 0;
+}
+
+static int mmap_open(URLContext *h, const char *filename, int flags)
+{
+    MmapContext *c = h->priv_data;
+    int access = O_RDONLY;
+    int ret;
+
+    av_strstart(filename, "mmap:", &filename);
+
+    if (flags & AVIO_FLAG_WRITE) {
+        av_log(h, AV_LOG_ERROR, "Only reading is supported\n");
+        return AVERROR(ENOSYS);
+    }
+#ifdef O_BINARY
+    access |= O_BINARY;
+#endif
+    c->fd = open(filename, access);
+    if (c->fd == -1)
+        return AVERROR(errno);
+    if ((ret = mmap_update_size(c)) < 0) {
+        close(c->fd);
+        return ret;
+    }
+#if HAVE_SYSCONF && defined(_SC_PAGESIZE)
+    c->page_size = sysconf(_SC_PAGESIZE);
+#endif
+    if (c->page_size <= 0)
+        c->page_size = 4096;
+    return 0;
+}
+
+static int mmap_read(URLContext *h, unsigned char *buf, int size)
+{
+    MmapContext *c = h->priv_data;
+    int64_t offset;
+    int ret;
+
+    /* the file may have grown since it was opened */
+    if (c->pos >= c->size && (ret = mmap_update_size(c)) < 0)
+        return ret;
+    if (c->pos >= c->size)
+        return 0;
+
+    if (!c->window || c->pos < c->window_pos ||
+        c->pos >= c->window_pos + c->window->size)
+        if ((ret = mmap_map_window(c, c->pos, 0)) < 0)
+            return ret;
+
+    offset = c->pos - c->window_pos;
+    size   = FFMIN(size, c->window->size - offset);
+    memcpy(buf, c->window->data + offset, size);
+    c->pos += size;
+    return size;
+}
+
+static int mmap_read_ref(URLContext *h, int64_t pos, int size,
+                         AVBufferRef **buf, uint8_t **data)
+{
+    MmapContext *c = h->priv_data;
+    int64_t end    = pos + size + FF_INPUT_BUFFER_PADDING_SIZE;
+    int ret;
+
+    /* the padding must be mapped as well */
+    if (pos < 0 || end > c->size)
+        return 0;
+
+    if (!c->window || pos < c->window_pos ||
+        end > c->window_pos + c->window->size) {
+        if (end - (pos - pos % c->page_size) > INT_MAX)
+            return 0;
+        if ((ret = mmap_map_window(c, pos, end - (pos - pos % c->page_size))) < 0)
+            return ret;
+    }
+
+    if (!(*buf = av_buffer_ref(c->window)))
+        return AVERROR(ENOMEM);
+    *data = c->window->data + pos - c->window_pos;
+    return size;
+}
+
+static int64_t mmap_seek(URLContext *h, int64_t pos, int whence)
+{
+    MmapContext *c = h->priv_data;
+    int ret;
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END)
+        if ((ret = mmap_update_size(c)) < 0)
+            return ret;
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return c->size;
+    case SEEK_CUR:
+        pos += c->pos;
+        break;
+    case SEEK_END:
+        pos += c->size;
+        break;
+    case SEEK_SET:
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    c->pos = pos;
+    return pos;
+}
+
+static int mmap_get_handle(URLContext *h)
+{
+    MmapContext *c = h->priv_data;
+    return c->fd;
+}
+
+static int mmap_close(URLContext *h)
+{
+    MmapContext *c = h->priv_data;
+
+    av_buffer_unref(&c->window);
+    return close(c->fd);
+}
+
+URLProtocol ff_mmap_protocol = {
+    .name                = "mmap",
+    .url_open            = mmap_open,
+    .url_read            = mmap_read,
+    .url_seek            = mmap_seek,
+    .url_close           = mmap_close,
+    .url_get_file_handle = mmap_get_handle,
+    .url_read_ref        = mmap_read_ref,
+    .priv_data_size      = sizeof(MmapContext),
+    .priv_data_class     = &mmap_class,
+};
+
+#endif /* CONFIG_MMAP_PROTOCOL */
+
 #if CONFIG_PIPE_PROTOCOL
 
 static int pipe_open(URLContext *h, const char *filename, int flags)
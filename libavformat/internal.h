@@ -174,6 +174,15 @@ void ff_put_v(AVIOContext *bc, uint64_t val);
  */
 int ff_get_line(AVIOContext *s, char *buf, int maxlen);
 
+/**
+ * Like av_get_packet(), but let the packet reference the data inside the
+ * I/O buffer instead of copying it, if the AVIOContext supports it, the
+ * data is buffered entirely and the decoders of the stream do not depend
+ * on zeroed packet padding.
+ * The packet data must not be modified.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVStream *st, AVPacket *pkt, int size);
+
 #define SPACE_CHARS " \t\r\n"
 
 /**
@@ -348,6 +357,12 @@ int ff_read_packet(AVFormatContext *s, AVPacket *pkt);
 int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
                                  AVPacket *pkt, int flush);
 
+/**
+ * Free the packets left in the queue of the default interleaving, used by
+ * muxers without their own interleave_packet callback.
+ */
+void ff_interleave_queue_free(AVFormatContext *s);
+
 /**
  * Return the frame duration in seconds. Return 0 if not available.
  */
@@ -135,9 +135,29 @@ typedef struct MOVStreamContext {
     int64_t track_end;    ///< used for dts generation in fragmented movie files
     unsigned int rap_group_count;
     MOVSbgp *rap_group;
+
+    /**
+     * @name Compact index
+     * When set, the sample tables are kept instead of being expanded into
+     * st->index_entries, and index entries are computed on demand.
+     * @{
+     */
+    int compact_index;
+    int nb_samples;                   ///< number of samples in the compact index
+    unsigned int *stsc_first_sample;  ///< first sample of each stsc entry
+    unsigned int nb_stts;             ///< number of stts entries in use
+    unsigned int *stts_first_sample;  ///< first sample of each stts entry
+    int64_t *stts_first_dts;          ///< dts of the first sample of each stts entry
+    int key_off;                      ///< 1 if stss/stps sample numbers are 1-based
+    int cursor_sample;                ///< last computed sample, -1 if none
+    unsigned int cursor_stsc_index;   ///< stsc entry of cursor_sample
+    unsigned int cursor_chunk_sample; ///< index of cursor_sample within its chunk
+    AVIndexEntry cursor;              ///< index entry of cursor_sample
+    /** @} */
 } MOVStreamContext;
 
 typedef struct MOVContext {
+    const AVClass *class;
     AVFormatContext *fc;
     int time_scale;
     int64_t duration;     ///< duration of the longest track
@@ -152,6 +172,7 @@ typedef struct MOVContext {
     int itunes_metadata;  ///< metadata are itunes style
     int chapter_track;
     int64_t next_root_atom; ///< offset of the next root atom
+    int compact_index;    ///< look samples up in the sample tables instead of building an index
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -260,6 +260,10 @@ typedef struct {
 
     /* File has SSA subtitles which prevent incremental cluster parsing. */
     int contains_ssa;
+
+    /* Clusters skimmed for seeking, see matroska_skim_clusters(). */
+    int64_t skim_pos;
+    int skim_done;
 } MatroskaDemuxContext;
 
 typedef struct {
@@ -2210,6 +2214,190 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
+/*
+ * Read the ID and the length of the next element.
+ * 0 is success, < 0 is failure.
+ */
+static int matroska_skim_element(MatroskaDemuxContext *matroska,
+                                 uint32_t *id, uint64_t *length)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    uint64_t num;
+    int res;
+
+    if ((res = ebml_read_num(matroska, pb, 4, &num)) < 0)
+        return res;
+    *id = num | 1 << 7*res;
+    if ((res = ebml_read_length(matroska, pb, length)) < 0)
+        return res;
+    return 0;
+}
+
+static int matroska_is_level1_id(uint32_t id)
+{
+    return id == MATROSKA_ID_CLUSTER  || id == MATROSKA_ID_CUES     ||
+           id == MATROSKA_ID_TAGS     || id == MATROSKA_ID_SEEKHEAD ||
+           id == MATROSKA_ID_INFO     || id == MATROSKA_ID_TRACKS   ||
+           id == MATROSKA_ID_CHAPTERS || id == MATROSKA_ID_ATTACHMENTS;
+}
+
+/*
+ * Read the header of the Block or SimpleBlock element of the given length
+ * starting at the current position.
+ * Returns: the track of the block, NULL if it cannot be indexed.
+ */
+static MatroskaTrack *matroska_skim_block(MatroskaDemuxContext *matroska,
+                                          uint64_t length, int16_t *block_time,
+                                          int *flags)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaTrack *track;
+    uint64_t num;
+    int n;
+
+    if ((n = ebml_read_num(matroska, pb, 8, &num)) < 0 || length < n + 3)
+        return NULL;
+    *block_time = avio_rb16(pb);
+    *flags      = avio_r8(pb);
+
+    track = matroska_find_track_by_num(matroska, num);
+    /* same as matroska_parse_block(), except that subtitles are not indexed,
+     * since overlapping ones depend on the previous blocks */
+    if (!track || !track->stream ||
+        track->stream->discard >= AVDISCARD_ALL ||
+        track->type == MATROSKA_TRACK_TYPE_SUBTITLE)
+        return NULL;
+    return track;
+}
+
+static void matroska_skim_add_index(MatroskaTrack *track, int64_t cluster_pos,
+                                    uint64_t cluster_time, int16_t block_time)
+{
+    if (cluster_time != (uint64_t)-1 &&
+        (block_time >= 0 || cluster_time >= -block_time))
+        av_add_index_entry(track->stream, cluster_pos, cluster_time + block_time,
+                           0, 0, AVINDEX_KEYFRAME);
+}
+
+/*
+ * Skim the level 1 element starting at the current position. For a
+ * cluster, only the element headers, the cluster timecode and the block
+ * headers are read, and the keyframes are added to the index of their
+ * stream, the way matroska_parse_block() would.
+ * Returns: 0 on success, 1 if the element cannot be skipped, < 0 on error.
+ */
+static int matroska_skim_cluster(MatroskaDemuxContext *matroska)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t cluster_pos = avio_tell(pb), cluster_end, pos, end;
+    uint64_t length, cluster_time = (uint64_t)-1;
+    uint32_t id;
+    int res;
+
+    if ((res = matroska_skim_element(matroska, &id, &length)) < 0)
+        return res;
+    if (length == 0xffffffffffffffULL) {
+        /* an unknown size cluster ends at the next level 1 element */
+        if (id != MATROSKA_ID_CLUSTER)
+            return 1;
+        cluster_end = INT64_MAX;
+    } else {
+        cluster_end = avio_tell(pb) + length;
+        if (id != MATROSKA_ID_CLUSTER)
+            return avio_seek(pb, cluster_end, SEEK_SET) < 0 ? AVERROR(EIO) : 0;
+    }
+
+    while ((pos = avio_tell(pb)) < cluster_end) {
+        MatroskaTrack *track;
+        int16_t block_time;
+        int flags;
+
+        if ((res = matroska_skim_element(matroska, &id, &length)) < 0) {
+            /* the last cluster of a truncated file */
+            return res == AVERROR_EOF ? 0 : res;
+        }
+        if (cluster_end == INT64_MAX && matroska_is_level1_id(id)) {
+            avio_seek(pb, pos, SEEK_SET);
+            break;
+        }
+        if (length == 0xffffffffffffffULL)
+            return AVERROR_INVALIDDATA;
+        end = avio_tell(pb) + length;
+
+        switch (id) {
+        case MATROSKA_ID_CLUSTERTIMECODE:
+            if ((res = ebml_read_uint(pb, length, &cluster_time)) < 0)
+                return res;
+            break;
+        case MATROSKA_ID_SIMPLEBLOCK:
+            track = matroska_skim_block(matroska, length, &block_time, &flags);
+            if (track && flags & 0x80)
+                matroska_skim_add_index(track, cluster_pos, cluster_time,
+                                        block_time);
+            break;
+        case MATROSKA_ID_BLOCKGROUP: {
+            int reference = 0;
+
+            track = NULL;
+            while (avio_tell(pb) < end) {
+                int64_t child_end;
+
+                if ((res = matroska_skim_element(matroska, &id, &length)) < 0)
+                    return res;
+                if (length == 0xffffffffffffffULL)
+                    return AVERROR_INVALIDDATA;
+                child_end = avio_tell(pb) + length;
+                if (id == MATROSKA_ID_BLOCK)
+                    track = matroska_skim_block(matroska, length,
+                                                &block_time, &flags);
+                else if (id == MATROSKA_ID_BLOCKREFERENCE)
+                    reference = 1;
+                if (avio_seek(pb, child_end, SEEK_SET) < 0)
+                    return AVERROR(EIO);
+            }
+            if (track && !reference)
+                matroska_skim_add_index(track, cluster_pos, cluster_time,
+                                        block_time);
+            break;
+        }
+        }
+        if (avio_seek(pb, end, SEEK_SET) < 0)
+            return AVERROR(EIO);
+    }
+    return 0;
+}
+
+/*
+ * Skim the clusters after the index of st until a keyframe at or after
+ * timestamp is indexed, without parsing the blocks. The skimmed range is
+ * remembered, so that the following seeks only skim the clusters after it.
+ */
+static void matroska_skim_clusters(MatroskaDemuxContext *matroska,
+                                   AVStream *st, int64_t timestamp)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t pos = st->index_entries[st->nb_index_entries - 1].pos;
+    int res = 0;
+
+    if (!pb->seekable)
+        return;
+    if (pos <= matroska->skim_pos) {
+        if (matroska->skim_done)
+            return;
+        pos = matroska->skim_pos;
+    }
+    if (avio_seek(pb, pos, SEEK_SET) < 0)
+        return;
+
+    while (st->index_entries[st->nb_index_entries - 1].timestamp < timestamp) {
+        if ((res = matroska_skim_cluster(matroska)))
+            break;
+        matroska->skim_pos = avio_tell(pb);
+    }
+    if (res)
+        matroska->skim_done = 1;
+}
+
 static int matroska_read_seek(AVFormatContext *s, int stream_index,
                               int64_t timestamp, int flags)
 {
@@ -2228,6 +2416,9 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         return 0;
     timestamp = FFMAX(timestamp, st->index_entries[0].timestamp);
 
+    if (timestamp > st->index_entries[st->nb_index_entries-1].timestamp)
+        matroska_skim_clusters(matroska, st, timestamp);
+
     if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0) {
         avio_seek(s->pb, st->index_entries[st->nb_index_entries-1].pos, SEEK_SET);
         matroska->current_id = 0;
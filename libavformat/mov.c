@@ -35,6 +35,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/avstring.h"
 #include "libavutil/dict.h"
+#include "libavutil/opt.h"
 #include "libavcodec/ac3tab.h"
 #include "avformat.h"
 #include "internal.h"
@@ -1759,6 +1760,323 @@ static int mov_read_sbgp(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return pb->eof_reached ? AVERROR_EOF : 0;
 }
 
+/**
+ * Return the first chunk (counted from 0) described by stsc entry i.
+ */
+static unsigned mov_stsc_first_chunk(MOVStreamContext *sc, unsigned i)
+{
+    if (!i)
+        return 0;
+    if (i >= sc->stsc_count)
+        return sc->chunk_count;
+    return FFMIN((unsigned)sc->stsc_data[i].first - 1, sc->chunk_count);
+}
+
+/**
+ * Return the index of the last entry of the sorted table first that is
+ * not larger than n; first[0] must be 0.
+ */
+static unsigned mov_find_entry(const unsigned *first, unsigned count, unsigned n)
+{
+    unsigned a = 0, b = count;
+
+    while (b - a > 1) {
+        unsigned m = (a + b) >> 1;
+        if (first[m] <= n)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+/**
+ * Return the number of entries of the strictly increasing table tab
+ * which are not larger than val.
+ */
+static unsigned mov_count_le(const unsigned *tab, unsigned count, uint64_t val)
+{
+    unsigned a = 0, b = count;
+
+    while (a < b) {
+        unsigned m = (a + b) >> 1;
+        if (tab[m] <= val)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static unsigned mov_sample_size(MOVStreamContext *sc, unsigned n)
+{
+    return sc->sample_size > 0 ? sc->sample_size : sc->sample_sizes[n];
+}
+
+static int64_t mov_sample_dts(MOVStreamContext *sc, unsigned n)
+{
+    unsigned i = mov_find_entry(sc->stts_first_sample, sc->nb_stts, n);
+
+    return sc->stts_first_dts[i] +
+           (int64_t)(n - sc->stts_first_sample[i]) * sc->stts_data[i].duration;
+}
+
+/**
+ * Return 1 + the number of the last sync sample not after sample n, with
+ * samples numbered like in the stss/stps entries, or 0 if there is none.
+ * The stss entries have been checked to be positive in
+ * mov_build_compact_index(), so they can be searched as unsigned.
+ */
+static uint64_t mov_last_sync_sample(MOVStreamContext *sc, unsigned n)
+{
+    uint64_t val = (uint64_t)n + sc->key_off, last = 0;
+    unsigned k;
+
+    if (!sc->keyframe_absent) {
+        if (!sc->keyframe_count)
+            return val + 1;
+        k = mov_count_le((const unsigned *)sc->keyframes, sc->keyframe_count, val);
+        if (k)
+            last = sc->keyframes[k - 1] + 1ULL;
+    }
+    if (sc->stps_count) {
+        k = mov_count_le(sc->stps_data, sc->stps_count, val);
+        if (k)
+            last = FFMAX(last, sc->stps_data[k - 1] + 1ULL);
+    }
+    return last;
+}
+
+static int mov_sample_is_keyframe(MOVStreamContext *sc, unsigned n)
+{
+    return mov_last_sync_sample(sc, n) == (uint64_t)n + sc->key_off + 1;
+}
+
+/**
+ * Return the index entry of sample n of st, or NULL if there is no such
+ * sample. For streams using the compact index, the entry is computed from
+ * the sample tables and stays valid until the next call for the stream.
+ */
+static const AVIndexEntry *mov_get_sample(AVStream *st, int n)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry *e = &sc->cursor;
+    uint64_t last_sync;
+    unsigned i;
+
+    if (!sc->compact_index)
+        return n >= 0 && n < st->nb_index_entries ? &st->index_entries[n] : NULL;
+    if (n < 0 || n >= sc->nb_samples)
+        return NULL;
+    if (n == sc->cursor_sample)
+        return e;
+
+    if (sc->cursor_sample >= 0 && n == sc->cursor_sample + 1 &&
+        sc->cursor_chunk_sample + 1 < sc->stsc_data[sc->cursor_stsc_index].count) {
+        /* next sample of the same chunk */
+        e->pos += e->size;
+        sc->cursor_chunk_sample++;
+    } else {
+        unsigned k      = mov_find_entry(sc->stsc_first_sample, sc->stsc_count, n);
+        unsigned offset = n - sc->stsc_first_sample[k];
+        unsigned count  = sc->stsc_data[k].count;
+        unsigned chunk  = mov_stsc_first_chunk(sc, k) + offset / count;
+
+        sc->cursor_stsc_index   = k;
+        sc->cursor_chunk_sample = offset % count;
+        e->pos = sc->chunk_offsets[chunk];
+        for (i = n - sc->cursor_chunk_sample; i < n; i++)
+            e->pos += mov_sample_size(sc, i);
+    }
+
+    last_sync       = mov_last_sync_sample(sc, n);
+    e->timestamp    = mov_sample_dts(sc, n);
+    e->size         = mov_sample_size(sc, n);
+    e->flags        = last_sync == (uint64_t)n + sc->key_off + 1 ? AVINDEX_KEYFRAME : 0;
+    e->min_distance = last_sync ? (uint64_t)n + sc->key_off + 1 - last_sync : n;
+    sc->cursor_sample = n;
+
+    return e;
+}
+
+static int mov_nb_samples(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    return sc->compact_index ? sc->nb_samples : st->nb_index_entries;
+}
+
+/**
+ * Same as av_index_search_timestamp(), for streams using the compact
+ * index as well.
+ */
+static int mov_index_search_timestamp(AVStream *st, int64_t wanted_timestamp,
+                                      int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int a, b, m;
+    int64_t timestamp;
+
+    if (!sc->compact_index)
+        return av_index_search_timestamp(st, wanted_timestamp, flags);
+
+    a = -1;
+    b = sc->nb_samples;
+    if (b && mov_sample_dts(sc, b - 1) < wanted_timestamp)
+        a = b - 1;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        timestamp = mov_sample_dts(sc, m);
+        if (timestamp >= wanted_timestamp)
+            b = m;
+        if (timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY)) {
+        while (m >= 0 && m < sc->nb_samples && !mov_sample_is_keyframe(sc, m))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+    }
+
+    if (m == sc->nb_samples)
+        return -1;
+    return m;
+}
+
+static void mov_free_sample_tables(MOVStreamContext *sc)
+{
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->stsc_data);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->rap_group);
+    av_freep(&sc->stsc_first_sample);
+    av_freep(&sc->stts_first_sample);
+    av_freep(&sc->stts_first_dts);
+    sc->compact_index = 0;
+}
+
+/**
+ * Set up the compact index of st, which gives the same entries as the
+ * index built by mov_build_index() without storing one entry per sample.
+ * @return 1 if the compact index is used, 0 if the stream needs a full
+ *         index, a negative AVERROR code on failure
+ */
+static int mov_build_compact_index(MOVContext *mov, AVStream *st,
+                                   int64_t current_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    uint64_t chunk_samples = 0, total = 0, stream_size = 0;
+    unsigned int i, j;
+
+    if (sc->pseudo_stream_id != -1 || (sc->rap_group_count && sc->rap_group) ||
+        st->nb_index_entries || !sc->stsc_count || !sc->stts_count)
+        return 0;
+
+    /* mov_build_index() walks the tables in order, the lookups below
+     * only give the same result for well-formed tables */
+    for (i = 0; i < sc->stsc_count; i++)
+        if (sc->stsc_data[i].count < 0 ||
+            (i && sc->stsc_data[i].first < 1) ||
+            (i > 1 && sc->stsc_data[i].first < sc->stsc_data[i - 1].first))
+            return 0;
+    sc->key_off = (sc->keyframes && sc->keyframes[0] > 0) ||
+                  (sc->stps_data && sc->stps_data[0] > 0);
+    if (!sc->keyframe_absent) {
+        for (i = 0; i < sc->keyframe_count; i++)
+            if (sc->keyframes[i] < (i ? (int64_t)sc->keyframes[i - 1] + 1 : sc->key_off))
+                return 0;
+    }
+    for (i = 0; i < sc->stps_count; i++)
+        if (sc->stps_data[i] < (i ? (uint64_t)sc->stps_data[i - 1] + 1 : sc->key_off))
+            return 0;
+    if (!sc->keyframe_absent && sc->keyframe_count) {
+        /* partial sync samples which are also sync samples are never
+         * matched in stps by mov_build_index() */
+        for (i = j = 0; i < sc->stps_count; i++) {
+            while (j < sc->keyframe_count && (unsigned)sc->keyframes[j] < sc->stps_data[i])
+                j++;
+            if (j < sc->keyframe_count && (unsigned)sc->keyframes[j] == sc->stps_data[i])
+                return 0;
+        }
+    }
+
+    sc->stsc_first_sample = av_malloc(sc->stsc_count * sizeof(*sc->stsc_first_sample));
+    sc->stts_first_sample = av_malloc(sc->stts_count * sizeof(*sc->stts_first_sample));
+    sc->stts_first_dts    = av_malloc(sc->stts_count * sizeof(*sc->stts_first_dts));
+    if (!sc->stsc_first_sample || !sc->stts_first_sample || !sc->stts_first_dts) {
+        av_freep(&sc->stsc_first_sample);
+        av_freep(&sc->stts_first_sample);
+        av_freep(&sc->stts_first_dts);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < sc->stsc_count; i++) {
+        sc->stsc_first_sample[i] = FFMIN(chunk_samples, sc->sample_count);
+        chunk_samples += (uint64_t)(mov_stsc_first_chunk(sc, i + 1) - mov_stsc_first_chunk(sc, i)) *
+                 sc->stsc_data[i].count;
+    }
+    sc->nb_samples = FFMIN3(chunk_samples, sc->sample_count, INT_MAX);
+
+    /* a stts entry without samples is used for all the following ones */
+    total = 0;
+    for (i = 0; i < sc->stts_count; i++) {
+        sc->stts_first_sample[i] = total;
+        sc->stts_first_dts[i]    = current_dts;
+        sc->nb_stts              = i + 1;
+        if (sc->stts_data[i].count <= 0 ||
+            total + sc->stts_data[i].count >= sc->nb_samples)
+            break;
+        total       += sc->stts_data[i].count;
+        current_dts += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+    }
+
+    sc->compact_index = 1;
+    sc->cursor_sample = -1;
+
+    if (chunk_samples > sc->sample_count) {
+        av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+        return 1;
+    }
+    for (i = 0; i < sc->nb_samples; i++)
+        stream_size += mov_sample_size(sc, i);
+    if (st->duration > 0)
+        st->codec->bit_rate = stream_size*8*sc->time_scale/st->duration;
+
+    return 1;
+}
+
+/**
+ * Replace the compact index of st by index entries, so that the entries
+ * of movie fragments can be added to it.
+ */
+static int mov_expand_compact_index(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry *entries = NULL;
+    int i;
+
+    if (sc->nb_samples >= UINT_MAX / sizeof(*entries))
+        return AVERROR(ENOMEM);
+    if (sc->nb_samples &&
+        !(entries = av_malloc(sc->nb_samples * sizeof(*entries))))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < sc->nb_samples; i++)
+        entries[i] = *mov_get_sample(st, i);
+
+    av_free(st->index_entries);
+    st->index_entries                = entries;
+    st->nb_index_entries             = sc->nb_samples;
+    st->index_entries_allocated_size = sc->nb_samples * sizeof(*entries);
+    mov_free_sample_tables(sc);
+
+    return 0;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -1802,6 +2120,9 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         if (!sc->sample_count)
             return;
+        if (mov->compact_index &&
+            mov_build_compact_index(mov, st, current_dts) > 0)
+            return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
         mem = av_realloc(st->index_entries, (st->nb_index_entries + sc->sample_count) * sizeof(*st->index_entries));
@@ -2076,14 +2397,9 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         break;
     }
 
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->stsc_data);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
-    av_freep(&sc->rap_group);
+    /* Do not need those anymore, unless samples are looked up in them. */
+    if (!sc->compact_index)
+        mov_free_sample_tables(sc);
 
     return 0;
 }
@@ -2268,7 +2584,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i, found_keyframe = 0;
+    int flags, distance, i, found_keyframe = 0, ret;
 
     for (i = 0; i < c->fc->nb_streams; i++) {
         if (c->fc->streams[i]->id == frag->track_id) {
@@ -2283,6 +2599,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id)
         return 0;
+    if (sc->compact_index && (ret = mov_expand_compact_index(st)) < 0)
+        return ret;
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -2671,21 +2989,21 @@ static void mov_read_chapters(AVFormatContext *s)
     sc = st->priv_data;
     cur_pos = avio_tell(sc->pb);
 
-    for (i = 0; i < st->nb_index_entries; i++) {
-        AVIndexEntry *sample = &st->index_entries[i];
-        int64_t end = i+1 < st->nb_index_entries ? st->index_entries[i+1].timestamp : st->duration;
+    for (i = 0; i < mov_nb_samples(st); i++) {
+        AVIndexEntry sample = *mov_get_sample(st, i);
+        int64_t end = i+1 < mov_nb_samples(st) ? mov_get_sample(st, i+1)->timestamp : st->duration;
         uint8_t *title;
         uint16_t ch;
         int len, title_len;
 
-        if (avio_seek(sc->pb, sample->pos, SEEK_SET) != sample->pos) {
+        if (avio_seek(sc->pb, sample.pos, SEEK_SET) != sample.pos) {
             av_log(s, AV_LOG_ERROR, "Chapter %d not found in file\n", i);
             goto finish;
         }
 
         // the first two bytes are the length of the title
         len = avio_rb16(sc->pb);
-        if (len > sample->size-2)
+        if (len > sample.size-2)
             continue;
         title_len = 2*len + 1;
         if (!(title = av_mallocz(title_len)))
@@ -2711,7 +3029,7 @@ static void mov_read_chapters(AVFormatContext *s)
             }
         }
 
-        avpriv_new_chapter(s, i, st->time_base, sample->timestamp, end, title);
+        avpriv_new_chapter(s, i, st->time_base, sample.timestamp, end, title);
         av_freep(&title);
     }
 finish:
@@ -2727,6 +3045,7 @@ static int mov_read_close(AVFormatContext *s)
         AVStream *st = s->streams[i];
         MOVStreamContext *sc = st->priv_data;
 
+        mov_free_sample_tables(sc);
         av_freep(&sc->ctts_data);
         for (j = 0; j < sc->drefs_count; j++) {
             av_freep(&sc->drefs[j].path);
@@ -2794,16 +3113,16 @@ static int mov_read_header(AVFormatContext *s)
     return 0;
 }
 
-static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
+static const AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
-    AVIndexEntry *sample = NULL;
+    const AVIndexEntry *sample = NULL;
     int64_t best_dts = INT64_MAX;
     int i;
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        if (msc->pb && msc->current_sample < mov_nb_samples(avst)) {
+            const AVIndexEntry *current_sample = mov_get_sample(avst, msc->current_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_dlog(s, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!s->pb->seekable && current_sample->pos < sample->pos) ||
@@ -2824,7 +3143,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    const AVIndexEntry *sample;
+    AVIndexEntry sample_entry;
     AVStream *st = NULL;
     int ret;
  retry:
@@ -2842,6 +3162,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         goto retry;
     }
     sc = st->priv_data;
+    /* the entry of a compact index is overwritten by the next lookup */
+    sample_entry = *sample;
+    sample       = &sample_entry;
     /* must be done just before reading, to avoid infinite loop on sample */
     sc->current_sample++;
 
@@ -2851,7 +3174,10 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
                    sc->ffindex, sample->pos);
             return AVERROR_INVALIDDATA;
         }
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        if (mov->dv_demux && sc->dv_audio_container)
+            ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_ref(sc->pb, st, pkt, sample->size);
         if (ret < 0)
             return ret;
         if (sc->has_palette) {
@@ -2891,8 +3217,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         if (sc->wrong_dts)
             pkt->dts = AV_NOPTS_VALUE;
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < mov_nb_samples(st)) ?
+            mov_get_sample(st, sc->current_sample)->timestamp : st->duration;
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
@@ -2911,9 +3237,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     int sample, time_sample;
     int i;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    sample = mov_index_search_timestamp(st, timestamp, flags);
     av_dlog(s, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+    if (sample < 0 && mov_nb_samples(st) && timestamp < mov_get_sample(st, 0)->timestamp)
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
@@ -2953,7 +3279,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         return sample;
 
     /* adjust seek timestamp to found sample timestamp */
-    seek_timestamp = st->index_entries[sample].timestamp;
+    seek_timestamp = mov_get_sample(st, sample)->timestamp;
 
     for (i = 0; i < s->nb_streams; i++) {
         st = s->streams[i];
@@ -2966,6 +3292,20 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
     return 0;
 }
 
+#define OFFSET(x) offsetof(MOVContext, x)
+static const AVOption mov_options[] = {
+    { "compact_index", "Look samples up in the sample tables instead of building an index entry per sample",
+      OFFSET(compact_index), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL }
+};
+
+static const AVClass mov_class = {
+    .class_name = "mov,mp4,m4a,3gp,3g2,mj2",
+    .item_name  = av_default_item_name,
+    .option     = mov_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVInputFormat ff_mov_demuxer = {
     .name           = "mov,mp4,m4a,3gp,3g2,mj2",
     .long_name      = NULL_IF_CONFIG_SMALL("QuickTime / MOV"),
@@ -2975,4 +3315,5 @@ AVInputFormat ff_mov_demuxer = {
     .read_packet    = mov_read_packet,
     .read_close     = mov_read_close,
     .read_seek      = mov_read_seek,
+    .priv_class     = &mov_class,
 };
@@ -43,6 +43,8 @@
 #undef NDEBUG
 #include <assert.h>
 
+#define FASTSTART_BLOCK_SIZE (1 << 20) ///< minimal size of the faststart copies
+
 static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -51,6 +53,7 @@ static const AVOption options[] = {
     { "separate_moof", "Write separate moof/mdat atoms for each track", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SEPARATE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_custom", "Flush fragments on caller requests", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_CUSTOM}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "faststart", "Run a second pass to put the moov atom at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "iods_audio_profile", "iods audio profile atom.", offsetof(MOVMuxContext, iods_audio_profile), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 255, AV_OPT_FLAG_ENCODING_PARAM},
@@ -81,14 +84,45 @@ static int64_t update_size(AVIOContext *pb, int64_t pos)
     return curpos - pos;
 }
 
+/**
+ * Expand sample n from the run of track->cluster holding it. The search
+ * starts from the run of the previous lookup, so that walking the samples
+ * in order costs O(1) per sample.
+ */
+static void get_sample(MOVTrack *track, int n, MOVIentry *sample)
+{
+    MOVIentry *run;
+
+    while (n < track->cur_run_first)
+        track->cur_run_first -= track->cluster[--track->cur_run].count;
+    while (n >= track->cur_run_first + track->cluster[track->cur_run].count)
+        track->cur_run_first += track->cluster[track->cur_run++].count;
+
+    run            = &track->cluster[track->cur_run];
+    *sample        = *run;
+    sample->pos   += (uint64_t)(n - track->cur_run_first) * run->size;
+    sample->count  = 1;
+}
+
 /* Chunk offset atom */
+static int co64_required(const MOVTrack *track)
+{
+    const MOVIentry *last;
+
+    if (!track->entry)
+        return 0;
+    last = &track->cluster[track->nb_runs - 1];
+    return last->pos + (uint64_t)(last->count - 1) * last->size +
+           track->data_offset > UINT32_MAX;
+}
+
 static int mov_write_stco_tag(AVIOContext *pb, MOVTrack *track)
 {
     int i;
     int mode64 = 0; //   use 32 bit size variant if possible
     int64_t pos = avio_tell(pb);
     avio_wb32(pb, 0); /* size */
-    if (pos > UINT32_MAX) {
+    if (co64_required(track)) {
         mode64 = 1;
         ffio_wfourcc(pb, "co64");
     } else
@@ -96,10 +130,12 @@ static int mov_write_stco_tag(AVIOContext *pb, MOVTrack *track)
     avio_wb32(pb, 0); /* version & flags */
     avio_wb32(pb, track->entry); /* entry count */
     for (i=0; i<track->entry; i++) {
+        MOVIentry sample;
+        get_sample(track, i, &sample);
         if(mode64 == 1)
-            avio_wb64(pb, track->cluster[i].pos + track->data_offset);
+            avio_wb64(pb, sample.pos + track->data_offset);
         else
-            avio_wb32(pb, track->cluster[i].pos + track->data_offset);
+            avio_wb32(pb, sample.pos + track->data_offset);
     }
     return update_size(pb, pos);
 }
@@ -115,16 +151,16 @@ static int mov_write_stsz_tag(AVIOContext *pb, MOVTrack *track)
     ffio_wfourcc(pb, "stsz");
     avio_wb32(pb, 0); /* version & flags */
 
-    for (i=0; i<track->entry; i++) {
-        tst = track->cluster[i].size/track->cluster[i].entries;
+    for (i=0; i<track->nb_runs; i++) {
+        tst = track->cluster[i].size/track->cluster[i].samples_in_chunk;
         if(oldtst != -1 && tst != oldtst) {
             equalChunks = 0;
         }
         oldtst = tst;
-        entries += track->cluster[i].entries;
+        entries += track->cluster[i].samples_in_chunk * track->cluster[i].count;
     }
     if (equalChunks && track->entry) {
-        int sSize = track->entry ? track->cluster[0].size/track->cluster[0].entries : 0;
+        int sSize = track->entry ? track->cluster[0].size/track->cluster[0].samples_in_chunk : 0;
         sSize = FFMAX(1, sSize); // adpcm mono case could make sSize == 0
         avio_wb32(pb, sSize); // sample size
         avio_wb32(pb, entries); // sample count
@@ -133,9 +169,10 @@ static int mov_write_stsz_tag(AVIOContext *pb, MOVTrack *track)
         avio_wb32(pb, 0); // sample size
         avio_wb32(pb, entries); // sample count
         for (i=0; i<track->entry; i++) {
-            for (j=0; j<track->cluster[i].entries; j++) {
-                avio_wb32(pb, track->cluster[i].size /
-                         track->cluster[i].entries);
+            MOVIentry sample;
+            get_sample(track, i, &sample);
+            for (j=0; j<sample.samples_in_chunk; j++) {
+                avio_wb32(pb, sample.size / sample.samples_in_chunk);
             }
         }
     }
@@ -155,12 +192,14 @@ static int mov_write_stsc_tag(AVIOContext *pb, MOVTrack *track)
     entryPos = avio_tell(pb);
     avio_wb32(pb, track->entry); // entry count
     for (i=0; i<track->entry; i++) {
-        if (oldval != track->cluster[i].samples_in_chunk)
+        MOVIentry sample;
+        get_sample(track, i, &sample);
+        if (oldval != sample.samples_in_chunk)
         {
             avio_wb32(pb, i+1); // first chunk
-            avio_wb32(pb, track->cluster[i].samples_in_chunk); // samples per chunk
+            avio_wb32(pb, sample.samples_in_chunk); // samples per chunk
             avio_wb32(pb, 0x1); // sample description index
-            oldval = track->cluster[i].samples_in_chunk;
+            oldval = sample.samples_in_chunk;
             index++;
         }
     }
@@ -184,7 +223,9 @@ static int mov_write_stss_tag(AVIOContext *pb, MOVTrack *track, uint32_t flag)
     entryPos = avio_tell(pb);
     avio_wb32(pb, track->entry); // entry count
     for (i=0; i<track->entry; i++) {
-        if (track->cluster[i].flags & flag) {
+        MOVIentry sample;
+        get_sample(track, i, &sample);
+        if (sample.flags & flag) {
             avio_wb32(pb, i+1);
             index++;
         }
@@ -534,17 +575,17 @@ static int mov_get_lpcm_flags(enum AVCodecID codec_id)
 
 static int get_cluster_duration(MOVTrack *track, int cluster_idx)
 {
-    int64_t next_dts;
+    MOVIentry sample;
 
     if (cluster_idx >= track->entry)
         return 0;
 
     if (cluster_idx + 1 == track->entry)
-        next_dts = track->track_duration + track->start_dts;
-    else
-        next_dts = track->cluster[cluster_idx + 1].dts;
+        return track->track_duration + track->start_dts -
+               track->last_sample_dts;
 
-    return next_dts - track->cluster[cluster_idx].dts;
+    get_sample(track, cluster_idx, &sample);
+    return sample.duration;
 }
 
 static int get_samples_per_packet(MOVTrack *track)
@@ -1084,11 +1125,13 @@ static int mov_write_ctts_tag(AVIOContext *pb, MOVTrack *track)
     ctts_entries[0].count = 1;
     ctts_entries[0].duration = track->cluster[0].cts;
     for (i=1; i<track->entry; i++) {
-        if (track->cluster[i].cts == ctts_entries[entries].duration) {
+        MOVIentry sample;
+        get_sample(track, i, &sample);
+        if (sample.cts == ctts_entries[entries].duration) {
             ctts_entries[entries].count++; /* compress */
         } else {
             entries++;
-            ctts_entries[entries].duration = track->cluster[i].cts;
+            ctts_entries[entries].duration = sample.cts;
             ctts_entries[entries].count = 1;
         }
     }
@@ -1466,7 +1509,7 @@ static int mov_write_edts_tag(AVIOContext *pb, MOVTrack *track)
     int version = duration < INT32_MAX ? 0 : 1;
     int entry_size, entry_count, size;
     int64_t delay, start_ct = track->cluster[0].cts;
-    delay = av_rescale_rnd(track->cluster[0].dts + start_ct, MOV_TIMESCALE,
+    delay = av_rescale_rnd(track->first_sample_dts + start_ct, MOV_TIMESCALE,
                            track->timescale, AV_ROUND_DOWN);
     version |= delay < INT32_MAX ? 0 : 1;
 
@@ -1565,7 +1608,7 @@ static int mov_write_trak_tag(AVIOContext *pb, MOVMuxContext *mov,
     ffio_wfourcc(pb, "trak");
     mov_write_tkhd_tag(pb, track, st);
     if (track->mode == MODE_PSP || track->flags & MOV_TRACK_CTTS ||
-        (track->entry && track->cluster[0].dts)) {
+        (track->entry && track->first_sample_dts)) {
         if (!(mov->flags & FF_MOV_FLAG_FRAGMENT))
             mov_write_edts_tag(pb, track);  // PSP Movies require edts box
     }
@@ -2235,11 +2278,13 @@ static int mov_write_trun_tag(AVIOContext *pb, MOVTrack *track)
     int i;
 
     for (i = 0; i < track->entry; i++) {
+        MOVIentry sample;
+        get_sample(track, i, &sample);
         if (get_cluster_duration(track, i) != track->default_duration)
             flags |= MOV_TRUN_SAMPLE_DURATION;
-        if (track->cluster[i].size != track->default_size)
+        if (sample.size != track->default_size)
             flags |= MOV_TRUN_SAMPLE_SIZE;
-        if (i > 0 && get_sample_flags(track, &track->cluster[i]) != track->default_sample_flags)
+        if (i > 0 && get_sample_flags(track, &sample) != track->default_sample_flags)
             flags |= MOV_TRUN_SAMPLE_FLAGS;
     }
     if (!(flags & MOV_TRUN_SAMPLE_FLAGS))
@@ -2259,14 +2304,16 @@ static int mov_write_trun_tag(AVIOContext *pb, MOVTrack *track)
         avio_wb32(pb, get_sample_flags(track, &track->cluster[0]));
 
     for (i = 0; i < track->entry; i++) {
+        MOVIentry sample;
+        get_sample(track, i, &sample);
         if (flags & MOV_TRUN_SAMPLE_DURATION)
             avio_wb32(pb, get_cluster_duration(track, i));
         if (flags & MOV_TRUN_SAMPLE_SIZE)
-            avio_wb32(pb, track->cluster[i].size);
+            avio_wb32(pb, sample.size);
         if (flags & MOV_TRUN_SAMPLE_FLAGS)
-            avio_wb32(pb, get_sample_flags(track, &track->cluster[i]));
+            avio_wb32(pb, get_sample_flags(track, &sample));
         if (flags & MOV_TRUN_SAMPLE_CTS)
-            avio_wb32(pb, track->cluster[i].cts);
+            avio_wb32(pb, sample.cts);
     }
 
     return update_size(pb, pos);
@@ -2287,7 +2334,7 @@ static int mov_write_tfxd_tag(AVIOContext *pb, MOVTrack *track)
     avio_wb24(pb, 0);
     avio_wb64(pb, track->frag_start);
     avio_wb64(pb, track->start_dts + track->track_duration -
-                  track->cluster[0].dts);
+                  track->first_sample_dts);
 
     return update_size(pb, pos);
 }
@@ -2634,7 +2681,7 @@ static void mov_parse_vc1_frame(AVPacket *pkt, MOVTrack *trk, int fragment)
     } else if ((seq && !trk->vc1_info.packet_seq) ||
                (entry && !trk->vc1_info.packet_entry)) {
         int i;
-        for (i = 0; i < trk->entry; i++)
+        for (i = 0; i < trk->nb_runs; i++)
             trk->cluster[i].flags &= ~MOV_SYNC_SAMPLE;
         trk->has_keyframes = 0;
         if (seq)
@@ -2659,11 +2706,64 @@ static void mov_parse_vc1_frame(AVPacket *pkt, MOVTrack *trk, int fragment)
     else if (trk->vc1_info.packet_entry)
         key = entry;
     if (key) {
-        trk->cluster[trk->entry].flags |= MOV_SYNC_SAMPLE;
+        trk->cluster[trk->nb_runs].flags |= MOV_SYNC_SAMPLE;
         trk->has_keyframes++;
     }
 }
 
+static void mov_reset_samples(MOVTrack *trk)
+{
+    trk->entry         = 0;
+    trk->nb_runs       = 0;
+    trk->cur_run       = 0;
+    trk->cur_run_first = 0;
+}
+
+/**
+ * Set the duration of the last sample, now that the dts of the next one is
+ * known. If it differs from the duration of the other samples of its run,
+ * the sample gets a run of its own.
+ */
+static void mov_end_last_sample(MOVTrack *trk, int64_t dts)
+{
+    MOVIentry *run = &trk->cluster[trk->nb_runs - 1];
+    int duration   = dts - trk->last_sample_dts;
+
+    if (run->count == 1) {
+        run->duration = duration;
+    } else if (run->duration != duration) {
+        MOVIentry *last = run + 1;
+
+        run->count--;
+        *last          = *run;
+        last->pos     += (uint64_t)run->count * run->size;
+        last->count    = 1;
+        last->duration = duration;
+        trk->nb_runs++;
+    }
+}
+
+/**
+ * Add the sample filled in after the last run to the table, extending the
+ * last run if the sample follows it in the file and is otherwise identical.
+ */
+static void mov_add_sample(MOVTrack *trk)
+{
+    MOVIentry *sample = &trk->cluster[trk->nb_runs];
+    MOVIentry *run    = trk->nb_runs ? sample - 1 : NULL;
+
+    /* mov_parse_vc1_frame() sets the flags of the first sample afterwards */
+    if (run && trk->enc->codec_id != AV_CODEC_ID_VC1 &&
+        sample->pos == run->pos + (uint64_t)run->count * run->size &&
+        sample->size             == run->size             &&
+        sample->samples_in_chunk == run->samples_in_chunk &&
+        sample->cts              == run->cts              &&
+        sample->flags            == run->flags)
+        run->count++;
+    else
+        trk->nb_runs++;
+}
+
 static int mov_flush_fragment(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -2710,8 +2810,8 @@ static int mov_flush_fragment(AVFormatContext *s)
             if (mov->tracks[i].entry)
                 mov->tracks[i].frag_start += mov->tracks[i].start_dts +
                                              mov->tracks[i].track_duration -
-                                             mov->tracks[i].cluster[0].dts;
-            mov->tracks[i].entry = 0;
+                                             mov->tracks[i].first_sample_dts;
+            mov_reset_samples(&mov->tracks[i]);
         }
         avio_flush(s->pb);
         return 0;
@@ -2741,7 +2841,7 @@ static int mov_flush_fragment(AVFormatContext *s)
 
         if (track->entry)
             duration = track->start_dts + track->track_duration -
-                       track->cluster[0].dts;
+                       track->first_sample_dts;
         if (mov->flags & FF_MOV_FLAG_SEPARATE_MOOF) {
             if (!track->mdat_buf)
                 continue;
@@ -2774,7 +2874,7 @@ static int mov_flush_fragment(AVFormatContext *s)
 
         if (track->entry)
             track->frag_start += duration;
-        track->entry = 0;
+        mov_reset_samples(track);
         if (!track->mdat_buf)
             continue;
         buf_size = avio_close_dyn_buf(track->mdat_buf, &buf);
@@ -2796,8 +2896,10 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     AVIOContext *pb = s->pb;
     MOVTrack *trk = &mov->tracks[pkt->stream_index];
     AVCodecContext *enc = trk->enc;
+    MOVIentry *sample;
     unsigned int samples_in_chunk = 0;
     int size= pkt->size;
+    int64_t dts;
     uint8_t *reformatted_data = NULL;
 
     if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
@@ -2867,24 +2969,47 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         memcpy(trk->vos_data, pkt->data, size);
     }
 
-    if (!(trk->entry % MOV_INDEX_CLUSTER_SIZE)) {
-        trk->cluster = av_realloc(trk->cluster, (trk->entry + MOV_INDEX_CLUSTER_SIZE) * sizeof(*trk->cluster));
-        if (!trk->cluster)
-            return -1;
+    /* room for the run of this sample, and for the one
+     * mov_end_last_sample() may split off */
+    if (trk->nb_runs + 2 > trk->cluster_capacity) {
+        /* grow geometrically, so that long recordings do not copy the
+         * whole sample table every MOV_INDEX_CLUSTER_SIZE packets, but by
+         * a bounded step, so that little of it is left unused */
+        unsigned new_capacity = trk->cluster_capacity +
+                                av_clip(trk->cluster_capacity / 2,
+                                        MOV_INDEX_CLUSTER_SIZE,
+                                        MOV_INDEX_CLUSTER_MAX_STEP);
+        MOVIentry *cluster;
+
+        if (new_capacity >= UINT_MAX / sizeof(*trk->cluster))
+            return AVERROR(ENOMEM);
+        cluster = av_realloc(trk->cluster, new_capacity * sizeof(*trk->cluster));
+        if (!cluster)
+            return AVERROR(ENOMEM);
+        trk->cluster          = cluster;
+        trk->cluster_capacity = new_capacity;
     }
 
-    trk->cluster[trk->entry].pos = avio_tell(pb) - size;
-    trk->cluster[trk->entry].samples_in_chunk = samples_in_chunk;
-    trk->cluster[trk->entry].size = size;
-    trk->cluster[trk->entry].entries = samples_in_chunk;
-    trk->cluster[trk->entry].dts = pkt->dts;
+    dts = pkt->dts;
     if (!trk->entry && trk->start_dts != AV_NOPTS_VALUE) {
         /* First packet of a new fragment. We already wrote the duration
          * of the last packet of the previous fragment based on track_duration,
          * which might not exactly match our dts. Therefore adjust the dts
          * of this packet to be what the previous packets duration implies. */
-        trk->cluster[trk->entry].dts = trk->start_dts + trk->track_duration;
+        dts = trk->start_dts + trk->track_duration;
     }
+    if (trk->entry)
+        mov_end_last_sample(trk, dts);
+    else
+        trk->first_sample_dts = dts;
+    trk->last_sample_dts = dts;
+
+    sample = &trk->cluster[trk->nb_runs];
+    sample->pos              = avio_tell(pb) - size;
+    sample->samples_in_chunk = samples_in_chunk;
+    sample->size             = size;
+    sample->count            = 1;
+    sample->duration         = 0;
     if (trk->start_dts == AV_NOPTS_VALUE)
         trk->start_dts = pkt->dts;
     trk->track_duration = pkt->dts - trk->start_dts + pkt->duration;
@@ -2895,22 +3020,23 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
     if (pkt->dts != pkt->pts)
         trk->flags |= MOV_TRACK_CTTS;
-    trk->cluster[trk->entry].cts = pkt->pts - pkt->dts;
-    trk->cluster[trk->entry].flags = 0;
+    sample->cts   = pkt->pts - pkt->dts;
+    sample->flags = 0;
     if (enc->codec_id == AV_CODEC_ID_VC1) {
         mov_parse_vc1_frame(pkt, trk, mov->fragments);
     } else if (pkt->flags & AV_PKT_FLAG_KEY) {
         if (mov->mode == MODE_MOV && enc->codec_id == AV_CODEC_ID_MPEG2VIDEO &&
             trk->entry > 0) { // force sync sample for the first key frame
-            mov_parse_mpeg2_frame(pkt, &trk->cluster[trk->entry].flags);
-            if (trk->cluster[trk->entry].flags & MOV_PARTIAL_SYNC_SAMPLE)
+            mov_parse_mpeg2_frame(pkt, &sample->flags);
+            if (sample->flags & MOV_PARTIAL_SYNC_SAMPLE)
                 trk->flags |= MOV_TRACK_STPS;
         } else {
-            trk->cluster[trk->entry].flags = MOV_SYNC_SAMPLE;
+            sample->flags = MOV_SYNC_SAMPLE;
         }
-        if (trk->cluster[trk->entry].flags & MOV_SYNC_SAMPLE)
+        if (sample->flags & MOV_SYNC_SAMPLE)
             trk->has_keyframes++;
     }
+    mov_add_sample(trk);
     trk->entry++;
     trk->sample_count += samples_in_chunk;
     mov->mdat_size += size;
@@ -2939,7 +3065,7 @@ static int mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (!pkt->size) return 0; /* Discard 0 sized packets */
 
         if (trk->entry)
-            frag_duration = av_rescale_q(pkt->dts - trk->cluster[0].dts,
+            frag_duration = av_rescale_q(pkt->dts - trk->first_sample_dts,
                                          s->streams[pkt->stream_index]->time_base,
                                          AV_TIME_BASE_Q);
         if ((mov->max_fragment_duration &&
@@ -3144,6 +3270,17 @@ static int mov_write_header(AVFormatContext *s)
                       FF_MOV_FLAG_FRAGMENT;
     }
 
+    if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
+            av_log(s, AV_LOG_WARNING,
+                   "The faststart flag is incompatible with fragmentation, "
+                   "disabling it\n");
+            mov->flags &= ~FF_MOV_FLAG_FASTSTART;
+        } else {
+            mov->reserved_moov_pos = avio_tell(pb);
+        }
+    }
+
     if (!(mov->flags & FF_MOV_FLAG_FRAGMENT))
         mov_write_mdat_tag(pb, mov);
 
@@ -3183,6 +3320,113 @@ static int mov_write_header(AVFormatContext *s)
     return -1;
 }
 
+static int get_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *moov_buf;
+    uint8_t *buf;
+    int ret, size;
+
+    if ((ret = avio_open_dyn_buf(&moov_buf)) < 0)
+        return ret;
+    mov_write_moov_tag(moov_buf, mov, s);
+    size = avio_close_dyn_buf(moov_buf, &buf);
+    av_free(buf);
+    return size;
+}
+
+/**
+ * Compute the size of the moov atom written before the data, and offset
+ * the chunks by it.
+ */
+static int compute_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int i, moov_size, moov_size2;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+
+    for (i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset += moov_size;
+
+    moov_size2 = get_moov_size(s);
+    if (moov_size2 < 0)
+        return moov_size2;
+
+    /* If the size changed, some stco atoms turned into co64 ones because of
+     * the offset; they are larger, and only get larger in turn. */
+    if (moov_size2 != moov_size)
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += moov_size2 - moov_size;
+
+    return moov_size2;
+}
+
+/**
+ * Move the data between reserved_moov_pos and pos_end forward to make
+ * room for the moov atom.
+ */
+static int shift_data(AVFormatContext *s, int64_t pos_end)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *read_pb;
+    uint8_t *buf[2];
+    int size[2], cur = 0;
+    int moov_size, block_size, ret;
+    int64_t pos;
+
+    moov_size = compute_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+
+    /* Each block is written once the next one has been read: as long as
+     * the blocks are not smaller than the shift, the writes never reach
+     * data that has not been read yet. */
+    block_size = FFMAX(moov_size, FASTSTART_BLOCK_SIZE);
+    buf[0] = av_malloc(2 * block_size);
+    if (!buf[0])
+        return AVERROR(ENOMEM);
+    buf[1] = buf[0] + block_size;
+
+    /* The output context can only be used for writing, so the same output
+     * is reopened for reading. */
+    avio_flush(s->pb);
+    ret = avio_open2(&read_pb, s->filename, AVIO_FLAG_READ,
+                     &s->interrupt_callback, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to reopen %s for the second pass "
+               "(faststart)\n", s->filename);
+        goto end;
+    }
+
+    avio_seek(read_pb, mov->reserved_moov_pos, SEEK_SET);
+    avio_seek(s->pb, mov->reserved_moov_pos + moov_size, SEEK_SET);
+
+    pos     = mov->reserved_moov_pos;
+    size[0] = avio_read(read_pb, buf[0], FFMIN(block_size, pos_end - pos));
+    while (size[cur] > 0) {
+        int64_t next = pos + size[cur];
+
+        size[!cur] = next < pos_end ?
+                     avio_read(read_pb, buf[!cur],
+                               FFMIN(block_size, pos_end - next)) : 0;
+        avio_write(s->pb, buf[cur], size[cur]);
+        pos  = next;
+        cur ^= 1;
+    }
+    if (size[cur] < 0)
+        ret = size[cur];
+    else if (pos < pos_end)
+        ret = AVERROR(EIO);
+    avio_close(read_pb);
+
+end:
+    av_free(buf[0]);
+    return ret;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -3208,7 +3452,17 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, moov_pos, SEEK_SET);
 
-        mov_write_moov_tag(pb, mov, s);
+        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov "
+                   "atom to the beginning of the file\n");
+            res = shift_data(s, moov_pos);
+            if (res >= 0) {
+                avio_seek(pb, mov->reserved_moov_pos, SEEK_SET);
+                mov_write_moov_tag(pb, mov, s);
+            }
+        } else {
+            mov_write_moov_tag(pb, mov, s);
+        }
     } else {
         mov_flush_fragment(s);
         mov_write_mfra_tag(pb, mov);
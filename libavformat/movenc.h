@@ -27,6 +27,7 @@
 #include "avformat.h"
 
 #define MOV_INDEX_CLUSTER_SIZE 16384
+#define MOV_INDEX_CLUSTER_MAX_STEP (16 * MOV_INDEX_CLUSTER_SIZE)
 #define MOV_TIMESCALE 1000
 
 #define RTP_MAX_PACKET_SIZE 1450
@@ -40,16 +41,20 @@
 #define MODE_IPOD 0x20
 #define MODE_ISM  0x40
 
+/**
+ * A run of count samples stored back to back in the file, which only
+ * differ by their position. The entry describes the first one.
+ */
 typedef struct MOVIentry {
     uint64_t     pos;
-    int64_t      dts;
     unsigned int size;
     unsigned int samples_in_chunk;
-    unsigned int entries;
     int          cts;
 #define MOV_SYNC_SAMPLE         0x0001
 #define MOV_PARTIAL_SYNC_SAMPLE 0x0002
     uint32_t     flags;
+    unsigned int count;
+    int          duration; ///< of each sample, unknown yet for the last sample of the track
 } MOVIentry;
 
 typedef struct HintSample {
@@ -75,7 +80,7 @@ typedef struct MOVFragmentInfo {
 
 typedef struct MOVIndex {
     int         mode;
-    int         entry;
+    int         entry; ///< number of samples in cluster
     unsigned    timescale;
     uint64_t    time;
     int64_t     track_duration;
@@ -93,6 +98,12 @@ typedef struct MOVIndex {
     int         vos_len;
     uint8_t     *vos_data;
     MOVIentry   *cluster;
+    int         nb_runs;          ///< number of used entries of cluster
+    unsigned    cluster_capacity; ///< number of allocated entries of cluster
+    int64_t     first_sample_dts; ///< dts of the first sample in cluster
+    int64_t     last_sample_dts;  ///< dts of the last sample in cluster
+    int         cur_run;          ///< run last looked up by get_sample()
+    int         cur_run_first;    ///< first sample of cur_run
     int         audio_vbr;
     int         height; ///< active picture (w/o VBI) height for D-10/IMX
     uint32_t    tref_tag;
@@ -153,6 +164,8 @@ typedef struct MOVMuxContext {
     int max_fragment_size;
     int ism_lookahead;
     AVIOContext *mdat_buf;
+
+    int64_t reserved_moov_pos; ///< where the moov atom goes with faststart
 } MOVMuxContext;
 
 #define FF_MOV_FLAG_RTP_HINT 1
@@ -162,6 +175,7 @@ typedef struct MOVMuxContext {
 #define FF_MOV_FLAG_SEPARATE_MOOF 16
 #define FF_MOV_FLAG_FRAG_CUSTOM 32
 #define FF_MOV_FLAG_ISML 64
+#define FF_MOV_FLAG_FASTSTART 128
 
 int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt);
 
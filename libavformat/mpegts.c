@@ -123,6 +123,14 @@ struct MpegTSContext {
     unsigned int nb_prg;
     struct Program *prg;
 
+    /** comma-separated program numbers to demux, all if NULL */
+    char *programs_str;
+    /** comma-separated elementary stream PIDs to demux, all if NULL */
+    char *pids_str;
+    int *allowed_programs;
+    int nb_allowed_programs;
+    int *allowed_pids;
+    int nb_allowed_pids;
 
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
@@ -134,6 +142,21 @@ static const AVOption options[] = {
     { NULL },
 };
 
+static const AVOption mpegts_options[] = {
+    { "programs", "Comma-separated list of program numbers to demux, other programs are dropped at the TS packet level",
+      offsetof(MpegTSContext, programs_str), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    { "pids", "Comma-separated list of elementary stream PIDs to demux, other PIDs are dropped at the TS packet level",
+      offsetof(MpegTSContext, pids_str), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass mpegts_class = {
+    .class_name = "mpegts demuxer",
+    .item_name  = av_default_item_name,
+    .option     = mpegts_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static const AVClass mpegtsraw_class = {
     .class_name = "mpegtsraw demuxer",
     .item_name  = av_default_item_name,
@@ -259,6 +282,69 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+static int in_list(const int *list, int nb, int id)
+{
+    int i;
+
+    for (i = 0; i < nb; i++)
+        if (list[i] == id)
+            return 1;
+    return 0;
+}
+
+/**
+ * @return 1 if the program with the given number is to be demuxed
+ */
+static int program_allowed(MpegTSContext *ts, int programid)
+{
+    return !ts->allowed_programs ||
+           in_list(ts->allowed_programs, ts->nb_allowed_programs, programid);
+}
+
+/**
+ * @return 1 if the elementary stream with the given pid is to be demuxed
+ */
+static int pid_allowed(MpegTSContext *ts, int pid)
+{
+    return !ts->allowed_pids ||
+           in_list(ts->allowed_pids, ts->nb_allowed_pids, pid);
+}
+
+/**
+ * @return 1 if a stream may be created for a pid found outside of the PMTs
+ */
+static int auto_guess_pid(MpegTSContext *ts, int pid)
+{
+    return ts->auto_guess && !ts->allowed_programs && pid_allowed(ts, pid);
+}
+
+/**
+ * Parse a comma-separated list of numbers in the range [0, max].
+ */
+static int parse_id_list(AVFormatContext *s, const char *str, int max,
+                         int **list, int *nb)
+{
+    const char *p = str;
+
+    while (*p) {
+        char *end;
+        long id = strtol(p, &end, 0);
+        int *tmp;
+
+        if (end == p || id < 0 || id > max || (*end && *end != ',')) {
+            av_log(s, AV_LOG_ERROR, "Invalid list '%s'\n", str);
+            return AVERROR(EINVAL);
+        }
+        tmp = av_realloc(*list, (*nb + 1) * sizeof(**list));
+        if (!tmp)
+            return AVERROR(ENOMEM);
+        *list = tmp;
+        (*list)[(*nb)++] = id;
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -1383,6 +1469,8 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
     if (h->tid != PMT_TID)
         return;
+    if (!program_allowed(ts, h->id))
+        return;
 
     clear_program(ts, h->id);
     pcr_pid = get16(&p, p_end);
@@ -1439,6 +1527,15 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
             break;
         pid &= 0x1fff;
 
+        if (!pid_allowed(ts, pid)) {
+            /* skip the descriptors, no filter is opened for this pid */
+            desc_list_len = get16(&p, p_end);
+            if (desc_list_len < 0)
+                break;
+            p += desc_list_len & 0xfff;
+            continue;
+        }
+
         /* now create stream */
         if (ts->pids[pid] && ts->pids[pid]->type == MPEGTS_PES) {
             pes = ts->pids[pid]->u.pes_filter.opaque;
@@ -1531,6 +1628,8 @@ static void pat_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
         if (sid == 0x0000) {
             /* NIT info */
+        } else if (!program_allowed(ts, sid)) {
+            av_dlog(ts->stream, "skipping program 0x%x\n", sid);
         } else {
             av_new_program(ts->stream, sid);
             if (ts->pids[pmt_pid])
@@ -1601,7 +1700,7 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
                 if (!provider_name)
                     break;
                 name = getstr8(&p, p_end);
-                if (name) {
+                if (name && program_allowed(ts, sid)) {
                     AVProgram *program = av_new_program(ts->stream, sid);
                     if(program) {
                         av_dict_set(&program->metadata, "service_name", name, 0);
@@ -1635,7 +1734,7 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
         return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
-    if (ts->auto_guess && tss == NULL && is_start) {
+    if (tss == NULL && is_start && auto_guess_pid(ts, pid)) {
         add_pes_stream(ts, pid, -1);
         tss = ts->pids[pid];
     }
@@ -1726,9 +1825,22 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
 static int mpegts_resync(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
-    int c, i;
+    int c, i = 0;
+
+    while (i < MAX_RESYNC_SIZE) {
+        int len = FFMIN(pb->buf_end - pb->buf_ptr, MAX_RESYNC_SIZE - i);
 
-    for(i = 0;i < MAX_RESYNC_SIZE; i++) {
+        /* scan the buffered data at once */
+        if (len > 0) {
+            uint8_t *sync = memchr(pb->buf_ptr, 0x47, len);
+            if (sync) {
+                pb->buf_ptr = sync;
+                return 0;
+            }
+            pb->buf_ptr += len;
+            i           += len;
+            continue;
+        }
         c = avio_r8(pb);
         if (pb->eof_reached)
             return -1;
@@ -1736,19 +1848,36 @@ static int mpegts_resync(AVFormatContext *s)
             avio_seek(pb, -1, SEEK_CUR);
             return 0;
         }
+        i++;
     }
     av_log(s, AV_LOG_ERROR, "max resync size reached, could not find sync byte\n");
     /* no sync found */
     return -1;
 }
 
-/* return -1 if error or EOF. Return 0 if OK. */
-static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size)
+/**
+ * Read one TS packet.
+ *
+ * If data is not NULL and the packet is entirely in the I/O buffer, it is
+ * returned in place through data and buf is left untouched. Otherwise the
+ * packet is copied to buf, and data is set to buf.
+ *
+ * @return -1 if error or EOF. Return 0 if OK.
+ */
+static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
+                       const uint8_t **data)
 {
     AVIOContext *pb = s->pb;
     int skip, len;
 
     for(;;) {
+        if (data && pb->buf_ptr < pb->buf_end && pb->buf_ptr[0] == 0x47 &&
+            pb->buf_end - pb->buf_ptr >= FFMAX(raw_packet_size,
+                                               TS_PACKET_SIZE + FF_INPUT_BUFFER_PADDING_SIZE)) {
+            *data        = pb->buf_ptr;
+            pb->buf_ptr += raw_packet_size;
+            return 0;
+        }
         len = avio_read(pb, buf, TS_PACKET_SIZE);
         if (len != TS_PACKET_SIZE)
             return len < 0 ? len : AVERROR_EOF;
@@ -1767,9 +1896,37 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size)
             break;
         }
     }
+    if (data)
+        *data = buf;
     return 0;
 }
 
+/**
+ * Skip the buffered packets of PIDs without a filter, starting at the
+ * current position, without going through handle_packet().
+ *
+ * @return the number of skipped packets, at most max_packets
+ */
+static int skip_unfiltered_packets(MpegTSContext *ts, int max_packets)
+{
+    AVIOContext *pb  = ts->stream->pb;
+    uint8_t *p       = pb->buf_ptr;
+    int packet_size  = ts->raw_packet_size;
+    int nb_buffered  = (pb->buf_end - p) / packet_size;
+    int i;
+
+    nb_buffered = FFMIN(nb_buffered, max_packets);
+    for (i = 0; i < nb_buffered; i++, p += packet_size) {
+        int pid = AV_RB16(p + 1) & 0x1fff;
+
+        if (p[0] != 0x47 || ts->pids[pid] ||
+            ((p[1] & 0x40) && auto_guess_pid(ts, pid)))
+            break;
+    }
+    pb->buf_ptr = p;
+    return i;
+}
+
 static int handle_packets(MpegTSContext *ts, int nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -1797,15 +1954,20 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, FF_INPUT_BUFFER_PADDING_SIZE);
     for(;;) {
+        const uint8_t *data;
+
         if (ts->stop_parse>0)
             break;
+        packet_num += skip_unfiltered_packets(ts, nb_packets ?
+                                              nb_packets - packet_num - 1 :
+                                              INT_MAX);
         packet_num++;
         if (nb_packets != 0 && packet_num >= nb_packets)
             break;
-        ret = read_packet(s, packet, ts->raw_packet_size);
+        ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
-        ret = handle_packet(ts, packet);
+        ret = handle_packet(ts, data);
         if (ret != 0)
             break;
     }
@@ -1870,9 +2032,20 @@ static int mpegts_read_header(AVFormatContext *s)
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
     uint8_t buf[5*1024];
-    int len;
+    int len, ret;
     int64_t pos;
 
+    if ((ts->programs_str &&
+         (ret = parse_id_list(s, ts->programs_str, 0xffff, &ts->allowed_programs,
+                              &ts->nb_allowed_programs)) < 0) ||
+        (ts->pids_str &&
+         (ret = parse_id_list(s, ts->pids_str, 0x1fff, &ts->allowed_pids,
+                              &ts->nb_allowed_pids)) < 0)) {
+        av_freep(&ts->allowed_programs);
+        av_freep(&ts->allowed_pids);
+        return ret;
+    }
+
     /* read the first 1024 bytes to get packet size */
     pos = avio_tell(pb);
     len = avio_read(pb, buf, sizeof(buf));
@@ -1905,7 +2078,7 @@ static int mpegts_read_header(AVFormatContext *s)
         s->ctx_flags |= AVFMTCTX_NOHEADER;
     } else {
         AVStream *st;
-        int pcr_pid, pid, nb_packets, nb_pcrs, ret, pcr_l;
+        int pcr_pid, pid, nb_packets, nb_pcrs, pcr_l;
         int64_t pcrs[2], pcr_h;
         int packet_count[2];
         uint8_t packet[TS_PACKET_SIZE];
@@ -1924,7 +2097,7 @@ static int mpegts_read_header(AVFormatContext *s)
         nb_pcrs = 0;
         nb_packets = 0;
         for(;;) {
-            ret = read_packet(s, packet, ts->raw_packet_size);
+            ret = read_packet(s, packet, ts->raw_packet_size, NULL);
             if (ret < 0)
                 return -1;
             pid = AV_RB16(packet + 1) & 0x1fff;
@@ -1954,6 +2127,8 @@ static int mpegts_read_header(AVFormatContext *s)
     avio_seek(pb, pos, SEEK_SET);
     return 0;
  fail:
+    av_freep(&ts->allowed_programs);
+    av_freep(&ts->allowed_pids);
     return -1;
 }
 
@@ -1971,7 +2146,7 @@ static int mpegts_raw_read_packet(AVFormatContext *s,
     if (av_new_packet(pkt, TS_PACKET_SIZE) < 0)
         return AVERROR(ENOMEM);
     pkt->pos= avio_tell(s->pb);
-    ret = read_packet(s, pkt->data, ts->raw_packet_size);
+    ret = read_packet(s, pkt->data, ts->raw_packet_size, NULL);
     if (ret < 0) {
         av_free_packet(pkt);
         return ret;
@@ -2037,6 +2212,8 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->allowed_programs);
+    av_freep(&ts->allowed_pids);
 
     for(i=0;i<NB_PID_MAX;i++)
         if (ts->pids[i]) mpegts_close_filter(ts, ts->pids[i]);
@@ -2172,6 +2349,7 @@ AVInputFormat ff_mpegts_demuxer = {
     .read_seek      = read_seek,
     .read_timestamp = mpegts_get_pcr,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .priv_class     = &mpegts_class,
 };
 
 AVInputFormat ff_mpegtsraw_demuxer = {
@@ -495,6 +495,176 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
     }
 }
 
+/**
+ * Queue of packets for the default interleaving: a FIFO of packets per
+ * stream, and a binary min-heap of the streams with queued packets,
+ * ordered like ff_interleave_compare_dts() by the first packet of each
+ * stream. The FIFOs are ring buffers reused for the whole muxing, so
+ * queueing a packet does not allocate memory in the steady state.
+ */
+typedef struct InterleaveFifo {
+    AVPacket *pkts;
+    int size;                   ///< allocated number of packets
+    int first;                  ///< index of the first queued packet
+    int nb_pkts;                ///< number of queued packets
+} InterleaveFifo;
+
+typedef struct FFInterleaveQueue {
+    InterleaveFifo *fifos;
+    int *heap;                  ///< indices of the streams with queued packets
+    int nb_fifos;
+    int heap_size;
+} FFInterleaveQueue;
+
+#define FIFO_HEAD(q, i) (&(q)->fifos[i].pkts[(q)->fifos[i].first])
+
+/* return nonzero if the first packet of stream a goes after the one of b */
+static int heap_after(AVFormatContext *s, FFInterleaveQueue *q, int a, int b)
+{
+    return ff_interleave_compare_dts(s, FIFO_HEAD(q, a), FIFO_HEAD(q, b));
+}
+
+static void heap_sift_up(AVFormatContext *s, FFInterleaveQueue *q, int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (!heap_after(s, q, q->heap[parent], q->heap[i]))
+            break;
+        FFSWAP(int, q->heap[parent], q->heap[i]);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(AVFormatContext *s, FFInterleaveQueue *q, int i)
+{
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= q->heap_size)
+            break;
+        if (child + 1 < q->heap_size &&
+            heap_after(s, q, q->heap[child], q->heap[child + 1]))
+            child++;
+        if (!heap_after(s, q, q->heap[i], q->heap[child]))
+            break;
+        FFSWAP(int, q->heap[i], q->heap[child]);
+        i = child;
+    }
+}
+
+static int interleave_queue_add(AVFormatContext *s, AVPacket *pkt)
+{
+    FFInterleaveQueue *q = s->interleave_queue;
+    InterleaveFifo *fifo;
+    int idx = pkt->stream_index;
+    AVPacket this_pkt;
+    int ret;
+
+    if (!q && !(q = s->interleave_queue = av_mallocz(sizeof(*q))))
+        return AVERROR(ENOMEM);
+
+    if (idx >= q->nb_fifos) {
+        int nb_fifos = s->nb_streams;
+        void *tmp;
+
+        /* both arrays must have room for nb_fifos before it is updated */
+        tmp = av_realloc(q->heap, nb_fifos * sizeof(*q->heap));
+        if (!tmp)
+            return AVERROR(ENOMEM);
+        q->heap = tmp;
+
+        tmp = av_realloc(q->fifos, nb_fifos * sizeof(*q->fifos));
+        if (!tmp)
+            return AVERROR(ENOMEM);
+        q->fifos = tmp;
+        memset(q->fifos + q->nb_fifos, 0,
+               (nb_fifos - q->nb_fifos) * sizeof(*q->fifos));
+        q->nb_fifos = nb_fifos;
+    }
+
+    fifo = &q->fifos[idx];
+    if (fifo->nb_pkts == fifo->size) {
+        int size = FFMAX(2 * fifo->size, 8), i;
+        AVPacket *pkts = av_malloc(size * sizeof(*pkts));
+
+        if (!pkts)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < fifo->nb_pkts; i++)
+            pkts[i] = fifo->pkts[(fifo->first + i) % fifo->size];
+        av_free(fifo->pkts);
+        fifo->pkts  = pkts;
+        fifo->size  = size;
+        fifo->first = 0;
+    }
+
+    this_pkt = *pkt;
+#if FF_API_DESTRUCT_PACKET
+    pkt->destruct = NULL;           // do not free original but only the copy
+#endif
+    pkt->buf      = NULL;
+    // duplicate the packet if it uses non-alloced memory
+    if ((ret = av_dup_packet(&this_pkt)) < 0)
+        return ret;
+
+    fifo->pkts[(fifo->first + fifo->nb_pkts++) % fifo->size] = this_pkt;
+    if (fifo->nb_pkts == 1) {
+        q->heap[q->heap_size++] = idx;
+        heap_sift_up(s, q, q->heap_size - 1);
+    }
+    return 0;
+}
+
+/**
+ * Default interleaving of muxers without their own interleave_packet,
+ * outputting packets in the same order as ff_interleave_packet_per_dts().
+ */
+static int interleave_packet_per_dts_queue(AVFormatContext *s, AVPacket *out,
+                                           AVPacket *pkt, int flush)
+{
+    FFInterleaveQueue *q;
+    int ret;
+
+    if (pkt && (ret = interleave_queue_add(s, pkt)) < 0) {
+        av_free_packet(pkt);
+        return ret;
+    }
+
+    q = s->interleave_queue;
+    if (q && q->heap_size && (q->heap_size == s->nb_streams || flush)) {
+        InterleaveFifo *fifo = &q->fifos[q->heap[0]];
+
+        *out        = fifo->pkts[fifo->first];
+        fifo->first = (fifo->first + 1) % fifo->size;
+        if (!--fifo->nb_pkts)
+            q->heap[0] = q->heap[--q->heap_size];
+        heap_sift_down(s, q, 0);
+        return 1;
+    } else {
+        av_init_packet(out);
+        return 0;
+    }
+}
+
+void ff_interleave_queue_free(AVFormatContext *s)
+{
+    FFInterleaveQueue *q = s->interleave_queue;
+    int i;
+
+    if (!q)
+        return;
+
+    for (i = 0; i < q->nb_fifos; i++) {
+        InterleaveFifo *fifo = &q->fifos[i];
+        while (fifo->nb_pkts--) {
+            av_free_packet(&fifo->pkts[fifo->first]);
+            fifo->first = (fifo->first + 1) % fifo->size;
+        }
+        av_free(fifo->pkts);
+    }
+    av_free(q->fifos);
+    av_free(q->heap);
+    av_freep(&s->interleave_queue);
+}
+
 /**
  * Interleave an AVPacket correctly so it can be muxed.
  * @param out the interleaved packet will be output here
@@ -512,7 +682,7 @@ static int interleave_packet(AVFormatContext *s, AVPacket *out, AVPacket *in, in
             av_free_packet(in);
         return ret;
     } else
-        return ff_interleave_packet_per_dts(s, out, in, flush);
+        return interleave_packet_per_dts_queue(s, out, in, flush);
 }
 
 int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt)
@@ -585,6 +755,7 @@ int av_write_trailer(AVFormatContext *s)
         avio_flush(s->pb);
 
 fail:
+    ff_interleave_queue_free(s);
     for (i = 0; i < s->nb_streams; i++) {
         av_freep(&s->streams[i]->priv_data);
         av_freep(&s->streams[i]->index_entries);
@@ -387,28 +387,45 @@ void ff_rtp_send_punch_packets(URLContext *rtp_handle)
     av_free(buf);
 }
 
+/**
+ * Return the queued packet with sequence number seq, or NULL.
+ */
+static RTPPacket *queued_packet(RTPDemuxContext *s, uint16_t seq)
+{
+    RTPPacket *pkt;
+
+    if (!s->queue)
+        return NULL;
+    pkt = &s->queue[seq & (s->queue_cap - 1)];
+    return pkt->buf && pkt->seq == seq ? pkt : NULL;
+}
+
+/**
+ * Return the queued packet following the last returned one most closely,
+ * or NULL if the queue is empty.
+ */
+static RTPPacket *first_queued_packet(RTPDemuxContext *s)
+{
+    if (!s->queue_len)
+        return NULL;
+    return queued_packet(s, s->queue_first_seq);
+}
+
 static int find_missing_packets(RTPDemuxContext *s, uint16_t *first_missing,
                                 uint16_t *missing_mask)
 {
     int i;
     uint16_t next_seq = s->seq + 1;
-    RTPPacket *pkt = s->queue;
 
-    if (!pkt || pkt->seq == next_seq)
+    if (!s->queue_len || queued_packet(s, next_seq))
         return 0;
 
     *missing_mask = 0;
     for (i = 1; i <= 16; i++) {
         uint16_t missing_seq = next_seq + i;
-        while (pkt) {
-            int16_t diff = pkt->seq - missing_seq;
-            if (diff >= 0)
-                break;
-            pkt = pkt->next;
-        }
-        if (!pkt)
+        if ((int16_t)(missing_seq - s->queue_last_seq) > 0)
             break;
-        if (pkt->seq == missing_seq)
+        if (queued_packet(s, missing_seq))
             continue;
         *missing_mask |= 1 << (i - 1);
     }
@@ -499,6 +516,24 @@ RTPDemuxContext *ff_rtp_parse_open(AVFormatContext *s1, AVStream *st,
     s->ic                  = s1;
     s->st                  = st;
     s->queue_size          = queue_size;
+    if (queue_size > 1) {
+        /* Leave room for a window of sequence numbers much larger than the
+         * number of packets held back, so that losses do not push newer
+         * packets out of it. */
+        s->queue_cap = RTP_REORDER_QUEUE_MIN_CAP;
+        while (s->queue_cap < 2 * queue_size &&
+               s->queue_cap < RTP_REORDER_QUEUE_MAX_CAP)
+            s->queue_cap <<= 1;
+        s->queue_size = FFMIN(queue_size, s->queue_cap / 2);
+        s->queue      = av_mallocz(s->queue_cap * sizeof(*s->queue));
+        s->queue_pool = av_buffer_pool_init(RTP_MAX_PACKET_LENGTH, NULL);
+        if (!s->queue || !s->queue_pool) {
+            av_free(s->queue);
+            av_buffer_pool_uninit(&s->queue_pool);
+            av_free(s);
+            return NULL;
+        }
+    }
     rtp_init_statistics(&s->statistics, 0);
     if (st) {
         switch (st->codec->codec_id) {
@@ -653,73 +688,92 @@ static int rtp_parse_packet_internal(RTPDemuxContext *s, AVPacket *pkt,
     return rv;
 }
 
+static void flush_packet_queue(RTPDemuxContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->queue_cap; i++)
+        av_buffer_unref(&s->queue[i].buf);
+    s->queue_len = 0;
+}
+
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s)
 {
-    while (s->queue) {
-        RTPPacket *next = s->queue->next;
-        av_free(s->queue->buf);
-        av_free(s->queue);
-        s->queue = next;
-    }
+    flush_packet_queue(s);
     s->seq       = 0;
-    s->queue_len = 0;
     s->prev_ret  = 0;
 }
 
-static void enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
+/**
+ * Copy a packet into the slot of its sequence number, which must be
+ * within the queue_cap sequence numbers following the last returned one.
+ */
+static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
 {
     uint16_t seq   = AV_RB16(buf + 2);
-    RTPPacket **cur = &s->queue, *packet;
+    RTPPacket *packet = &s->queue[seq & (s->queue_cap - 1)];
 
-    /* Find the correct place in the queue to insert the packet */
-    while (*cur) {
-        int16_t diff = seq - (*cur)->seq;
-        if (diff < 0)
-            break;
-        cur = &(*cur)->next;
+    if (packet->buf) {
+        /* A duplicate, the window cannot hold two packets in one slot */
+        return AVERROR_INVALIDDATA;
     }
 
-    packet = av_mallocz(sizeof(*packet));
-    if (!packet)
-        return;
+    if (len <= RTP_MAX_PACKET_LENGTH)
+        packet->buf = av_buffer_pool_get(s->queue_pool);
+    else
+        packet->buf = av_buffer_alloc(len);
+    if (!packet->buf)
+        return AVERROR(ENOMEM);
+    memcpy(packet->buf->data, buf, len);
     packet->recvtime = av_gettime();
     packet->seq      = seq;
     packet->len      = len;
-    packet->buf      = buf;
-    packet->next     = *cur;
-    *cur = packet;
+
+    if (!s->queue_len || (int16_t)(seq - s->queue_first_seq) < 0)
+        s->queue_first_seq = seq;
+    if (!s->queue_len || (int16_t)(seq - s->queue_last_seq) > 0)
+        s->queue_last_seq = seq;
     s->queue_len++;
+    s->reordered_packets++;
+    return 0;
 }
 
 static int has_next_packet(RTPDemuxContext *s)
 {
-    return s->queue && s->queue->seq == (uint16_t) (s->seq + 1);
+    return s->queue_len && queued_packet(s, s->seq + 1);
 }
 
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
 {
-    return s->queue ? s->queue->recvtime : 0;
+    RTPPacket *packet = first_queued_packet(s);
+    return packet ? packet->recvtime : 0;
 }
 
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
-    RTPPacket *next;
+    RTPPacket *packet = first_queued_packet(s);
 
-    if (s->queue_len <= 0)
+    if (!packet)
         return -1;
 
-    if (!has_next_packet(s))
+    if (packet->seq != (uint16_t) (s->seq + 1)) {
+        int missed = (uint16_t) (packet->seq - s->seq - 1);
         av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
-               "RTP: missed %d packets\n", s->queue->seq - s->seq - 1);
+               "RTP: missed %d packets\n", missed);
+        s->lost_packets += missed;
+    }
 
     /* Parse the first packet in the queue, and dequeue it */
-    rv   = rtp_parse_packet_internal(s, pkt, s->queue->buf, s->queue->len);
-    next = s->queue->next;
-    av_free(s->queue->buf);
-    av_free(s->queue);
-    s->queue = next;
-    s->queue_len--;
+    rv = rtp_parse_packet_internal(s, pkt, packet->buf->data, packet->len);
+    av_buffer_unref(&packet->buf);
+    /* The slots skipped here are behind the returned packets, so each
+     * sequence number is only scanned once. */
+    if (--s->queue_len) {
+        do {
+            s->queue_first_seq++;
+        } while (!queued_packet(s, s->queue_first_seq));
+    }
     return rv;
 }
 
@@ -769,7 +823,7 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         rtcp_update_jitter(&s->statistics, timestamp, arrival_ts);
     }
 
-    if ((s->seq == 0 && !s->queue) || s->queue_size <= 1) {
+    if ((s->seq == 0 && !s->queue_len) || s->queue_size <= 1) {
         /* First packet, or no reordering */
         return rtp_parse_packet_internal(s, pkt, buf, len);
     } else {
@@ -779,15 +833,25 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
             /* Packet older than the previously emitted one, drop */
             av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
                    "RTP: dropping old packet received too late\n");
+            s->late_packets++;
             return -1;
         } else if (diff <= 1) {
             /* Correct packet */
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
+        } else if (diff >= s->queue_cap) {
+            /* Too far ahead to fit in the window: give up on everything
+             * before it, and restart from this packet */
+            av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
+                   "RTP: jump of %d packets, flushing %d queued packets\n",
+                   diff, s->queue_len);
+            s->lost_packets += diff - 1;
+            flush_packet_queue(s);
+            return rtp_parse_packet_internal(s, pkt, buf, len);
         } else {
             /* Still missing some packet, enqueue this one. */
-            enqueue_packet(s, buf, len);
-            *bufptr = NULL;
+            if (enqueue_packet(s, buf, len) < 0)
+                return -1;
             /* Return the first enqueued packet if the queue is full,
              * even if we're missing something */
             if (s->queue_len >= s->queue_size)
@@ -822,6 +886,8 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
 void ff_rtp_parse_close(RTPDemuxContext *s)
 {
     ff_rtp_reset_packet_queue(s);
+    av_freep(&s->queue);
+    av_buffer_pool_uninit(&s->queue_pool);
     ff_srtp_free(&s->srtp);
     av_free(s);
 }
@@ -36,6 +36,8 @@ typedef struct RTPDynamicProtocolHandler RTPDynamicProtocolHandler;
 #define RTP_MAX_PACKET_LENGTH 8192
 
 #define RTP_REORDER_QUEUE_DEFAULT_SIZE 10
+#define RTP_REORDER_QUEUE_MIN_CAP 1024
+#define RTP_REORDER_QUEUE_MAX_CAP 16384
 
 #define RTP_NOTS_VALUE ((uint32_t)-1)
 
@@ -142,10 +144,9 @@ struct RTPDynamicProtocolHandler {
 
 typedef struct RTPPacket {
     uint16_t seq;
-    uint8_t *buf;
+    AVBufferRef *buf; ///< packet data, NULL if the slot is free
     int len;
     int64_t recvtime;
-    struct RTPPacket *next;
 } RTPPacket;
 
 struct RTPDemuxContext {
@@ -171,9 +172,24 @@ struct RTPDemuxContext {
 
     /** Fields for packet reordering @{ */
     int prev_ret;     ///< The return value of the actual parsing of the previous packet
-    RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
+    /**
+     * Buffered packets not yet returned, the packet with sequence number
+     * seq is stored at index seq & (queue_cap - 1). All of them are within
+     * the queue_cap sequence numbers following the last returned packet.
+     */
+    RTPPacket *queue;
+    int queue_cap;    ///< The number of slots of queue, a power of two
     int queue_len;    ///< The number of packets in queue
     int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    uint16_t queue_first_seq; ///< The lowest sequence number in queue
+    uint16_t queue_last_seq; ///< The highest sequence number in queue
+    AVBufferPool *queue_pool; ///< Storage for the queued packet data
+    /*@}*/
+
+    /** Reordering statistics @{ */
+    unsigned int late_packets;      ///< dropped because received after their successors were returned
+    unsigned int lost_packets;      ///< given up on, when returning the packets following them
+    unsigned int reordered_packets; ///< received before some packets preceding them, and buffered
     /*@}*/
 
     /* rtcp sender statistics receive */
@@ -75,7 +75,10 @@
     { "data", "Data", 0, AV_OPT_TYPE_CONST, {.i64 = 1 << AVMEDIA_TYPE_DATA}, 0, 0, DEC, "allowed_media_types" }
 
 #define RTSP_REORDERING_OPTS() \
-    { "reorder_queue_size", "Number of packets to buffer for handling of reordered packets", OFFSET(reordering_queue_size), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC }
+    { "reorder_queue_size", "Number of packets to buffer for handling of reordered packets", OFFSET(reordering_queue_size), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC }, \
+    { "rtp_late_packets", "RTP packets dropped for arriving too late (exported, read only)", OFFSET(late_packets), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, DEC }, \
+    { "rtp_lost_packets", "RTP packets given up on by the reordering queue (exported, read only)", OFFSET(lost_packets), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, DEC }, \
+    { "rtp_reordered_packets", "RTP packets buffered to restore their order (exported, read only)", OFFSET(reordered_packets), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, DEC }
 
 const AVOption ff_rtsp_options[] = {
     { "initial_pause",  "Don't start playing the stream immediately", OFFSET(initial_pause), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, DEC },
@@ -1852,6 +1855,21 @@ static int pick_stream(AVFormatContext *s, RTSPStream **rtsp_st,
     return AVERROR(EAGAIN);
 }
 
+static void update_reordering_stats(RTSPState *rt)
+{
+    int i;
+
+    rt->late_packets = rt->lost_packets = rt->reordered_packets = 0;
+    for (i = 0; i < rt->nb_rtsp_streams; i++) {
+        RTPDemuxContext *rtpctx = rt->rtsp_streams[i]->transport_priv;
+        if (!rtpctx)
+            continue;
+        rt->late_packets      += rtpctx->late_packets;
+        rt->lost_packets      += rtpctx->lost_packets;
+        rt->reordered_packets += rtpctx->reordered_packets;
+    }
+}
+
 int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
 {
     RTSPState *rt = s->priv_data;
@@ -2013,6 +2031,8 @@ redo:
         return AVERROR_INVALIDDATA;
     }
 end:
+    if (rt->transport == RTSP_TRANSPORT_RTP)
+        update_reordering_stats(rt);
     if (ret < 0)
         goto redo;
     if (ret == 1)
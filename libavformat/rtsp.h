@@ -394,6 +394,14 @@ typedef struct RTSPState {
      * Size of RTP packet reordering queue.
      */
     int reordering_queue_size;
+
+    /**
+     * Packet reordering statistics, summed over the RTP streams.
+     * Exported through AVOptions, updated by ff_rtsp_fetch_packet().
+     */
+    int64_t late_packets;
+    int64_t lost_packets;
+    int64_t reordered_packets;
 } RTSPState;
 
 #define RTSP_FLAG_FILTER_SRC  0x1    /**< Filter incoming UDP packets -
@@ -68,13 +68,19 @@ int main(int argc, char **argv)
     /* initialize libavcodec, and register all codecs and formats */
     av_register_all();
 
-    if (argc != 2) {
-        printf("usage: %s input_file\n"
+    if (argc < 2) {
+        printf("usage: %s input_file [option=value ...]\n"
                "\n", argv[0]);
         return 1;
     }
 
     filename = argv[1];
+    for (i = 2; i < argc; i++) {
+        if (av_dict_parse_string(&format_opts, argv[i], "=", ":", 0) < 0) {
+            fprintf(stderr, "invalid option %s\n", argv[i]);
+            return 1;
+        }
+    }
 
     ret = avformat_open_input(&ic, filename, NULL, &format_opts);
     av_dict_free(&format_opts);
@@ -24,23 +24,39 @@
  * UDP protocol
  */
 
-#define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+/* Needed for using struct ip_mreq with recent glibc, and for recvmmsg()
+ * and sendmmsg() */
+#define _GNU_SOURCE
 
 #include "avformat.h"
 #include "avio_internal.h"
+#include "libavutil/fifo.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
+#include "libavutil/time.h"
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
 #include "url.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
 #endif
 
+#define UDP_TX_BUF_SIZE 32768
+#define UDP_MAX_PKT_SIZE 65536
+#define UDP_RX_BATCH     16     ///< datagrams received at once by the receive thread
+#define UDP_TX_MAX_BATCH 64
+
 typedef struct {
+    const AVClass *class;
     int udp_fd;
     int ttl;
     int buffer_size;
@@ -50,10 +66,36 @@ typedef struct {
     struct sockaddr_storage dest_addr;
     int dest_addr_len;
     int is_connected;
-} UDPContext;
 
-#define UDP_TX_BUF_SIZE 32768
-#define UDP_MAX_PKT_SIZE 65536
+    /* Receive thread, storing each datagram in the FIFO as its size
+     * followed by its data. The FIFO and the counters are protected
+     * by the mutex. */
+    int fifo_size;
+    int overrun_nonfatal;
+    AVFifoBuffer *fifo;
+    uint8_t *rx_buf;            ///< UDP_RX_BATCH datagrams of UDP_MAX_PKT_SIZE bytes
+    int rx_len[UDP_RX_BATCH];
+    int thread_ret;
+    int close_req;
+    unsigned int overruns;      ///< datagrams dropped because the FIFO was full
+    unsigned int kernel_overruns; ///< datagrams dropped by the socket, if known
+#if HAVE_PTHREADS
+    pthread_t thread;
+    int thread_started;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+
+    /* Copies of the counters above, exported through AVOptions */
+    int64_t fifo_overruns;
+    int64_t kernel_drops;
+
+    /* Datagrams waiting to be sent with a single sendmmsg() call */
+    int tx_batch;
+    uint8_t *tx_buf;            ///< tx_batch slots of max_packet_size bytes
+    int tx_len[UDP_TX_MAX_BATCH];
+    int tx_count;
+} UDPContext;
 
 static void log_net_error(void *ctx, int level, const char* prefix)
 {
@@ -378,6 +420,233 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if HAVE_PTHREADS
+/**
+ * Receive up to UDP_RX_BATCH pending datagrams into rx_buf.
+ * @return the number of datagrams received, or a negative error code
+ */
+static int udp_receive_batch(UDPContext *s)
+{
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_RX_BATCH] = { { { 0 } } };
+    struct iovec iov[UDP_RX_BATCH];
+#ifdef SO_RXQ_OVFL
+    uint8_t control[UDP_RX_BATCH][CMSG_SPACE(sizeof(uint32_t))];
+#endif
+    int i, n;
+
+    for (i = 0; i < UDP_RX_BATCH; i++) {
+        iov[i].iov_base = s->rx_buf + i * UDP_MAX_PKT_SIZE;
+        iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        msgs[i].msg_hdr.msg_iov    = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef SO_RXQ_OVFL
+        msgs[i].msg_hdr.msg_control    = control[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+#endif
+    }
+    n = recvmmsg(s->udp_fd, msgs, UDP_RX_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0)
+        return ff_neterrno();
+
+    for (i = 0; i < n; i++) {
+#ifdef SO_RXQ_OVFL
+        struct cmsghdr *cmsg;
+        for (cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type  == SO_RXQ_OVFL) {
+                uint32_t drops;
+                memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                s->kernel_overruns = drops;
+            }
+        }
+#endif
+        s->rx_len[i] = msgs[i].msg_len;
+    }
+    return n;
+#else
+    int ret = recv(s->udp_fd, s->rx_buf, UDP_MAX_PKT_SIZE, 0);
+    if (ret < 0)
+        return ff_neterrno();
+    s->rx_len[0] = ret;
+    return 1;
+#endif
+}
+
+static void *udp_receive_thread(void *arg)
+{
+    URLContext *h = arg;
+    UDPContext *s = h->priv_data;
+    int i, was_empty, ret = 0;
+
+    while (1) {
+        pthread_mutex_lock(&s->mutex);
+        if (s->close_req) {
+            pthread_mutex_unlock(&s->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&s->mutex);
+
+        ret = ff_network_wait_fd(s->udp_fd, 0);
+        if (ret >= 0)
+            ret = udp_receive_batch(s);
+        if (ret == AVERROR(EAGAIN))
+            continue;
+        if (ret < 0)
+            break;
+
+        pthread_mutex_lock(&s->mutex);
+        was_empty = !av_fifo_size(s->fifo);
+        for (i = 0; i < ret; i++) {
+            uint8_t len[4];
+
+            if (av_fifo_space(s->fifo) < s->rx_len[i] + 4) {
+                s->overruns++;
+                if (s->overrun_nonfatal)
+                    continue;
+                av_log(h, AV_LOG_ERROR, "FIFO overrun, increase fifo_size "
+                       "or set overrun_nonfatal to drop the datagrams "
+                       "that don't fit\n");
+                s->thread_ret = AVERROR(EIO);
+                break;
+            }
+            AV_WL32(len, s->rx_len[i]);
+            av_fifo_generic_write(s->fifo, len, 4, NULL);
+            av_fifo_generic_write(s->fifo, s->rx_buf + i * UDP_MAX_PKT_SIZE,
+                                  s->rx_len[i], NULL);
+        }
+        /* the reader only waits for an empty FIFO */
+        if (was_empty || s->thread_ret)
+            pthread_cond_signal(&s->cond);
+        if (s->thread_ret) {
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
+        }
+        pthread_mutex_unlock(&s->mutex);
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    s->thread_ret = ret < 0 ? ret : AVERROR_EOF;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static int udp_start_thread(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int ret;
+
+#ifdef SO_RXQ_OVFL
+    {
+        int on = 1;
+        if (setsockopt(s->udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+            log_net_error(h, AV_LOG_VERBOSE, "setsockopt(SO_RXQ_OVFL)");
+    }
+#endif
+
+    s->fifo   = av_fifo_alloc(s->fifo_size);
+    s->rx_buf = av_malloc(UDP_RX_BATCH * UDP_MAX_PKT_SIZE);
+    if (!s->fifo || !s->rx_buf) {
+        av_fifo_free(s->fifo);
+        s->fifo = NULL;
+        av_freep(&s->rx_buf);
+        return AVERROR(ENOMEM);
+    }
+
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    ret = pthread_create(&s->thread, NULL, udp_receive_thread, h);
+    if (ret) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->mutex);
+        av_fifo_free(s->fifo);
+        s->fifo = NULL;
+        av_freep(&s->rx_buf);
+        return AVERROR(ret);
+    }
+    s->thread_started = 1;
+    return 0;
+}
+
+static int udp_read_fifo(URLContext *h, uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+    int ret = AVERROR(EAGAIN);
+
+    pthread_mutex_lock(&s->mutex);
+    if (!av_fifo_size(s->fifo) && !s->thread_ret &&
+        !(h->flags & AVIO_FLAG_NONBLOCK)) {
+        /* wait as long as ff_network_wait_fd() would */
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+    }
+    if (av_fifo_size(s->fifo)) {
+        uint8_t len[4];
+        int avail;
+
+        av_fifo_generic_read(s->fifo, len, 4, NULL);
+        avail = AV_RL32(len);
+        ret   = FFMIN(avail, size);
+        av_fifo_generic_read(s->fifo, buf, ret, NULL);
+        av_fifo_drain(s->fifo, avail - ret);
+    } else if (s->thread_ret) {
+        ret = s->thread_ret;
+    }
+    s->fifo_overruns = s->overruns;
+    s->kernel_drops  = s->kernel_overruns;
+    pthread_mutex_unlock(&s->mutex);
+
+    return ret;
+}
+#endif
+
+#if HAVE_SENDMMSG
+static int udp_flush_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    struct mmsghdr msgs[UDP_TX_MAX_BATCH] = { { { 0 } } };
+    struct iovec iov[UDP_TX_MAX_BATCH];
+    int i, ret = 0, sent = 0;
+
+    for (i = 0; i < s->tx_count; i++) {
+        iov[i].iov_base = s->tx_buf + i * h->max_packet_size;
+        iov[i].iov_len  = s->tx_len[i];
+        msgs[i].msg_hdr.msg_iov    = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (!s->is_connected) {
+            msgs[i].msg_hdr.msg_name    = &s->dest_addr;
+            msgs[i].msg_hdr.msg_namelen = s->dest_addr_len;
+        }
+    }
+
+    while (sent < s->tx_count) {
+        ret = ff_network_wait_fd(s->udp_fd, 1);
+        if (ret >= 0) {
+            ret = sendmmsg(s->udp_fd, msgs + sent, s->tx_count - sent, 0);
+            if (ret < 0)
+                ret = ff_neterrno();
+            else
+                sent += ret;
+        }
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR(EINTR)) {
+            if (ff_check_interrupt(&h->interrupt_callback)) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+        } else if (ret < 0) {
+            break;
+        }
+    }
+    s->tx_count = 0;
+    return ret < 0 ? ret : 0;
+}
+#endif
+
 /* put it in UDP context */
 /* return non zero if error */
 static int udp_open(URLContext *h, const char *uri, int flags)
@@ -430,6 +699,15 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
+        if (av_find_info_tag(buf, sizeof(buf), "fifo_size", p)) {
+            s->fifo_size = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "overrun_nonfatal", p)) {
+            s->overrun_nonfatal = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "tx_batch", p)) {
+            s->tx_batch = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p))
             include = 1;
         if (include || av_find_info_tag(buf, sizeof(buf), "block", p)) {
@@ -552,6 +830,32 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         av_free(sources[i]);
 
     s->udp_fd = udp_fd;
+
+    if (is_output && s->tx_batch > 1) {
+#if HAVE_SENDMMSG
+        s->tx_batch = FFMIN(s->tx_batch, UDP_TX_MAX_BATCH);
+        s->tx_buf   = av_malloc(s->tx_batch * h->max_packet_size);
+        if (!s->tx_buf) {
+            closesocket(udp_fd);
+            return AVERROR(ENOMEM);
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "tx_batch is not supported on this platform\n");
+#endif
+    }
+
+    if (!is_output && s->fifo_size > 0) {
+#if HAVE_PTHREADS
+        int ret;
+
+        if ((ret = udp_start_thread(h)) < 0) {
+            closesocket(udp_fd);
+            return ret;
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "fifo_size is not supported without threads\n");
+#endif
+    }
     return 0;
  fail:
     if (udp_fd >= 0)
@@ -566,6 +870,11 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     UDPContext *s = h->priv_data;
     int ret;
 
+#if HAVE_PTHREADS
+    if (s->fifo)
+        return udp_read_fifo(h, buf, size);
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -580,6 +889,21 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
     UDPContext *s = h->priv_data;
     int ret;
 
+#if HAVE_SENDMMSG
+    if (s->tx_buf) {
+        if (size <= h->max_packet_size) {
+            memcpy(s->tx_buf + s->tx_count * h->max_packet_size, buf, size);
+            s->tx_len[s->tx_count++] = size;
+            if (s->tx_count == s->tx_batch && (ret = udp_flush_batch(h)) < 0)
+                return ret;
+            return size;
+        }
+        /* too large for a slot, keep the order and send it on its own */
+        if (s->tx_count && (ret = udp_flush_batch(h)) < 0)
+            return ret;
+    }
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
@@ -600,12 +924,49 @@ static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
 
+#if HAVE_SENDMMSG
+    if (s->tx_count)
+        udp_flush_batch(h);
+    av_freep(&s->tx_buf);
+#endif
+#if HAVE_PTHREADS
+    if (s->thread_started) {
+        pthread_mutex_lock(&s->mutex);
+        s->close_req = 1;
+        pthread_mutex_unlock(&s->mutex);
+        pthread_join(s->thread, NULL);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->mutex);
+    }
+    av_fifo_free(s->fifo);
+    av_freep(&s->rx_buf);
+#endif
+
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr);
     closesocket(s->udp_fd);
     return 0;
 }
 
+#define OFFSET(x) offsetof(UDPContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "fifo_size", "Size in bytes of the FIFO filled by a receive thread, 0 to receive on the calling thread", OFFSET(fifo_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "overrun_nonfatal", "Drop the datagrams that don't fit in the FIFO instead of failing", OFFSET(overrun_nonfatal), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D },
+    { "tx_batch", "Number of datagrams to send with a single system call", OFFSET(tx_batch), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, UDP_TX_MAX_BATCH, E },
+    { "fifo_overruns", "Datagrams dropped because the FIFO was full (exported, read only)", OFFSET(fifo_overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "kernel_drops", "Datagrams dropped by the socket receive buffer (exported, read only)", OFFSET(kernel_drops), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { NULL }
+};
+
+static const AVClass udp_context_class = {
+    .class_name = "udp",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 URLProtocol ff_udp_protocol = {
     .name                = "udp",
     .url_open            = udp_open,
@@ -614,5 +975,6 @@ URLProtocol ff_udp_protocol = {
     .url_close           = udp_close,
     .url_get_file_handle = udp_get_file_handle,
     .priv_data_size      = sizeof(UDPContext),
+    .priv_data_class     = &udp_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
 };
@@ -88,6 +88,15 @@ typedef struct URLProtocol {
     const AVClass *priv_data_class;
     int flags;
     int (*url_check)(URLContext *h, int mask);
+    /**
+     * Return a reference to size bytes of the resource starting at pos,
+     * followed by FF_INPUT_BUFFER_PADDING_SIZE readable bytes, without
+     * copying them. The read position is not changed.
+     * Return size on success, 0 if the data cannot be referenced, or a
+     * negative AVERROR code on failure.
+     */
+    int (*url_read_ref)(URLContext *h, int64_t pos, int size,
+                        AVBufferRef **buf, uint8_t **data);
 } URLProtocol;
 
 /**
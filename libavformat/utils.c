@@ -278,6 +278,52 @@ int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+/**
+ * Return 1 if the decoders of codec_id never look at the packet padding,
+ * so that it does not need to be zeroed.
+ */
+static int zerocopy_codec(enum AVCodecID codec_id)
+{
+    if (codec_id >= AV_CODEC_ID_PCM_S16LE && codec_id < AV_CODEC_ID_ADPCM_IMA_QT)
+        return 1;
+
+    switch (codec_id) {
+    case AV_CODEC_ID_RAWVIDEO:
+    case AV_CODEC_ID_V210:
+    case AV_CODEC_ID_V210X:
+    case AV_CODEC_ID_V410:
+    case AV_CODEC_ID_R210:
+    case AV_CODEC_ID_DNXHD:
+    case AV_CODEC_ID_PRORES:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int ff_get_packet_ref(AVIOContext *s, AVStream *st, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf;
+    uint8_t *data;
+    int64_t pos;
+    int ret;
+
+    if (!s->buffer_ref || !zerocopy_codec(st->codec->codec_id))
+        return av_get_packet(s, pkt, size);
+
+    pos = avio_tell(s);
+    ret = ffio_read_ref(s, size, &buf, &data);
+    if (ret <= 0)
+        return ret < 0 ? ret : av_get_packet(s, pkt, size);
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 
 int av_filename_number_test(const char *filename)
 {
@@ -531,6 +577,11 @@ int avformat_open_input(AVFormatContext **ps, const char *filename, AVInputForma
     if ((ret = init_input(s, filename, &tmp)) < 0)
         goto fail;
 
+    if (s->pb && s->flags & AVFMT_FLAG_ZEROCOPY &&
+        !(s->flags & AVFMT_FLAG_CUSTOM_IO) &&
+        (ret = ffio_enable_buffer_ref(s->pb)) < 0)
+        goto fail;
+
     /* check filename in case an image number is expected */
     if (s->iformat->flags & AVFMT_NEEDNUMBER) {
         if (!av_filename_number_test(filename)) {
@@ -2666,6 +2717,7 @@ void avformat_free_context(AVFormatContext *s)
     }
     av_freep(&s->programs);
     av_freep(&s->priv_data);
+    ff_interleave_queue_free(s);
     while(s->nb_chapters--) {
         av_dict_free(&s->chapters[s->nb_chapters]->metadata);
         av_free(s->chapters[s->nb_chapters]);
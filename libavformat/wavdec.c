@@ -377,7 +377,7 @@ static int wav_read_packet(AVFormatContext *s,
         size = (size / st->codec->block_align) * st->codec->block_align;
     }
     size = FFMIN(size, left);
-    ret  = av_get_packet(s->pb, pkt, size);
+    ret  = ff_get_packet_ref(s->pb, st, pkt, size);
     if (ret < 0)
         return ret;
     pkt->stream_index = 0;
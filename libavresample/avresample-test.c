@@ -30,6 +30,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
 #include "avresample.h"
 
 static double dbl_rand(AVLFG *lfg)
@@ -185,6 +186,78 @@ static const uint64_t layouts[] = {
     AV_CH_LAYOUT_7POINT1,
 };
 
+static const uint64_t bench_layouts[] = {
+    AV_CH_LAYOUT_MONO,
+    AV_CH_LAYOUT_STEREO,
+    AV_CH_LAYOUT_5POINT1,
+    AV_CH_LAYOUT_7POINT1,
+    (1ULL << 16) - 1,       /* 16 discrete channels */
+};
+
+#define BENCH_RUNS 4
+
+/* resample planar float from 44100 Hz to 48000 Hz for each layout in
+   bench_layouts and report the throughput */
+static int benchmark(AVAudioResampleContext *s, AVLFG *rnd,
+                     uint8_t *in_buf, uint8_t *out_buf)
+{
+    uint8_t  *in_data[AVRESAMPLE_MAX_CHANNELS] = { 0 };
+    uint8_t *out_data[AVRESAMPLE_MAX_CHANNELS] = { 0 };
+    const enum AVSampleFormat fmt = AV_SAMPLE_FMT_FLTP;
+    const int in_rate  = 44100;
+    const int out_rate = 48000;
+    const int in_samples  = in_rate  * 3;
+    const int out_samples = out_rate * 3;
+    int in_linesize, out_linesize;
+    int i, j, ret;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(bench_layouts); i++) {
+        uint64_t layout = bench_layouts[i];
+        int channels    = av_get_channel_layout_nb_channels(layout);
+        int64_t elapsed = 0;
+
+        ret = av_samples_fill_arrays(in_data, &in_linesize, in_buf, channels,
+                                     in_samples, fmt, 0);
+        if (ret < 0)
+            return ret;
+        ret = av_samples_fill_arrays(out_data, &out_linesize, out_buf,
+                                     channels, out_samples, fmt, 0);
+        if (ret < 0)
+            return ret;
+        audiogen(rnd, (void **)in_data, fmt, channels, in_rate, in_samples);
+
+        av_opt_set_int(s, "in_channel_layout",   layout,   0);
+        av_opt_set_int(s, "out_channel_layout",  layout,   0);
+        av_opt_set_int(s, "in_sample_fmt",       fmt,      0);
+        av_opt_set_int(s, "out_sample_fmt",      fmt,      0);
+        av_opt_set_int(s, "internal_sample_fmt", fmt,      0);
+        av_opt_set_int(s, "in_sample_rate",      in_rate,  0);
+        av_opt_set_int(s, "out_sample_rate",     out_rate, 0);
+
+        for (j = 0; j < BENCH_RUNS; j++) {
+            int64_t start;
+
+            ret = avresample_open(s);
+            if (ret < 0)
+                return ret;
+            start = av_gettime();
+            ret = avresample_convert(s, out_data, out_linesize, out_samples,
+                                        in_data,  in_linesize,  in_samples);
+            elapsed += av_gettime() - start;
+            avresample_close(s);
+            if (ret < 0)
+                return ret;
+        }
+
+        elapsed = FFMAX(elapsed, 1);
+        av_log(NULL, AV_LOG_INFO, "%2d channels: %10.0f samples/s per channel, "
+               "%11.0f samples/s total\n", channels,
+               BENCH_RUNS * in_samples * 1000000.0 / elapsed,
+               BENCH_RUNS * in_samples * 1000000.0 * channels / elapsed);
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     AVAudioResampleContext *s;
@@ -208,6 +281,7 @@ int main(int argc, char **argv)
     int out_rate;
     int num_formats, num_rates, num_layouts;
     int i, j, k, l, m, n;
+    int bench = 0;
 
     num_formats = 2;
     num_rates   = 2;
@@ -216,11 +290,15 @@ int main(int argc, char **argv)
         if (!av_strncasecmp(argv[1], "-h", 3)) {
             av_log(NULL, AV_LOG_INFO, "Usage: avresample-test [<num formats> "
                    "[<num sample rates> [<num channel layouts>]]]\n"
+                   "       avresample-test -bench\n"
                    "Default is 2 2 2\n");
             return 0;
         }
-        num_formats = strtol(argv[1], NULL, 0);
-        num_formats = av_clip(num_formats, 1, FF_ARRAY_ELEMS(formats));
+        if (!av_strncasecmp(argv[1], "-bench", 7))
+            bench = 1;
+        else
+            num_formats = av_clip(strtol(argv[1], NULL, 0), 1,
+                                  FF_ARRAY_ELEMS(formats));
     }
     if (argc > 2) {
         num_rates = strtol(argv[2], NULL, 0);
@@ -231,7 +309,7 @@ int main(int argc, char **argv)
         num_layouts = av_clip(num_layouts, 1, FF_ARRAY_ELEMS(layouts));
     }
 
-    av_log_set_level(AV_LOG_DEBUG);
+    av_log_set_level(bench ? AV_LOG_INFO : AV_LOG_DEBUG);
 
     av_lfg_init(&rnd, 0xC0FFEE);
 
@@ -253,6 +331,15 @@ int main(int argc, char **argv)
         goto end;
     }
 
+    if (bench) {
+        ret = benchmark(s, &rnd, in_buf, out_buf);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Benchmark failed\n");
+            ret = 1;
+        }
+        goto end;
+    }
+
     for (i = 0; i < num_formats; i++) {
         in_fmt = formats[i];
         for (k = 0; k < num_layouts; k++) {
@@ -44,9 +44,11 @@ struct ResampleContext {
     int kaiser_beta;
     double factor;
     void (*set_filter)(void *filter, double *tab, int phase, int tap_count);
-    void (*resample_one)(struct ResampleContext *c, int no_filter, void *dst0,
-                         int dst_index, const void *src0, int src_size,
-                         int index, int frac);
+    void (*resample_one)(struct ResampleContext *c, int no_filter, void **dst0,
+                         int dst_index, const void **src0, int channels,
+                         int src_size, int index, int frac);
+    ResampleDSPContext dsp;
+    int dsp_length;     ///< filter taps handled by dsp, the rest is done in C
 };
 
 
@@ -69,6 +71,46 @@ struct ResampleContext {
 #include "resample_template.c"
 
 
+static void resample_dsp_init_c(ResampleDSPContext *dsp,
+                                enum AVSampleFormat sample_fmt)
+{
+    switch (sample_fmt) {
+    case AV_SAMPLE_FMT_DBLP:
+        dsp->resample_filter = resample_filter_dbl;
+        dsp->resample_linear = resample_linear_dbl;
+        break;
+    case AV_SAMPLE_FMT_FLTP:
+        dsp->resample_filter = resample_filter_flt;
+        dsp->resample_linear = resample_linear_flt;
+        break;
+    case AV_SAMPLE_FMT_S32P:
+        dsp->resample_filter = resample_filter_s32;
+        dsp->resample_linear = resample_linear_s32;
+        break;
+    case AV_SAMPLE_FMT_S16P:
+        dsp->resample_filter = resample_filter_s16;
+        dsp->resample_linear = resample_linear_s16;
+        break;
+    }
+    dsp->taps_align = 1;
+}
+
+static void resample_dsp_init(ResampleContext *c,
+                              enum AVSampleFormat sample_fmt)
+{
+    resample_dsp_init_c(&c->dsp, sample_fmt);
+
+    if (ARCH_X86)
+        ff_resample_dsp_init_x86(&c->dsp, sample_fmt);
+
+    /* filters shorter than one SIMD block are done entirely in C */
+    c->dsp_length = c->filter_length & ~(c->dsp.taps_align - 1);
+    if (!c->dsp_length) {
+        resample_dsp_init_c(&c->dsp, sample_fmt);
+        c->dsp_length = c->filter_length;
+    }
+}
+
 /* 0th order modified bessel function of the first kind. */
 static double bessel(double x)
 {
@@ -193,6 +235,8 @@ ResampleContext *ff_audio_resample_init(AVAudioResampleContext *avr)
         break;
     }
 
+    resample_dsp_init(c, avr->internal_sample_fmt);
+
     felem_size = av_get_bytes_per_sample(avr->internal_sample_fmt);
     c->filter_bank = av_mallocz(c->filter_length * (phase_count + 1) * felem_size);
     if (!c->filter_bank)
@@ -329,8 +373,9 @@ reinit_fail:
     return ret;
 }
 
-static int resample(ResampleContext *c, void *dst, const void *src,
-                    int *consumed, int src_size, int dst_size, int update_ctx)
+static int resample(ResampleContext *c, void **dst, const void **src,
+                    int channels, int *consumed, int src_size, int dst_size,
+                    int update_ctx)
 {
     int dst_index;
     int index         = c->index;
@@ -352,7 +397,8 @@ static int resample(ResampleContext *c, void *dst, const void *src,
 
         if (dst) {
             for(dst_index = 0; dst_index < dst_size; dst_index++) {
-                c->resample_one(c, 1, dst, dst_index, src, 0, index2 >> 32, 0);
+                c->resample_one(c, 1, dst, dst_index, src, channels, 0,
+                                index2 >> 32, 0);
                 index2 += incr;
             }
         } else {
@@ -370,7 +416,8 @@ static int resample(ResampleContext *c, void *dst, const void *src,
                 break;
 
             if (dst)
-                c->resample_one(c, 0, dst, dst_index, src, src_size, index, frac);
+                c->resample_one(c, 0, dst, dst_index, src, channels,
+                                src_size, index, frac);
 
             frac  += dst_incr_frac;
             index += dst_incr;
@@ -408,7 +455,7 @@ static int resample(ResampleContext *c, void *dst, const void *src,
 
 int ff_audio_resample(ResampleContext *c, AudioData *dst, AudioData *src)
 {
-    int ch, in_samples, in_leftover, consumed = 0, out_samples = 0;
+    int in_samples, in_leftover, consumed = 0, out_samples = 0;
     int ret = AVERROR(EINVAL);
 
     in_samples  = src ? src->nb_samples : 0;
@@ -429,7 +476,7 @@ int ff_audio_resample(ResampleContext *c, AudioData *dst, AudioData *src)
     /* calculate output size and reallocate output buffer if needed */
     /* TODO: try to calculate this without the dummy resample() run */
     if (!dst->read_only && dst->allow_realloc) {
-        out_samples = resample(c, NULL, NULL, NULL, c->buffer->nb_samples,
+        out_samples = resample(c, NULL, NULL, 0, NULL, c->buffer->nb_samples,
                                INT_MAX, 0);
         ret = ff_audio_data_realloc(dst, out_samples);
         if (ret < 0) {
@@ -438,13 +485,11 @@ int ff_audio_resample(ResampleContext *c, AudioData *dst, AudioData *src)
         }
     }
 
-    /* resample each channel plane */
-    for (ch = 0; ch < c->buffer->channels; ch++) {
-        out_samples = resample(c, (void *)dst->data[ch],
-                               (const void *)c->buffer->data[ch], &consumed,
-                               c->buffer->nb_samples, dst->allocated_samples,
-                               ch + 1 == c->buffer->channels);
-    }
+    /* resample all channel planes together, one filter phase at a time */
+    out_samples = resample(c, (void **)dst->data,
+                           (const void **)c->buffer->data,
+                           c->buffer->channels, &consumed,
+                           c->buffer->nb_samples, dst->allocated_samples, 1);
     if (out_samples < 0) {
         av_log(c->avr, AV_LOG_ERROR, "error during resampling\n");
         return out_samples;
@@ -25,6 +25,43 @@
 #include "internal.h"
 #include "audio_data.h"
 
+typedef struct ResampleDSPContext {
+    /**
+     * Apply one filter phase to the source samples.
+     *
+     * The accumulator has the intermediate type of the sample format:
+     * int32_t for s16, int64_t for s32, float for flt and double for dbl.
+     *
+     * @param acc    accumulator output
+     * @param src    source samples
+     * @param filter filter taps
+     * @param len    number of taps
+     *               constraints: multiple of taps_align
+     */
+    void (*resample_filter)(void *acc, const void *src, const void *filter,
+                            int len);
+
+    /**
+     * Apply two adjacent filter phases to the source samples, for linear
+     * interpolation between them.
+     *
+     * @param acc    accumulator output, acc[0] for filter and acc[1] for
+     *               filter + stride
+     * @param src    source samples
+     * @param filter filter taps
+     * @param stride distance between the two phases, in taps
+     * @param len    number of taps
+     *               constraints: multiple of taps_align
+     */
+    void (*resample_linear)(void *acc, const void *src, const void *filter,
+                            int stride, int len);
+
+    int taps_align;     ///< len constraint for the filter functions
+} ResampleDSPContext;
+
+void ff_resample_dsp_init_x86(ResampleDSPContext *dsp,
+                              enum AVSampleFormat sample_fmt);
+
 /**
  * Allocate and initialize a ResampleContext.
  *
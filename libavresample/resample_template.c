@@ -48,39 +48,87 @@
 #define DBL_TO_FELEM(d, v) d = av_clip_int16(lrint(v * (1 << 15)))
 #endif
 
+static void SET_TYPE(resample_filter)(void *acc, const void *src0,
+                                      const void *filter0, int len)
+{
+    const FELEM *src    = src0;
+    const FELEM *filter = filter0;
+    FELEM2 val = 0;
+    int i;
+
+    for (i = 0; i < len; i++)
+        val += src[i] * (FELEM2)filter[i];
+    *(FELEM2 *)acc = val;
+}
+
+static void SET_TYPE(resample_linear)(void *acc, const void *src0,
+                                      const void *filter0, int stride, int len)
+{
+    const FELEM *src    = src0;
+    const FELEM *filter = filter0;
+    FELEM2 val = 0, v2 = 0;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        val += src[i] * (FELEM2)filter[i];
+        v2  += src[i] * (FELEM2)filter[i + stride];
+    }
+    ((FELEM2 *)acc)[0] = val;
+    ((FELEM2 *)acc)[1] = v2;
+}
+
 static void SET_TYPE(resample_one)(ResampleContext *c, int no_filter,
-                                   void *dst0, int dst_index, const void *src0,
+                                   void **dst0, int dst_index,
+                                   const void **src0, int channels,
                                    int src_size, int index, int frac)
 {
-    FELEM *dst = dst0;
-    const FELEM *src = src0;
+    int ch;
 
     if (no_filter) {
-        dst[dst_index] = src[index];
+        for (ch = 0; ch < channels; ch++) {
+            FELEM *dst = dst0[ch];
+            const FELEM *src = src0[ch];
+            dst[dst_index] = src[index];
+        }
     } else {
         int i;
         int sample_index = index >> c->phase_shift;
-        FELEM2 val = 0;
         FELEM *filter = ((FELEM *)c->filter_bank) +
                         c->filter_length * (index & c->phase_mask);
 
-        if (sample_index < 0) {
-            for (i = 0; i < c->filter_length; i++)
-                val += src[FFABS(sample_index + i) % src_size] *
-                       (FELEM2)filter[i];
-        } else if (c->linear) {
-            FELEM2 v2 = 0;
-            for (i = 0; i < c->filter_length; i++) {
-                val += src[abs(sample_index + i)] * (FELEM2)filter[i];
-                v2  += src[abs(sample_index + i)] * (FELEM2)filter[i + c->filter_length];
+        /* all channels use the same filter phase, so its taps are loaded
+           once and stay in cache for the remaining planes */
+        for (ch = 0; ch < channels; ch++) {
+            FELEM *dst = dst0[ch];
+            const FELEM *src = src0[ch];
+            FELEM2 val = 0;
+
+            if (sample_index < 0) {
+                for (i = 0; i < c->filter_length; i++)
+                    val += src[FFABS(sample_index + i) % src_size] *
+                           (FELEM2)filter[i];
+            } else if (c->linear) {
+                FELEM2 acc[2];
+                FELEM2 v2;
+                src += sample_index;
+                c->dsp.resample_linear(acc, src, filter, c->filter_length,
+                                       c->dsp_length);
+                val = acc[0];
+                v2  = acc[1];
+                for (i = c->dsp_length; i < c->filter_length; i++) {
+                    val += src[i] * (FELEM2)filter[i];
+                    v2  += src[i] * (FELEM2)filter[i + c->filter_length];
+                }
+                val += (v2 - val) * (FELEML)frac / c->src_incr;
+            } else {
+                src += sample_index;
+                c->dsp.resample_filter(&val, src, filter, c->dsp_length);
+                for (i = c->dsp_length; i < c->filter_length; i++)
+                    val += src[i] * (FELEM2)filter[i];
             }
-            val += (v2 - val) * (FELEML)frac / c->src_incr;
-        } else {
-            for (i = 0; i < c->filter_length; i++)
-                val += src[sample_index + i] * (FELEM2)filter[i];
-        }
 
-        OUT(dst[dst_index], val);
+            OUT(dst[dst_index], val);
+        }
     }
 }
 
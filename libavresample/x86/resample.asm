@@ -0,0 +1,250 @@
+;******************************************************************************
+;* x86 optimized resampling filters
+;*
+;* This file is part of Libav.
+;*
+;* Libav is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* Libav is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with Libav; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_TEXT
+
+; Source samples and filter phases start at arbitrary sample offsets, so all
+; loads are unaligned. len is a multiple of mmsize / sample size and non-zero.
+
+; sum the floats in m%1 and store the result to %3, m%2 is clobbered
+%macro HSUM_PS_STORE 3
+%if mmsize == 32
+    vextractf128   xm%2, m%1, 1
+    vaddps         xm%1, xm%1, xm%2
+    vmovhlps       xm%2, xm%2, xm%1
+    vaddps         xm%1, xm%1, xm%2
+    vmovshdup      xm%2, xm%1
+    vaddss         xm%1, xm%1, xm%2
+    vmovss           %3, xm%1
+%else
+    movhlps         m%2, m%1
+    addps           m%1, m%2
+    movaps          m%2, m%1
+    shufps          m%2, m%2, q0001
+    addss           m%1, m%2
+    movss            %3, m%1
+%endif
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_resample_filter_flt(float *acc, const float *src,
+;                             const float *filter, int len);
+;------------------------------------------------------------------------------
+
+%macro RESAMPLE_FILTER_FLT 0
+cglobal resample_filter_flt, 4,4,3, acc, src, filter, len
+    movsxdifnidn   lenq, lend
+    lea            srcq, [srcq+lenq*4]
+    lea         filterq, [filterq+lenq*4]
+    neg            lenq
+    xorps            m0, m0
+.loop:
+    movu             m1, [srcq+lenq*4]
+%if cpuflag(avx)
+    fmaddps          m0, m1, [filterq+lenq*4], m0, m2
+%else
+    movu             m2, [filterq+lenq*4]
+    mulps            m1, m2
+    addps            m0, m1
+%endif
+    add            lenq, mmsize/4
+    jl .loop
+    HSUM_PS_STORE 0, 1, [accq]
+    RET
+%endmacro
+
+INIT_XMM sse
+RESAMPLE_FILTER_FLT
+INIT_YMM avx
+RESAMPLE_FILTER_FLT
+%if HAVE_FMA3_EXTERNAL
+INIT_YMM fma3
+RESAMPLE_FILTER_FLT
+%endif
+
+;------------------------------------------------------------------------------
+; void ff_resample_linear_flt(float *acc, const float *src,
+;                             const float *filter, int stride, int len);
+;
+; acc[0] gets the dot product with filter, acc[1] with filter + stride.
+;------------------------------------------------------------------------------
+
+%macro RESAMPLE_LINEAR_FLT 0
+cglobal resample_linear_flt, 5,5,4, acc, src, filter, filter2, len
+    movsxdifnidn   lenq, lend
+    movsxdifnidn filter2q, filter2d
+    lea        filter2q, [filterq+filter2q*4]
+    lea            srcq, [srcq+lenq*4]
+    lea         filterq, [filterq+lenq*4]
+    lea        filter2q, [filter2q+lenq*4]
+    neg            lenq
+    xorps            m0, m0
+    xorps            m3, m3
+.loop:
+    movu             m1, [srcq+lenq*4]
+%if cpuflag(avx)
+    fmaddps          m0, m1, [filterq +lenq*4], m0, m2
+    fmaddps          m3, m1, [filter2q+lenq*4], m3, m2
+%else
+    movu             m2, [filterq+lenq*4]
+    mulps            m2, m1
+    addps            m0, m2
+    movu             m2, [filter2q+lenq*4]
+    mulps            m1, m2
+    addps            m3, m1
+%endif
+    add            lenq, mmsize/4
+    jl .loop
+    HSUM_PS_STORE 0, 1, [accq]
+    HSUM_PS_STORE 3, 2, [accq+4]
+    RET
+%endmacro
+
+INIT_XMM sse
+RESAMPLE_LINEAR_FLT
+INIT_YMM avx
+RESAMPLE_LINEAR_FLT
+%if HAVE_FMA3_EXTERNAL
+INIT_YMM fma3
+RESAMPLE_LINEAR_FLT
+%endif
+
+;------------------------------------------------------------------------------
+; void ff_resample_filter_s16(int32_t *acc, const int16_t *src,
+;                             const int16_t *filter, int len);
+; void ff_resample_linear_s16(int32_t *acc, const int16_t *src,
+;                             const int16_t *filter, int stride, int len);
+;------------------------------------------------------------------------------
+
+; sum the dwords in m%1 and store the result to %3, m%2 is clobbered
+%macro HSUM_D_STORE 3
+    pshufd          m%2, m%1, q0032
+    paddd           m%1, m%2
+    pshuflw         m%2, m%1, q0032
+    paddd           m%1, m%2
+    movd             %3, m%1
+%endmacro
+
+INIT_XMM sse2
+cglobal resample_filter_s16, 4,4,3, acc, src, filter, len
+    movsxdifnidn   lenq, lend
+    lea            srcq, [srcq+lenq*2]
+    lea         filterq, [filterq+lenq*2]
+    neg            lenq
+    pxor             m0, m0
+.loop:
+    movu             m1, [srcq+lenq*2]
+    movu             m2, [filterq+lenq*2]
+    pmaddwd          m1, m2
+    paddd            m0, m1
+    add            lenq, mmsize/2
+    jl .loop
+    HSUM_D_STORE 0, 1, [accq]
+    RET
+
+cglobal resample_linear_s16, 5,5,4, acc, src, filter, filter2, len
+    movsxdifnidn   lenq, lend
+    movsxdifnidn filter2q, filter2d
+    lea        filter2q, [filterq+filter2q*2]
+    lea            srcq, [srcq+lenq*2]
+    lea         filterq, [filterq+lenq*2]
+    lea        filter2q, [filter2q+lenq*2]
+    neg            lenq
+    pxor             m0, m0
+    pxor             m3, m3
+.loop:
+    movu             m1, [srcq+lenq*2]
+    movu             m2, [filterq+lenq*2]
+    pmaddwd          m2, m1
+    paddd            m0, m2
+    movu             m2, [filter2q+lenq*2]
+    pmaddwd          m1, m2
+    paddd            m3, m1
+    add            lenq, mmsize/2
+    jl .loop
+    HSUM_D_STORE 0, 1, [accq]
+    HSUM_D_STORE 3, 2, [accq+4]
+    RET
+
+;------------------------------------------------------------------------------
+; void ff_resample_filter_s32(int64_t *acc, const int32_t *src,
+;                             const int32_t *filter, int len);
+; void ff_resample_linear_s32(int64_t *acc, const int32_t *src,
+;                             const int32_t *filter, int stride, int len);
+;------------------------------------------------------------------------------
+
+; m%1 += 64-bit products of the dwords in m%2 and m%3, clobbers m%2, m%3 and
+; m%4
+%macro PMACSDQ 4
+    pmuldq          m%4, m%2, m%3
+    paddq           m%1, m%4
+    psrlq           m%2, 32
+    psrlq           m%3, 32
+    pmuldq          m%2, m%3
+    paddq           m%1, m%2
+%endmacro
+
+; sum the qwords in m%1 and store the result to %3, m%2 is clobbered
+%macro HSUM_Q_STORE 3
+    punpckhqdq      m%2, m%1, m%1
+    paddq           m%1, m%2
+    movq             %3, m%1
+%endmacro
+
+INIT_XMM sse4
+cglobal resample_filter_s32, 4,4,4, acc, src, filter, len
+    movsxdifnidn   lenq, lend
+    lea            srcq, [srcq+lenq*4]
+    lea         filterq, [filterq+lenq*4]
+    neg            lenq
+    pxor             m0, m0
+.loop:
+    movu             m1, [srcq+lenq*4]
+    movu             m2, [filterq+lenq*4]
+    PMACSDQ 0, 1, 2, 3
+    add            lenq, mmsize/4
+    jl .loop
+    HSUM_Q_STORE 0, 1, [accq]
+    RET
+
+cglobal resample_linear_s32, 5,5,6, acc, src, filter, filter2, len
+    movsxdifnidn   lenq, lend
+    movsxdifnidn filter2q, filter2d
+    lea        filter2q, [filterq+filter2q*4]
+    lea            srcq, [srcq+lenq*4]
+    lea         filterq, [filterq+lenq*4]
+    lea        filter2q, [filter2q+lenq*4]
+    neg            lenq
+    pxor             m0, m0
+    pxor             m4, m4
+.loop:
+    movu             m1, [srcq+lenq*4]
+    movu             m2, [filterq+lenq*4]
+    mova             m5, m1
+    PMACSDQ 0, 1, 2, 3
+    movu             m2, [filter2q+lenq*4]
+    PMACSDQ 4, 5, 2, 3
+    add            lenq, mmsize/4
+    jl .loop
+    HSUM_Q_STORE 0, 1, [accq]
+    HSUM_Q_STORE 4, 2, [accq+8]
+    RET
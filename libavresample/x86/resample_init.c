@@ -0,0 +1,69 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavresample/resample.h"
+
+#define RESAMPLE_FUNCS(fmt, opt)                                            \
+void ff_resample_filter_ ## fmt ## _ ## opt(void *acc, const void *src,     \
+                                           const void *filter, int len);    \
+void ff_resample_linear_ ## fmt ## _ ## opt(void *acc, const void *src,     \
+                                           const void *filter,              \
+                                           int stride, int len);
+
+RESAMPLE_FUNCS(flt, sse)
+RESAMPLE_FUNCS(flt, avx)
+RESAMPLE_FUNCS(flt, fma3)
+RESAMPLE_FUNCS(s16, sse2)
+RESAMPLE_FUNCS(s32, sse4)
+
+#define SET_RESAMPLE_FUNCS(fmt, opt, align)                                 \
+    do {                                                                    \
+        dsp->resample_filter = ff_resample_filter_ ## fmt ## _ ## opt;      \
+        dsp->resample_linear = ff_resample_linear_ ## fmt ## _ ## opt;      \
+        dsp->taps_align      = align;                                       \
+    } while (0)
+
+av_cold void ff_resample_dsp_init_x86(ResampleDSPContext *dsp,
+                                      enum AVSampleFormat sample_fmt)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    switch (sample_fmt) {
+    case AV_SAMPLE_FMT_FLTP:
+        if (EXTERNAL_SSE(mm_flags))
+            SET_RESAMPLE_FUNCS(flt, sse, 4);
+        if (EXTERNAL_AVX(mm_flags))
+            SET_RESAMPLE_FUNCS(flt, avx, 8);
+        if (EXTERNAL_FMA3(mm_flags))
+            SET_RESAMPLE_FUNCS(flt, fma3, 8);
+        break;
+    case AV_SAMPLE_FMT_S16P:
+        if (EXTERNAL_SSE2(mm_flags))
+            SET_RESAMPLE_FUNCS(s16, sse2, 8);
+        break;
+    case AV_SAMPLE_FMT_S32P:
+        if (EXTERNAL_SSE4(mm_flags))
+            SET_RESAMPLE_FUNCS(s32, sse4, 4);
+        break;
+    default:
+        break;
+    }
+}
@@ -86,7 +86,9 @@ struct AVBufferPool {
     volatile int refcount;
 
     int size;
+    void *opaque;
     AVBufferRef* (*alloc)(int size);
+    AVBufferRef* (*alloc2)(void *opaque, int size);
 };
 
 #endif /* AVUTIL_BUFFER_INTERNAL_H */
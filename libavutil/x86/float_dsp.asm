@@ -70,10 +70,17 @@ cglobal vector_fmac_scalar, 4,4,3, dst, src, mul, len
 %endif
     lea    lenq, [lend*4-2*mmsize]
 .loop:
+%if cpuflag(fma3)
+    mova     m1,     [dstq+lenq       ]
+    mova     m2,     [dstq+lenq+mmsize]
+    fmaddps  m1, m0, [srcq+lenq       ], m1, m1
+    fmaddps  m2, m0, [srcq+lenq+mmsize], m2, m2
+%else
     mulps    m1, m0, [srcq+lenq       ]
     mulps    m2, m0, [srcq+lenq+mmsize]
     addps    m1, m1, [dstq+lenq       ]
     addps    m2, m2, [dstq+lenq+mmsize]
+%endif
     mova  [dstq+lenq       ], m1
     mova  [dstq+lenq+mmsize], m2
     sub    lenq, 2*mmsize
@@ -85,6 +92,10 @@ INIT_XMM sse
 VECTOR_FMAC_SCALAR
 INIT_YMM avx
 VECTOR_FMAC_SCALAR
+%if HAVE_FMA3_EXTERNAL
+INIT_YMM fma3
+VECTOR_FMAC_SCALAR
+%endif
 
 ;------------------------------------------------------------------------------
 ; void ff_vector_fmul_scalar(float *dst, const float *src, float mul, int len)
@@ -168,16 +179,25 @@ VECTOR_DMUL_SCALAR
 ;                 const float *src2, int len)
 ;-----------------------------------------------------------------------------
 %macro VECTOR_FMUL_ADD 0
-cglobal vector_fmul_add, 5,5,2, dst, src0, src1, src2, len
+cglobal vector_fmul_add, 5,5,4, dst, src0, src1, src2, len
     lea       lenq, [lend*4 - 2*mmsize]
 ALIGN 16
 .loop:
+%if cpuflag(fma3)
+    mova    m0,   [src2q + lenq]
+    mova    m1,   [src2q + lenq + mmsize]
+    mova    m2,   [src0q + lenq]
+    mova    m3,   [src0q + lenq + mmsize]
+    fmaddps m0, m2, [src1q + lenq], m0, m0
+    fmaddps m1, m3, [src1q + lenq + mmsize], m1, m1
+%else
     mova    m0,   [src0q + lenq]
     mova    m1,   [src0q + lenq + mmsize]
     mulps   m0, m0, [src1q + lenq]
     mulps   m1, m1, [src1q + lenq + mmsize]
     addps   m0, m0, [src2q + lenq]
     addps   m1, m1, [src2q + lenq + mmsize]
+%endif
     mova    [dstq + lenq], m0
     mova    [dstq + lenq + mmsize], m1
 
@@ -190,6 +210,10 @@ INIT_XMM sse
 VECTOR_FMUL_ADD
 INIT_YMM avx
 VECTOR_FMUL_ADD
+%if HAVE_FMA3_EXTERNAL
+INIT_YMM fma3
+VECTOR_FMUL_ADD
+%endif
 
 ;-----------------------------------------------------------------------------
 ; void vector_fmul_reverse(float *dst, const float *src0, const float *src1,
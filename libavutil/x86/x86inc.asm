@@ -837,6 +837,29 @@ SECTION .note.GNU-stack noalloc noexec nowrite progbits
     INIT_CPUFLAGS %1
 %endmacro
 
+; xm# and ym# name the xmm and ymm views of the permuted register m#, so that
+; e.g. lane-crossing AVX2 code can address the low half of a ymm register.
+%macro DECLARE_MMCAST 1
+    %define  mmmm%1   mm%1
+    %define  mmxmm%1  mm%1
+    %define  mmymm%1  mm%1
+    %define xmmmm%1   mm%1
+    %define xmmxmm%1 xmm%1
+    %define xmmymm%1 xmm%1
+    %define ymmmm%1   mm%1
+    %define ymmxmm%1 ymm%1
+    %define ymmymm%1 ymm%1
+    %define xm%1 xmm %+ m%1
+    %define ym%1 ymm %+ m%1
+%endmacro
+
+%assign i 0
+%rep 16
+    DECLARE_MMCAST i
+%assign i i+1
+%endrep
+%undef i
+
 INIT_XMM
 
 ; I often want to use macros that permute their arguments. e.g. there's no
@@ -1257,10 +1280,31 @@ AVX_INSTR pfmul, 1, 0, 1
 %undef i
 %undef j
 
+; FMA3 has no 4-operand form, so fmaddps is only emitted as a single FMA3
+; instruction when dst is one of the sources; the second source must then be
+; a register unless dst is the addend.
 %macro FMA_INSTR 3
     %macro %1 5-8 %1, %2, %3
+        %assign __emulate_fma3 0
+        %ifidn %6, fmaddps
+            %if notcpuflag(xop) && notcpuflag(fma4) && cpuflag(fma3)
+                %ifidn %1, %4
+                    %assign __emulate_fma3 1
+                %elifidn %1, %2
+                    %assign __emulate_fma3 2
+                %elifidn %1, %3
+                    %assign __emulate_fma3 3
+                %endif
+            %endif
+        %endif
         %if cpuflag(xop) || cpuflag(fma4)
             v%6 %1, %2, %3, %4
+        %elif __emulate_fma3 == 1
+            vfmadd231ps %1, %2, %3
+        %elif __emulate_fma3 == 2
+            vfmadd213ps %1, %3, %4
+        %elif __emulate_fma3 == 3
+            vfmadd213ps %1, %2, %4
         %else
             %ifidn %1, %4
                 %7 %5, %2, %3
@@ -0,0 +1,185 @@
+/*
+ * This file is part of Libav.
+ *
+ * Libav is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Libav is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Libav; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Libswscale multithreading support
+ */
+
+#include "config.h"
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#include "swscale_internal.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "libavcodec/w32pthreads.h"
+#endif
+
+typedef struct ThreadContext {
+    SwsContext *c;
+
+    int nb_threads;
+    pthread_t *workers;
+
+    /* per-execute parameters */
+    sws_slice_func *func;
+    void *arg;
+    int nb_jobs;
+
+    pthread_cond_t last_job_cond;
+    pthread_cond_t current_job_cond;
+    pthread_mutex_t current_job_lock;
+    int current_job;
+    int done;
+} ThreadContext;
+
+static void* attribute_align_arg worker(void *v)
+{
+    ThreadContext *t = v;
+    int our_job      = t->nb_jobs;
+    int nb_threads   = t->nb_threads;
+    int self_id;
+
+    pthread_mutex_lock(&t->current_job_lock);
+    self_id = t->current_job++;
+    for (;;) {
+        while (our_job >= t->nb_jobs) {
+            if (t->current_job == nb_threads + t->nb_jobs)
+                pthread_cond_signal(&t->last_job_cond);
+
+            pthread_cond_wait(&t->current_job_cond, &t->current_job_lock);
+            our_job = self_id;
+
+            if (t->done) {
+                pthread_mutex_unlock(&t->current_job_lock);
+                return NULL;
+            }
+        }
+        pthread_mutex_unlock(&t->current_job_lock);
+
+        t->func(t->c, t->arg, our_job, t->nb_jobs);
+
+        pthread_mutex_lock(&t->current_job_lock);
+        our_job = t->current_job++;
+    }
+}
+
+static void park_workers(ThreadContext *t)
+{
+    pthread_cond_wait(&t->last_job_cond, &t->current_job_lock);
+    pthread_mutex_unlock(&t->current_job_lock);
+}
+
+static void thread_uninit(ThreadContext *t)
+{
+    int i;
+
+    pthread_mutex_lock(&t->current_job_lock);
+    t->done = 1;
+    pthread_cond_broadcast(&t->current_job_cond);
+    pthread_mutex_unlock(&t->current_job_lock);
+
+    for (i = 0; i < t->nb_threads; i++)
+         pthread_join(t->workers[i], NULL);
+
+    pthread_mutex_destroy(&t->current_job_lock);
+    pthread_cond_destroy(&t->current_job_cond);
+    pthread_cond_destroy(&t->last_job_cond);
+    av_freep(&t->workers);
+}
+
+void ff_sws_thread_execute(SwsContext *c, sws_slice_func *func, void *arg,
+                           int nb_jobs)
+{
+    ThreadContext *t = c->thread;
+    int i;
+
+    if (nb_jobs <= 0)
+        return;
+
+    if (!t) {
+        for (i = 0; i < nb_jobs; i++)
+            func(c, arg, i, nb_jobs);
+        return;
+    }
+
+    pthread_mutex_lock(&t->current_job_lock);
+
+    t->current_job = t->nb_threads;
+    t->nb_jobs     = nb_jobs;
+    t->func        = func;
+    t->arg         = arg;
+    pthread_cond_broadcast(&t->current_job_cond);
+
+    park_workers(t);
+}
+
+int ff_sws_thread_init(SwsContext *c, int nb_threads)
+{
+    ThreadContext *t;
+    int i, ret;
+
+    if (nb_threads <= 1)
+        return 1;
+
+    t = av_mallocz(sizeof(*t));
+    if (!t)
+        return AVERROR(ENOMEM);
+
+    t->workers = av_mallocz(sizeof(*t->workers) * nb_threads);
+    if (!t->workers) {
+        av_free(t);
+        return AVERROR(ENOMEM);
+    }
+
+    t->c          = c;
+    t->nb_threads = nb_threads;
+
+    pthread_cond_init(&t->current_job_cond, NULL);
+    pthread_cond_init(&t->last_job_cond,    NULL);
+
+    pthread_mutex_init(&t->current_job_lock, NULL);
+    pthread_mutex_lock(&t->current_job_lock);
+    for (i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&t->workers[i], NULL, worker, t);
+        if (ret) {
+           pthread_mutex_unlock(&t->current_job_lock);
+           t->nb_threads = i;
+           thread_uninit(t);
+           av_free(t);
+           return AVERROR(ret);
+        }
+    }
+
+    park_workers(t);
+
+    c->thread = t;
+
+    return nb_threads;
+}
+
+void ff_sws_thread_free(SwsContext *c)
+{
+    if (c->thread)
+        thread_uninit(c->thread);
+    av_freep(&c->thread);
+}
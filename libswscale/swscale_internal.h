@@ -557,6 +557,24 @@ typedef struct SwsContext {
     void (*chrConvertRange)(int16_t *dst1, int16_t *dst2, int width);
 
     int needs_hcscale; ///< Set if there are chroma planes to be converted.
+
+    int unscaled_special; ///< Set if swScale is an unscaled special converter.
+
+    /**
+     * @name Slice threading.
+     * With more than one thread, sws_scale() splits full frames into
+     * horizontal output bands which are scaled concurrently, each by its own
+     * child context. Every band context only pulls the source lines that the
+     * vertical filter taps of its output lines need.
+     */
+    //@{
+    int nb_threads;               ///< Number of threads requested by the user, 0 for auto.
+    int dstSliceY;                ///< First destination line produced by swScale().
+    int dstSliceEnd;              ///< Destination line at which swScale() stops.
+    struct SwsContext **slice_ctx; ///< Per-band contexts.
+    int nb_slice_ctx;             ///< Number of per-band contexts.
+    void *thread;                 ///< Opaque thread pool, NULL if threading is off.
+    //@}
 } SwsContext;
 //FIXME check init (where 0)
 
@@ -736,6 +754,22 @@ void ff_swscale_get_unscaled_altivec(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+typedef int (sws_slice_func)(SwsContext *c, void *arg, int jobnr, int nb_jobs);
+
+/**
+ * Start nb_threads worker threads for c.
+ * @return the number of threads actually started (1 when threading is
+ *         not available), or a negative AVERROR code
+ */
+int ff_sws_thread_init(SwsContext *c, int nb_threads);
+void ff_sws_thread_free(SwsContext *c);
+
+/**
+ * Call func nb_jobs times, concurrently if c has worker threads.
+ */
+void ff_sws_thread_execute(SwsContext *c, sws_slice_func *func, void *arg,
+                           int nb_jobs);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
@@ -1122,6 +1122,65 @@ static int check_image_pointers(uint8_t *data[4], enum AVPixelFormat pix_fmt,
     return 1;
 }
 
+typedef struct SliceArgs {
+    const uint8_t * const *src;
+    const int *srcStride;
+    uint8_t * const *dst;
+    const int *dstStride;
+} SliceArgs;
+
+/**
+ * Scale one band of output lines with the band's own context. Bands are
+ * aligned to 8 lines, which keeps chroma subsampling and the ordered
+ * dither patterns of the unscaled converters in phase.
+ */
+static int scale_band(SwsContext *c, void *arg, int jobnr, int nb_jobs)
+{
+    SliceArgs *a  = arg;
+    SwsContext *s = c->slice_ctx[jobnr];
+    int y0 = (c->dstH *  jobnr     / nb_jobs) & ~7;
+    int y1 = jobnr == nb_jobs - 1 ? c->dstH :
+             (c->dstH * (jobnr + 1) / nb_jobs) & ~7;
+    const uint8_t *src[4] = { a->src[0], a->src[1], a->src[2], a->src[3] };
+    uint8_t *dst[4]       = { a->dst[0], a->dst[1], a->dst[2], a->dst[3] };
+    int srcStride[4]      = { a->srcStride[0], a->srcStride[1],
+                              a->srcStride[2], a->srcStride[3] };
+    int dstStride[4]      = { a->dstStride[0], a->dstStride[1],
+                              a->dstStride[2], a->dstStride[3] };
+
+    if (y0 >= y1)
+        return 0;
+
+    if (usePal(c->srcFormat)) {
+        memcpy(s->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+        memcpy(s->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+    }
+
+    reset_ptr(src, c->srcFormat);
+    reset_ptr((const uint8_t **) dst, c->dstFormat);
+
+    if (s->unscaled_special) {
+        /* source and destination lines match, feed just the band */
+        src[0] += y0 * srcStride[0];
+        if (src[1] && !usePal(c->srcFormat))
+            src[1] += (y0 >> c->chrSrcVSubSample) * srcStride[1];
+        if (src[2])
+            src[2] += (y0 >> c->chrSrcVSubSample) * srcStride[2];
+        if (src[3])
+            src[3] += y0 * srcStride[3];
+
+        s->swScale(s, src, srcStride, y0, y1 - y0, dst, dstStride);
+    } else {
+        /* the whole frame is visible, swScale() skips to the source lines
+         * needed by the vertical filter taps of the first band line */
+        s->dstSliceY   = y0;
+        s->dstSliceEnd = y1;
+        s->swScale(s, src, srcStride, 0, c->srcH, dst, dstStride);
+    }
+
+    return 0;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -1220,6 +1279,14 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         }
     }
 
+    if (c->nb_slice_ctx && srcSliceY == 0 && srcSliceH == c->srcH) {
+        SliceArgs args = { srcSlice, srcStride, dst, dstStride };
+
+        c->sliceDir = 0;
+        ff_sws_thread_execute(c, scale_band, &args, c->nb_slice_ctx);
+        return c->dstH;
+    }
+
     // copy strides, so they can safely be modified
     if (c->sliceDir == 1) {
         // slices go from top to bottom
@@ -778,6 +778,12 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
 {
     const AVPixFmtDescriptor *desc_dst = av_pix_fmt_desc_get(c->dstFormat);
     const AVPixFmtDescriptor *desc_src = av_pix_fmt_desc_get(c->srcFormat);
+    int i;
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange, table,
+                                 dstRange, brightness, contrast, saturation);
+
     memcpy(c->srcColorspaceTable, inv_table, sizeof(int) * 4);
     memcpy(c->dstColorspaceTable, table, sizeof(int) * 4);
 
@@ -852,8 +858,28 @@ SwsContext *sws_alloc_context(void)
     return c;
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+#if !HAVE_THREADS
+int ff_sws_thread_init(SwsContext *c, int nb_threads)
+{
+    return 1;
+}
+
+void ff_sws_thread_free(SwsContext *c)
+{
+}
+
+void ff_sws_thread_execute(SwsContext *c, sws_slice_func *func, void *arg,
+                           int nb_jobs)
+{
+    int i;
+
+    for (i = 0; i < nb_jobs; i++)
+        func(c, arg, i, nb_jobs);
+}
+#endif
+
+static av_cold int context_init(SwsContext *c, SwsFilter *srcFilter,
+                                SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -998,6 +1024,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
         ff_get_unscaled_swscale(c);
 
         if (c->swScale) {
+            c->unscaled_special = 1;
             if (flags & SWS_PRINT_INFO)
                 av_log(c, AV_LOG_INFO,
                        "using unscaled %s -> %s special converter\n",
@@ -1292,6 +1319,96 @@ fail: // FIXME replace things by appropriate error codes
     return -1;
 }
 
+static av_cold int slice_contexts_init(SwsContext *c, SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter)
+{
+    int nb_threads = c->nb_threads;
+    int i, ret;
+
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+    /* bands are aligned to 8 lines, do not bother with tiny ones */
+    nb_threads = FFMIN(nb_threads, c->dstH / 16);
+    if (nb_threads <= 1)
+        return 0;
+
+    c->slice_ctx = av_mallocz(sizeof(*c->slice_ctx) * nb_threads);
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads; i++) {
+        SwsContext *s = sws_alloc_context();
+        if (!s)
+            return AVERROR(ENOMEM);
+        c->slice_ctx[c->nb_slice_ctx++] = s;
+
+        s->srcW      = c->srcW;
+        s->srcH      = c->srcH;
+        s->dstW      = c->dstW;
+        s->dstH      = c->dstH;
+        s->srcFormat = c->srcFormat;
+        s->dstFormat = c->dstFormat;
+        s->srcRange  = c->srcRange;
+        s->dstRange  = c->dstRange;
+        s->flags     = c->flags;
+        s->param[0]  = c->param[0];
+        s->param[1]  = c->param[1];
+
+        ret = sws_init_context(s, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+
+        sws_setColorspaceDetails(s, c->srcColorspaceTable, c->srcRange,
+                                 c->dstColorspaceTable, c->dstRange,
+                                 c->brightness, c->contrast, c->saturation);
+    }
+
+    ret = ff_sws_thread_init(c, nb_threads);
+    if (ret < 0)
+        return ret;
+    if (ret == 1) {
+        /* no threading available, fall back to scaling in one go */
+        for (i = 0; i < c->nb_slice_ctx; i++)
+            sws_freeContext(c->slice_ctx[i]);
+        av_freep(&c->slice_ctx);
+        c->nb_slice_ctx = 0;
+    }
+
+    return 0;
+}
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    int ret;
+
+    /* the same normalization sws_getContext() does, so that contexts set up
+     * through AVOptions behave the same */
+    c->srcRange |= handle_jpeg(&c->srcFormat);
+    c->dstRange |= handle_jpeg(&c->dstFormat);
+    if (!c->contrast && !c->saturation)
+        sws_setColorspaceDetails(c, ff_yuv2rgb_coeffs[SWS_CS_DEFAULT], c->srcRange,
+                                 ff_yuv2rgb_coeffs[SWS_CS_DEFAULT], c->dstRange,
+                                 0, 1 << 16, 1 << 16);
+
+    ret = context_init(c, srcFilter, dstFilter);
+    if (ret < 0)
+        return ret;
+
+    c->dstSliceY   = 0;
+    c->dstSliceEnd = c->dstH;
+
+    if (c->nb_threads != 1) {
+        ret = slice_contexts_init(c, srcFilter, dstFilter);
+        if (ret < 0) {
+            av_log(c, AV_LOG_ERROR, "Error initializing slice threading\n");
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
 #if FF_API_SWS_GETCONTEXT
 SwsContext *sws_getContext(int srcW, int srcH, enum AVPixelFormat srcFormat,
                            int dstW, int dstH, enum AVPixelFormat dstFormat,
@@ -1645,6 +1762,11 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    ff_sws_thread_free(c);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+
     if (c->lumPixBuf) {
         for (i = 0; i < c->vLumBufSize; i++)
             av_freep(&c->lumPixBuf[i]);
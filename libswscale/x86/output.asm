@@ -77,8 +77,26 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %define m_dith m7
 %else ; x86-64
 %define m_dith m9
+%define xm_dith xm9
 %endif ; x86-32
 
+%if mmsize == 32
+    ; the 8 dither values repeat every 8 pixels, so both lanes get the same
+    ; dwords: m8 covers pixels 0-3/8-11 and m_dith pixels 4-7/12-15
+    vmovq      xm_dith, [ditherq]
+    test       offsetd, offsetd
+    jz              .no_rot
+    vpunpcklqdq xm_dith, xm_dith, xm_dith
+    vpalignr   xm_dith, xm_dith, xm_dith, 3
+.no_rot:
+    vpmovzxbd      xm8, xm_dith
+    vpsrldq    xm_dith, xm_dith, 4
+    vpmovzxbd  xm_dith, xm_dith
+    vpslld         xm8, xm8, 12
+    vpslld     xm_dith, xm_dith, 12
+    vinserti128     m8, m8, xm8, 1
+    vinserti128 m_dith, m_dith, xm_dith, 1
+%else ; mmsize == 8/16
     ; create registers holding dither
     movq        m_dith, [ditherq]        ; dither
     test        offsetd, offsetd
@@ -119,6 +137,7 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
     mova      [rsp+16],  m3
     mova      [rsp+24],  m_dith
 %endif ; mmsize == 8/16
+%endif ; mmsize == 32
 %endif ; %1 == 8
 
     xor             r5,  r5
@@ -129,7 +148,7 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
     ; 8 pixels but we can only handle 2 pixels per register, and thus 4
     ; pixels per iteration. In order to not have to keep track of where
     ; we are w.r.t. dithering, we unroll the mmx/8bit loop x2.
-%if %1 == 8
+%if %1 == 8 && mmsize < 32
 %assign %%repcnt 16/mmsize
 %else
 %assign %%repcnt 1
@@ -157,18 +176,32 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
     mova            m3, [r6+r5*4]
     mova            m5, [r6+r5*4+mmsize]
 %else ; %1 == 8/9/10
+%if mmsize == 32
+    ; the V plane rows are only 16-byte aligned
+    movu            m3, [r6+r5*2]
+%else
     mova            m3, [r6+r5*2]
+%endif
 %endif ; %1 == 8/9/10/16
     mov             r6, [srcq+gprsize*cntr_reg-gprsize]
 %if %1 == 16
     mova            m4, [r6+r5*4]
     mova            m6, [r6+r5*4+mmsize]
 %else ; %1 == 8/9/10
+%if mmsize == 32
+    ; the V plane rows are only 16-byte aligned
+    movu            m4, [r6+r5*2]
+%else
     mova            m4, [r6+r5*2]
+%endif
 %endif ; %1 == 8/9/10/16
 
     ; coefficients
+%if mmsize == 32
+    vpbroadcastd    m0, [filterq+2*cntr_reg-4] ; coeff[0], coeff[1]
+%else
     movd            m0, [filterq+2*cntr_reg-4] ; coeff[0], coeff[1]
+%endif
 %if %1 == 16
     pshuflw         m7,  m0,  0          ; coeff[0]
     pshuflw         m0,  m0,  0x55       ; coeff[1]
@@ -187,7 +220,9 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %else ; %1 == 10/9/8
     punpcklwd       m5,  m3,  m4
     punpckhwd       m3,  m4
+%if mmsize < 32
     SPLATD          m0
+%endif
 
     pmaddwd         m5,  m0
     pmaddwd         m3,  m0
@@ -210,7 +245,18 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %if %1 == 8
     packssdw        m2,  m1
     packuswb        m2,  m2
+%if mmsize == 32
+    ; the packs work per lane, gather pixels 0-7 and 8-15 in the low lane
+    vpermq          m2,  m2,  q0020
+    vmovq  [dstq+r5*1], xm2
+    ; like the narrower versions, write at most 7 pixels past dstW
+    cmp             wd,  8
+    jle .last_ %+ %%i
+    vmovhps [dstq+r5*1+8], xm2
+.last_ %+ %%i:
+%else
     movh   [dstq+r5*1],  m2
+%endif ; mmsize == 32
 %else ; %1 == 9/10/16
 %if %1 == 16
     packssdw        m2,  m1
@@ -269,6 +315,11 @@ yuv2planeX_fn  8, 10, 7
 yuv2planeX_fn  9,  7, 5
 yuv2planeX_fn 10,  7, 5
 
+%if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+yuv2planeX_fn  8, 10, 7
+%endif
+
 ; %1=outout-bpc, %2=alignment (u/a)
 %macro yuv2plane1_mainloop 2
 .loop_%2:
@@ -118,6 +118,74 @@ enc_dec_pcm(){
     avconv -f $out_fmt -i ${encfile} -c:a pcm_${pcm_fmt} -f ${dec_fmt} -
 }
 
+rc_lookahead_underflows(){
+    lookahead=$1
+    shift
+    for la in 0 $lookahead; do
+        n=$(avconv "$@" -rc_lookahead $la -f null - 2>&1 |
+            awk '/rc buffer underflow/          { n++; u = 1; next }
+                 u && /Last message repeated/   { n += $4; next }
+                                                { u = 0 }
+                 END                            { print n + 0 }')
+        echo "rc_lookahead $la: $n underflows"
+    done
+}
+
+lavr_resample(){
+    internal_fmt=$1
+    out_fmt=$2
+    shift 2
+    src_file=$(target_path tests/data/asynth-44100-2.wav)
+    cfile="${outdir}/${test}.c.${out_fmt}"
+    simdfile="${outdir}/${test}.${out_fmt}"
+    cleanfiles="$cfile $simdfile"
+    resample="-af resample=internal_sample_fmt=${internal_fmt}p$1 -ar 48000"
+    test_cpuflags=$cpuflags
+    cpuflags=0
+    avconv -i $src_file $resample -f $out_fmt -y $(target_path $cfile) || return
+    cpuflags=$test_cpuflags
+    avconv -i $src_file $resample -f $out_fmt -y $(target_path $simdfile) || return
+    do_md5sum $cfile | cut -d' ' -f1
+    # only the float functions may round differently from C
+    if [ $internal_fmt = flt ]; then
+        psnr=$(tests/tiny_psnr $simdfile $cfile f32)
+        maxdiff=$(expr "$psnr" : '.*MAXDIFF: *\([0-9]*\)')
+        size1=$(expr "$psnr" : '.*bytes: *\([0-9]*\)')
+        size2=$(expr "$psnr" : '.*bytes:[ 0-9]*/ *\([0-9]*\)')
+        if [ $maxdiff -gt $fuzz ] || [ $size1 != $size2 ]; then
+            echo "$psnr"
+            return 1
+        fi
+    else
+        cmp $cfile $simdfile
+    fi
+}
+
+lavr_resample_planes(){
+    internal_fmt=$1
+    out_fmt=$2
+    src_file=$(target_path tests/data/asynth-44100-6.wav)
+    planesfile="${outdir}/${test}.${out_fmt}"
+    channelsfile="${outdir}/${test}.channels.${out_fmt}"
+    cleanfiles="$planesfile $channelsfile"
+    resample="resample=internal_sample_fmt=${internal_fmt}p"
+    split="channelsplit=channel_layout=5.1"
+    channels=
+    join=
+    for c in 0 1 2 3 4 5; do
+        split="${split}[in$c]"
+        channels="${channels};[in$c]${resample},aformat=sample_fmts=${internal_fmt}p:sample_rates=48000[out$c]"
+        join="${join}[out$c]"
+    done
+    join="${join}join=inputs=6:channel_layout=5.1"
+    avconv -i $src_file -af $resample -ar 48000 \
+        -f $out_fmt -y $(target_path $planesfile) || return
+    avconv -i $src_file -filter_complex "${split}${channels};${join}" \
+        -f $out_fmt -y $(target_path $channelsfile) || return
+    do_md5sum $planesfile | cut -d' ' -f1
+    cmp $planesfile $channelsfile
+}
+
 FLAGS="-flags +bitexact -sws_flags +accurate_rnd+bitexact"
 DEC_OPTS="-threads $threads -idct simple $FLAGS"
 ENC_OPTS="-threads 1        -idct simple -dct fastint"
@@ -0,0 +1,63 @@
+# Each test resamples with the C functions (-cpuflags 0) and with the
+# cpuflags the test runs with, compares the C output to the reference and
+# the SIMD output to the C output. On x86 the tests also run with the
+# cpuflags pinned to the level of each resampler kernel.
+
+# $(1) test name, $(2) lavr_resample arguments, $(3) cpuflags
+define LAVR_RESAMPLE_TEST
+FATE_LAVR_RESAMPLE += fate-lavr-resample-$(1)$(3:%=-%)
+fate-lavr-resample-$(1)$(3:%=-%): CMD = lavr_resample $(2)
+fate-lavr-resample-$(1)$(3:%=-%): REF = $(SRC_PATH)/tests/ref/fate/lavr-resample-$(1)
+$(if $(3),fate-lavr-resample-$(1)-$(3): CPUFLAGS = $(3))
+endef
+
+# $(1) internal sample format, $(2) output format, $(3) cpuflags
+define LAVR_RESAMPLE
+$(call LAVR_RESAMPLE_TEST,$(1),$(1) $(2),$(3))
+$(call LAVR_RESAMPLE_TEST,$(1)-linear,$(1) $(2) :linear_interp=1,$(3))
+endef
+
+$(eval $(call LAVR_RESAMPLE,flt,f32le))
+$(eval $(call LAVR_RESAMPLE,s16,s16le))
+$(eval $(call LAVR_RESAMPLE,s32,s32le))
+
+ifdef HAVE_YASM
+$(eval $(call LAVR_RESAMPLE,flt,f32le,sse))
+$(eval $(call LAVR_RESAMPLE,flt,f32le,avx))
+$(eval $(call LAVR_RESAMPLE,flt,f32le,fma3))
+$(eval $(call LAVR_RESAMPLE,s16,s16le,sse2))
+$(eval $(call LAVR_RESAMPLE,s32,s32le,sse4.1))
+endif
+
+$(FATE_LAVR_RESAMPLE): tests/data/asynth-44100-2.wav
+$(filter fate-lavr-resample-flt%,$(FATE_LAVR_RESAMPLE)): CMP_UNIT = f32
+$(filter fate-lavr-resample-flt%,$(FATE_LAVR_RESAMPLE)): FUZZ = 32
+
+FATE_LAVR-$(call ALLYES, RESAMPLE_FILTER WAV_DEMUXER PCM_S16LE_DECODER   \
+                         PCM_F32LE_ENCODER PCM_S16LE_ENCODER             \
+                         PCM_S32LE_ENCODER PCM_F32LE_MUXER               \
+                         PCM_S16LE_MUXER PCM_S32LE_MUXER) += $(FATE_LAVR_RESAMPLE)
+
+# Resampling 5.1 with all planes per filter phase step must give the same
+# result as resampling each channel on its own and joining them.
+FATE_LAVR_RESAMPLE_PLANES += fate-lavr-resample-planes-flt
+fate-lavr-resample-planes-flt: CMD = lavr_resample_planes flt f32le
+
+FATE_LAVR_RESAMPLE_PLANES += fate-lavr-resample-planes-s16
+fate-lavr-resample-planes-s16: CMD = lavr_resample_planes s16 s16le
+
+FATE_LAVR_RESAMPLE_PLANES += fate-lavr-resample-planes-s32
+fate-lavr-resample-planes-s32: CMD = lavr_resample_planes s32 s32le
+
+$(FATE_LAVR_RESAMPLE_PLANES): tests/data/asynth-44100-6.wav
+
+FATE_LAVR-$(call ALLYES, RESAMPLE_FILTER CHANNELSPLIT_FILTER JOIN_FILTER \
+                         AFORMAT_FILTER WAV_DEMUXER PCM_S16LE_DECODER    \
+                         PCM_F32LE_ENCODER PCM_S16LE_ENCODER             \
+                         PCM_S32LE_ENCODER PCM_F32LE_MUXER               \
+                         PCM_S16LE_MUXER PCM_S32LE_MUXER) += $(FATE_LAVR_RESAMPLE_PLANES)
+
+FATE_AVCONV += $(FATE_LAVR-yes)
+fate-lavr-resample: $(FATE_LAVR_RESAMPLE)
+fate-lavr-resample-planes: $(FATE_LAVR_RESAMPLE_PLANES)
+fate-lavr: $(FATE_LAVR-yes)
@@ -125,6 +125,7 @@ fate-seek-vsynth2-mpeg4-adap:        SRC = fate/vsynth2-mpeg4-adap.avi
 fate-seek-vsynth2-mpeg4-adv:         SRC = fate/vsynth2-mpeg4-adv.avi
 fate-seek-vsynth2-mpeg4-error:       SRC = fate/vsynth2-mpeg4-error.avi
 fate-seek-vsynth2-mpeg4-nr:          SRC = fate/vsynth2-mpeg4-nr.avi
+fate-seek-vsynth2-mpeg4-pipeline:    SRC = fate/vsynth2-mpeg4-pipeline.avi
 fate-seek-vsynth2-mpeg4-qpel:        SRC = fate/vsynth2-mpeg4-qpel.avi
 fate-seek-vsynth2-mpeg4-qprd:        SRC = fate/vsynth2-mpeg4-qprd.avi
 fate-seek-vsynth2-mpeg4-rc:          SRC = fate/vsynth2-mpeg4-rc.avi
@@ -157,6 +158,7 @@ FATE_SEEK_LAVF-$(call ENCDEC,  GIF,                   IMAGE2)      += gif
 FATE_SEEK_LAVF-$(call ENCDEC2, MPEG2VIDEO, PCM_S16LE, GXF)         += gxf
 FATE_SEEK_LAVF-$(call ENCDEC,  MJPEG,                 IMAGE2)      += jpg
 FATE_SEEK_LAVF-$(call ENCDEC2, MPEG4,      MP2,       MATROSKA)    += mkv
+FATE_SEEK_LAVF-$(call ENCDEC2, MPEG4,      MP2,       MATROSKA)    += mkv_nocues
 FATE_SEEK_LAVF-$(call ENCDEC,  ADPCM_YAMAHA,          MMF)         += mmf
 FATE_SEEK_LAVF-$(call ENCDEC2, MPEG4,      PCM_ALAW,  MOV)         += mov
 FATE_SEEK_LAVF-$(call ENCDEC2, MPEG1VIDEO, MP2,       MPEG1SYSTEM MPEGPS) += mpg
@@ -194,6 +196,7 @@ fate-seek-lavf-gif:      SRC = lavf/lavf.gif
 fate-seek-lavf-gxf:      SRC = lavf/lavf.gxf
 fate-seek-lavf-jpg:      SRC = images/jpg/%02d.jpg
 fate-seek-lavf-mkv:      SRC = lavf/lavf.mkv
+fate-seek-lavf-mkv_nocues: SRC = lavf/lavf.mkv_nocues
 fate-seek-lavf-mmf:      SRC = lavf/lavf.mmf
 fate-seek-lavf-mov:      SRC = lavf/lavf.mov
 fate-seek-lavf-mpg:      SRC = lavf/lavf.mpg
@@ -225,5 +228,14 @@ $(FATE_SEEK): CMD = run libavformat/seek-test$(EXESUF) $(TARGET_PATH)/tests/data
 $(FATE_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
+FATE_SEEK_LAVF_OPTS-$(call ENCDEC2, MPEG4, PCM_ALAW, MOV) += mov_compact_index
+
+fate-seek-lavf-mov_compact_index: fate-lavf-mov
+fate-seek-lavf-mov_compact_index: CMD = run libavformat/seek-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov compact_index=1
+
+FATE_SEEK_OPTS = $(FATE_SEEK_LAVF_OPTS-yes:%=fate-seek-lavf-%)
+$(FATE_SEEK_OPTS): libavformat/seek-test$(EXESUF)
+FATE_SEEK += $(FATE_SEEK_OPTS)
+
 FATE_AVCONV += $(FATE_SEEK)
 fate-seek:     $(FATE_SEEK)
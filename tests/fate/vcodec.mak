@@ -74,9 +74,12 @@ fate-vsynth%-h263:               ENCOPTS = -qscale 10
 fate-vsynth%-h263-obmc:          ENCOPTS = -qscale 10 -obmc 1
 fate-vsynth%-h263p:              ENCOPTS = -qscale 2 -flags +aic -umv 1 -aiv 1 -ps 300
 
-FATE_VCODEC-$(call ENCDEC, HUFFYUV, AVI) += huffyuv
+FATE_VCODEC-$(call ENCDEC, HUFFYUV, AVI) += huffyuv huffyuv-thread
 fate-vsynth%-huffyuv:            ENCOPTS = -pix_fmt yuv422p -sws_flags neighbor
 fate-vsynth%-huffyuv:            DECOPTS = -strict -2 -sws_flags neighbor
+fate-vsynth%-huffyuv-thread:     ENCOPTS = -pix_fmt yuv422p -sws_flags neighbor \
+                                           -threads 4 -thread_type frame
+fate-vsynth%-huffyuv-thread:     DECOPTS = -strict -2 -sws_flags neighbor
 
 FATE_VCODEC-$(call ENCDEC, JPEGLS, AVI) += jpegls
 fate-vsynth%-jpegls:             ENCOPTS = -sws_flags neighbor+full_chroma_int
@@ -85,8 +88,10 @@ fate-vsynth%-jpegls:             DECOPTS = -sws_flags area
 FATE_VCODEC-$(call ENCDEC, LJPEG MJPEG, AVI) += ljpeg
 fate-vsynth%-ljpeg:              ENCOPTS = -strict -1
 
-FATE_VCODEC-$(call ENCDEC, MJPEG, AVI)  += mjpeg
+FATE_VCODEC-$(call ENCDEC, MJPEG, AVI)  += mjpeg mjpeg-thread
 fate-vsynth%-mjpeg:              ENCOPTS = -qscale 9 -pix_fmt yuvj420p
+fate-vsynth%-mjpeg-thread:       ENCOPTS = -qscale 9 -pix_fmt yuvj420p  \
+                                           -threads 4 -thread_type frame
 
 FATE_VCODEC-$(call ENCDEC, MPEG1VIDEO, MPEG1VIDEO MPEGVIDEO) += mpeg1 mpeg1b
 fate-vsynth%-mpeg1:              FMT     = mpeg1video
@@ -99,6 +104,8 @@ fate-vsynth%-mpeg1b:             FMT     = mpeg1video
 
 FATE_MPEG2 = mpeg2                                                      \
              mpeg2-422                                                  \
+             mpeg2-b-strategy                                           \
+             mpeg2-b-strategy-thread                                    \
              mpeg2-idct-int                                             \
              mpeg2-ilace                                                \
              mpeg2-ivlc-qprd                                            \
@@ -119,6 +126,9 @@ fate-vsynth%-mpeg2-422:          ENCOPTS = -b:v 1000k                   \
                                            -intra_vlc 1                 \
                                            -mbd rd                      \
                                            -pix_fmt yuv422p
+fate-vsynth%-mpeg2-b-strategy:   ENCOPTS = -qscale 10 -bf 3 -b_strategy 2
+fate-vsynth%-mpeg2-b-strategy-thread: ENCOPTS = -qscale 10 -bf 3 -b_strategy 2 \
+                                                -threads 2 -slices 2
 fate-vsynth%-mpeg2-idct-int:     ENCOPTS = -qscale 10 -idct int -dct int
 fate-vsynth%-mpeg2-ilace:        ENCOPTS = -qscale 10 -flags +ildct+ilme
 fate-vsynth%-mpeg2-ivlc-qprd:    ENCOPTS = -b:v 500k                    \
@@ -134,6 +144,25 @@ fate-vsynth%-mpeg2-thread:       ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
 fate-vsynth%-mpeg2-thread-ivlc:  ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
                                            -intra_vlc 1 -threads 2 -slices 2
 
+# 96 frames cutting between the two synthetic sequences every 16 frames,
+# coded with a VBV tight enough to underflow at the cuts without lookahead
+MPEG2_SCENECUT_SRC = "concat:$(TARGET_PATH)/tests/data/vsynth2.yuv|$(TARGET_PATH)/tests/data/vsynth1.yuv|$(TARGET_PATH)/tests/data/vsynth2.yuv|$(TARGET_PATH)/tests/data/vsynth1.yuv|$(TARGET_PATH)/tests/data/vsynth2.yuv|$(TARGET_PATH)/tests/data/vsynth1.yuv"
+MPEG2_SCENECUT_VF  = "select=gte(mod(n\,50)\,16*floor(n/100))*lt(mod(n\,50)\,16*floor(n/100)+16),setpts=N"
+MPEG2_SCENECUT     = -f rawvideo -s 352x288 -pix_fmt yuv420p                    \
+                     -i $(MPEG2_SCENECUT_SRC) -vf $(MPEG2_SCENECUT_VF)           \
+                     -threads 1 -idct simple -dct fastint -flags +bitexact      \
+                     -c:v mpeg2video -b:v 700k -maxrate 750k -bufsize 150k -bf 0
+
+FATE_MPEG2_RC-$(call ALLYES, MPEG2VIDEO_ENCODER SELECT_FILTER FRAMECRC_MUXER) += fate-mpeg2-rc-lookahead
+fate-mpeg2-rc-lookahead: CMD = framecrc $(MPEG2_SCENECUT) -rc_lookahead 4
+
+FATE_MPEG2_RC-$(call ALLYES, MPEG2VIDEO_ENCODER SELECT_FILTER NULL_MUXER) += fate-mpeg2-rc-lookahead-underflows
+fate-mpeg2-rc-lookahead-underflows: CMD = rc_lookahead_underflows 4 $(MPEG2_SCENECUT)
+
+$(FATE_MPEG2_RC-yes): tests/data/vsynth1.yuv tests/data/vsynth2.yuv
+FATE_AVCONV += $(FATE_MPEG2_RC-yes)
+fate-mpeg2-rc: $(FATE_MPEG2_RC-yes)
+
 FATE_MPEG4_MP4 = mpeg4
 FATE_MPEG4_AVI = mpeg4-rc                                               \
                  mpeg4-adv                                              \
@@ -142,7 +171,8 @@ FATE_MPEG4_AVI = mpeg4-rc                                               \
                  mpeg4-qpel                                             \
                  mpeg4-thread                                           \
                  mpeg4-error                                            \
-                 mpeg4-nr
+                 mpeg4-nr                                               \
+                 mpeg4-pipeline
 
 FATE_VCODEC-$(call ENCDEC, MPEG4, MP4 MOV) += $(FATE_MPEG4_MP4)
 FATE_VCODEC-$(call ENCDEC, MPEG4, AVI)     += $(FATE_MPEG4_AVI)
@@ -171,6 +201,9 @@ fate-vsynth%-mpeg4-qprd:         ENCOPTS = -b 450k -bf 2 -trellis 1          \
                                            -flags +mv4+mv0 -mpv_flags +qp_rd \
                                            -cmp 2 -subcmp 2 -mbd rd
 
+fate-vsynth%-mpeg4-pipeline:     ENCOPTS = -b 400k -bf 2 -pipeline_threads
+fate-vsynth%-mpeg4-pipeline:     DECOPTS = -pipeline_threads
+
 fate-vsynth%-mpeg4-rc:           ENCOPTS = -b 400k -bf 2
 
 fate-vsynth%-mpeg4-thread:       ENCOPTS = -b 500k -flags +mv4+aic         \
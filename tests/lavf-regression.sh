@@ -90,6 +90,10 @@ if [ -n "$do_mov" ] ; then
 do_lavf mov "" "-acodec pcm_alaw -c:v mpeg4"
 fi
 
+if [ -n "$do_mov_faststart" ] ; then
+do_lavf mov_faststart "" "-acodec pcm_alaw -c:v mpeg4 -f mov -movflags faststart"
+fi
+
 if [ -n "$do_dv_fmt" ] ; then
 do_lavf dv "-ar 48000 -channel_layout stereo" "-r 25 -s pal"
 fi
@@ -106,6 +110,15 @@ if [ -n "$do_mkv" ] ; then
 do_lavf mkv "" "-c:a mp2 -c:v mpeg4"
 fi
 
+if [ -n "$do_mkv_nocues" ] ; then
+# streamed output, written without cues
+file=${outfile}lavf.mkv_nocues
+run_avconv $DEC_OPTS -f image2 -vcodec pgmyuv -i $raw_src $DEC_OPTS -ar 44100 -f s16le -i $pcm_src $ENC_OPTS -b:a 64k -t 1 -qscale:v 10 -c:a mp2 -c:v mpeg4 -f matroska pipe: > $target_path/$file
+do_md5sum $file
+echo $(wc -c $file)
+do_avconv_crc $file $DEC_OPTS -i $target_path/$file
+fi
+
 
 # streamed images
 # mjpeg